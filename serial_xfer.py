@@ -0,0 +1,272 @@
+#!/usr/bin/env python3
+# pip3 install pyserial
+#
+# Host side of the framed serial transfer in source/serial_xfer.c.
+#
+#   serial_xfer.py PORT put LOCAL [--compress] [--resume] [--cmd "put sdmc:/x"]
+#   serial_xfer.py PORT get LOCAL [--resume] [--cmd "get sdmc:/x"]
+#
+# `put` answers the console's put/up/upp/uppl/upb commands, `get` its get
+# command. --cmd types the console command first.
+
+import sys, os, struct, time, zlib, argparse
+import serial
+
+MAGIC = b"MX"
+HDR_SIZE = 12
+MAX_PAYLOAD = 240
+
+TYPE_PUT   = 1
+TYPE_GET   = 2
+TYPE_INFO  = 3
+TYPE_DATA  = 4
+TYPE_ACK   = 5
+TYPE_NAK   = 6
+TYPE_END   = 7
+TYPE_ABORT = 8
+
+FLAG_DEFLATE = 1
+
+WINDOW = 8
+RESEND_TIMEOUT = 0.5
+IDLE_TIMEOUT = 5.0
+LINGER = 2.0
+
+class Link:
+    def __init__(self, port, baud):
+        self.ser = serial.Serial(port, baud, timeout=0.05)
+        self.rx = b""
+        self.echo = True
+
+    def send(self, type, seq, payload=b""):
+        hdr = struct.pack(">BBI", type, len(payload), seq)
+        crc = zlib.crc32(payload, zlib.crc32(hdr))
+        self.ser.write(MAGIC + hdr + struct.pack(">I", crc) + payload)
+
+    # Returns (type, seq, payload) or None after timeout seconds.
+    def recv(self, timeout):
+        end = time.monotonic() + timeout
+        while True:
+            frame = self._parse()
+            if frame:
+                return frame
+            if time.monotonic() >= end:
+                return None
+            self.rx += self.ser.read(max(1, self.ser.in_waiting))
+
+    def _parse(self):
+        while True:
+            idx = self.rx.find(MAGIC)
+            if idx < 0:
+                keep = 1 if self.rx.endswith(MAGIC[:1]) else 0
+                self._text(self.rx[:len(self.rx) - keep])
+                self.rx = self.rx[len(self.rx) - keep:]
+                return None
+            self._text(self.rx[:idx])
+            self.rx = self.rx[idx:]
+            if len(self.rx) < HDR_SIZE:
+                return None
+
+            type, length, seq, crc = struct.unpack(">BBII", self.rx[2:HDR_SIZE])
+            if length > MAX_PAYLOAD:
+                self.rx = self.rx[1:]
+                continue
+            if len(self.rx) < HDR_SIZE + length:
+                return None
+
+            payload = self.rx[HDR_SIZE:HDR_SIZE + length]
+            if zlib.crc32(payload, zlib.crc32(self.rx[2:8])) != crc:
+                self.rx = self.rx[1:]
+                continue
+            self.rx = self.rx[HDR_SIZE + length:]
+            return (type, seq, payload)
+
+    def _text(self, data):
+        if self.echo:
+            data = data.replace(b"\x00", b"")
+            if data:
+                sys.stdout.write(data.decode("ascii", "replace"))
+                sys.stdout.flush()
+
+def wait_open(link, type):
+    while True:
+        frame = link.recv(60.0)
+        if not frame:
+            sys.exit("ERROR: device never opened the transfer.")
+        if frame[0] == type:
+            link.echo = False
+            return frame
+
+def check_abort(frame):
+    if frame and frame[0] == TYPE_ABORT:
+        sys.exit("ERROR: device aborted (%d)." % -struct.unpack(">I", frame[2][:4])[0])
+
+def put(link, args):
+    data = open(args.local, "rb").read()
+    _, _, req = wait_open(link, TYPE_PUT)
+    cur_size, cur_crc, flags = struct.unpack(">IIB", req[:9])
+    path = req[9:].decode("ascii", "replace")
+
+    offset = 0
+    if args.resume and cur_size <= len(data) and zlib.crc32(data[:cur_size]) == cur_crc:
+        offset = cur_size
+
+    body = data[offset:]
+    info_flags = 0
+    if args.compress and flags & FLAG_DEFLATE:
+        stream = zlib.compress(body, 9)
+        info_flags |= FLAG_DEFLATE
+    else:
+        stream = body
+    frames = [stream[i:i + MAX_PAYLOAD] for i in range(0, len(stream), MAX_PAYLOAD)]
+    print("Sending 0x%x bytes at 0x%x to %s as %d frames." % (len(body), offset, path, len(frames)))
+
+    # INFO until the device acks 0, which starts the data.
+    info = struct.pack(">IIB", offset, len(body), info_flags)
+    while True:
+        link.send(TYPE_INFO, 0, info)
+        frame = link.recv(1.0)
+        check_abort(frame)
+        if frame and frame[0] == TYPE_ACK and frame[1] == 0:
+            break
+
+    start = time.monotonic()
+    base = next = 0
+    last_ack = last_rx = time.monotonic()
+    while base < len(frames):
+        while next < len(frames) and next < base + WINDOW:
+            link.send(TYPE_DATA, next, frames[next])
+            next += 1
+
+        frame = link.recv(0.01)
+        now = time.monotonic()
+        check_abort(frame)
+        if frame:
+            last_rx = now
+            type, seq, _ = frame
+            if type in (TYPE_ACK, TYPE_NAK) and base <= seq <= len(frames):
+                if seq > base:
+                    last_ack = now
+                base = seq
+                if type == TYPE_NAK:
+                    next = base
+        if now - last_rx >= IDLE_TIMEOUT:
+            sys.exit("ERROR: device stopped responding.")
+        if now - last_ack >= RESEND_TIMEOUT:
+            next = base
+            last_ack = now
+        sys.stdout.write("\r%d/%d" % (base, len(frames)))
+
+    end = struct.pack(">I", zlib.crc32(body))
+    for _ in range(int(IDLE_TIMEOUT / RESEND_TIMEOUT)):
+        link.send(TYPE_END, len(frames), end)
+        frame = link.recv(RESEND_TIMEOUT)
+        check_abort(frame)
+        if frame and frame[0] == TYPE_ACK and frame[1] == len(frames) + 1:
+            elapsed = time.monotonic() - start
+            print("\rDone, %.1f KiB/s." % (len(stream) / 1024 / max(elapsed, 0.001)))
+            return
+    sys.exit("ERROR: device never acked END.")
+
+# Answers repeated ENDs for a while, in case our final ACK got lost.
+def linger(link, seq):
+    end = time.monotonic() + LINGER
+    while time.monotonic() < end:
+        frame = link.recv(end - time.monotonic())
+        if frame and frame[0] == TYPE_END and frame[1] + 1 == seq:
+            link.send(TYPE_ACK, seq)
+
+def get(link, args):
+    _, _, req = wait_open(link, TYPE_GET)
+    size, flags = struct.unpack(">IB", req[:5])
+    path = req[5:].decode("ascii", "replace")
+
+    have = b""
+    if args.resume and os.path.exists(args.local):
+        have = open(args.local, "rb").read()
+        if len(have) > size:
+            have = b""
+    offset = len(have)
+    print("Receiving 0x%x bytes at 0x%x from %s." % (size - offset, offset, path))
+
+    out = open(args.local, "r+b" if offset else "wb")
+    out.seek(offset)
+    out.truncate()
+
+    info = struct.pack(">IIB", offset, 0, 0)
+    crc = 0
+    expected = 0
+    nak_sent = False
+    got_data = False
+    last_rx = time.monotonic()
+    link.send(TYPE_INFO, 0, info)
+    while True:
+        frame = link.recv(0.25)
+        now = time.monotonic()
+        if not frame:
+            if now - last_rx >= IDLE_TIMEOUT:
+                sys.exit("ERROR: device stopped responding.")
+            if got_data:
+                link.send(TYPE_ACK, expected)
+            else:
+                link.send(TYPE_INFO, 0, info)
+            continue
+        last_rx = now
+        check_abort(frame)
+        type, seq, payload = frame
+
+        if type == TYPE_GET and not got_data:
+            link.send(TYPE_INFO, 0, info)
+            continue
+        if type not in (TYPE_DATA, TYPE_END):
+            continue
+        got_data = True
+
+        if seq > expected:
+            if not nak_sent:
+                link.send(TYPE_NAK, expected)
+            nak_sent = True
+            continue
+        if seq < expected:
+            link.send(TYPE_ACK, expected)
+            continue
+        nak_sent = False
+
+        if type == TYPE_END:
+            if struct.unpack(">I", payload[:4])[0] != crc:
+                link.send(TYPE_ABORT, 0, struct.pack(">I", 0))
+                sys.exit("ERROR: crc32 mismatch.")
+            link.send(TYPE_ACK, expected + 1)
+            out.close()
+            linger(link, expected + 1)
+            print("\rDone, 0x%x bytes." % (size))
+            return
+
+        out.write(payload)
+        crc = zlib.crc32(payload, crc)
+        expected += 1
+        link.send(TYPE_ACK, expected)
+        sys.stdout.write("\r0x%x/0x%x" % (offset + expected * MAX_PAYLOAD, size))
+
+def main():
+    parser = argparse.ArgumentParser(description="minute serial file transfer")
+    parser.add_argument("port")
+    parser.add_argument("direction", choices=["put", "get"])
+    parser.add_argument("local")
+    parser.add_argument("-b", "--baud", type=int, default=115200)
+    parser.add_argument("--compress", action="store_true", help="deflate the upload")
+    parser.add_argument("--resume", action="store_true", help="continue a partial transfer")
+    parser.add_argument("--cmd", help="console command that starts the transfer")
+    args = parser.parse_args()
+
+    link = Link(args.port, args.baud)
+    if args.cmd:
+        link.ser.write(args.cmd.encode("ascii") + b"\r")
+
+    if args.direction == "put":
+        put(link, args)
+    else:
+        get(link, args)
+
+if __name__ == "__main__":
+    main()
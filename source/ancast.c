@@ -46,36 +46,23 @@ typedef struct {
     ancast_header header;
     size_t header_size;
     FILE* file;
+    FIL* fil;
     const char* path;
     size_t size;
     void* load;
     void* body;
     u32 sector_idx;
     void* memory_load;
+#ifndef MINUTE_BOOT1
+    sha_ctx sha;
+    bool hashed;
+#endif
 } ancast_ctx;
 
 int ancast_fini(ancast_ctx* ctx);
 
-int ancast_init(ancast_ctx* ctx, const char* path)
+static int ancast_parse_header(ancast_ctx* ctx, const u8* buffer, const char* path)
 {
-    if(!ctx || !path) return -1;
-    memset(ctx, 0, sizeof(ancast_ctx));
-
-    ctx->path = path;
-    ctx->file = fopen(path, "rb");
-    if(!ctx->file) {
-        printf("ancast: failed to open %s (%d).\n", path, errno);
-        return errno;
-    }
-
-    fseek(ctx->file, 0, SEEK_END);
-    ctx->size = ftell(ctx->file);
-    fseek(ctx->file, 0, SEEK_SET);
-
-    u8 buffer[0x200] = {0};
-    fread(buffer, min(sizeof(buffer), ctx->size), 1, ctx->file);
-    fseek(ctx->file, 0, SEEK_SET);
-
     u32 magic = read32((u32) buffer);
     if(magic != ANCAST_MAGIC) {
         printf("ancast: %s is not an ancast image (magic is 0x%08lX, expected 0x%08lX).\n", path, magic, ANCAST_MAGIC);
@@ -83,7 +70,9 @@ int ancast_init(ancast_ctx* ctx, const char* path)
     }
 
     u32 sig_offset = read32((u32) &buffer[0x08]);
-    u32 sig_type = read32((u32) &buffer[sig_offset]);
+    u32 sig_type = 0;
+    if(sig_offset <= 0x200 - sizeof(u32))
+        sig_type = read32((u32) &buffer[sig_offset]);
 
     u32 header_offset = 0;
     switch(sig_type) {
@@ -104,6 +93,54 @@ int ancast_init(ancast_ctx* ctx, const char* path)
     return 0;
 }
 
+int ancast_init(ancast_ctx* ctx, const char* path)
+{
+    if(!ctx || !path) return -1;
+    memset(ctx, 0, sizeof(ancast_ctx));
+
+    ctx->path = path;
+    ctx->file = fopen(path, "rb");
+    if(!ctx->file) {
+        printf("ancast: failed to open %s (%d).\n", path, errno);
+        return errno;
+    }
+
+    fseek(ctx->file, 0, SEEK_END);
+    ctx->size = ftell(ctx->file);
+    fseek(ctx->file, 0, SEEK_SET);
+
+    u8 buffer[0x200] = {0};
+    fread(buffer, min(sizeof(buffer), ctx->size), 1, ctx->file);
+    fseek(ctx->file, 0, SEEK_SET);
+
+    return ancast_parse_header(ctx, buffer, path);
+}
+
+int ancast_init_from_fatfs(ancast_ctx* ctx, FIL* fil, const char* path)
+{
+    if(!ctx || !fil) return -1;
+    memset(ctx, 0, sizeof(ancast_ctx));
+
+    ctx->path = path;
+    ctx->fil = fil;
+    ctx->size = f_size(fil);
+
+    // The first sector stays in sd_read_buffer; ancast_load copies it to the
+    // load address and continues reading from there.
+    UINT read = 0;
+    FRESULT res = f_read(fil, sd_read_buffer, sizeof(sd_read_buffer), &read);
+    if(res != FR_OK || read != sizeof(sd_read_buffer)) {
+        printf("ancast: failed to read header of %s (%d).\n", path, res);
+        return -1;
+    }
+
+#ifdef MINUTE_BOOT1
+    serial_send_u32(read32((u32) sd_read_buffer));
+#endif
+
+    return ancast_parse_header(ctx, (u8*)sd_read_buffer, path);
+}
+
 int ancast_init_from_raw_sector(ancast_ctx* ctx, int sector_idx)
 {
     if(!ctx) return -1;
@@ -190,6 +227,19 @@ int ancast_init_from_memory(ancast_ctx* ctx, void* ancast_mem)
     return 0;
 }
 
+// Feed the part of [offset, offset + size) of the image that belongs to the
+// body into the running hash, so streamed loads don't need a second pass.
+static void ancast_hash_chunk(ancast_ctx* ctx, u32 offset, u32 size)
+{
+#ifndef MINUTE_BOOT1
+    u32 start = max(offset, ctx->header_size);
+    u32 end = min(offset + size, ctx->header_size + ctx->header.body_size);
+    if(start < end)
+        sha_update(&ctx->sha, ctx->load + start, end - start);
+    ctx->hashed = true;
+#endif
+}
+
 int ancast_load(ancast_ctx* ctx)
 {
     if(!ctx) return -1;
@@ -225,6 +275,10 @@ int ancast_load(ancast_ctx* ctx)
 
     ctx->body = ctx->load + ctx->header_size;
 
+#ifndef MINUTE_BOOT1
+    sha_init(&ctx->sha);
+#endif
+
     if (ctx->memory_load)
     {
         u32 total_size = ctx->header_size + ctx->header.body_size;
@@ -263,6 +317,7 @@ int ancast_load(ancast_ctx* ctx)
                 ancast_fini(ctx);
                 return errno;
             }
+            ancast_hash_chunk(ctx, i, to_read);
         }
 #endif
 
@@ -279,6 +334,35 @@ int ancast_load(ancast_ctx* ctx)
         printf("ancast: done reading\n");
     }
 #endif
+    else if (ctx->fil)
+    {
+        u32 total_size = ctx->header_size + ctx->header.body_size;
+
+#ifdef MINUTE_BOOT1
+        serial_send_u32(total_size);
+        serial_send_u32(ctx->header.body_size);
+#endif
+
+        // ancast_init_from_fatfs already read the first sector.
+        u32 offs = min(sizeof(sd_read_buffer), total_size);
+        memcpy(ctx->load, sd_read_buffer, offs);
+        ancast_hash_chunk(ctx, 0, offs);
+
+        // Large reads go straight from the card to the load address.
+        while (offs < total_size)
+        {
+            UINT to_read = min(total_size - offs, 0x100000);
+            UINT read = 0;
+            FRESULT res = f_read(ctx->fil, ctx->load + offs, to_read, &read);
+            if(res != FR_OK || read != to_read) {
+                printf("ancast: failed to read offs=%08lx, %s (%d).\n", offs, ctx->path, res);
+                ancast_fini(ctx);
+                return -4;
+            }
+            ancast_hash_chunk(ctx, offs, to_read);
+            offs += to_read;
+        }
+    }
     else if (ctx->sector_idx)
     {
         void* sdcard_dst = ctx->load;
@@ -325,7 +409,10 @@ int ancast_load(ancast_ctx* ctx)
 
 #ifndef MINUTE_BOOT1
     u32 hash[SHA_HASH_WORDS] = {0};
-    sha_hash(ctx->body, hash, ctx->header.body_size);
+    if(ctx->hashed)
+        sha_final(&ctx->sha, hash);
+    else
+        sha_hash(ctx->body, hash, ctx->header.body_size);
 
     u32* h1 = ctx->header.body_hash;
     u32* h2 = hash;
@@ -355,7 +442,7 @@ int ancast_load(ancast_ctx* ctx)
 
 int ancast_fini(ancast_ctx* ctx)
 {
-#ifndef MINUTE_BOOT1
+#if !defined(MINUTE_BOOT1) || defined(ISFSHAX_STAGE2)
     if (ctx->file)
     {
         int res = fclose(ctx->file);
@@ -547,6 +634,58 @@ u32 ancast_iop_load_from_memory(void* ancast_mem)
     return vector;
 }
 
+// f_reads the body straight to the load address, without a staging buffer.
+// boot1 can't DMA from the card (see can_sdcard_dma_addr), so there diskio
+// still copies each sector out of its bounce buffer.
+u32 ancast_iop_load_from_fatfs(FIL* fil, const char* path)
+{
+    int res = 0;
+    ancast_ctx ctx = {0};
+
+    res = ancast_init_from_fatfs(&ctx, fil, path);
+    if(res) return 0;
+
+    u8 target = ctx.header.device >> 4;
+    if(target != ANCAST_TARGET_IOP) {
+        printf("ancast: %s is not an IOP image (target is 0x%02X, expected 0x%02X).\n", path, target, ANCAST_TARGET_IOP);
+        ancast_fini(&ctx);
+        return 0;
+    }
+
+    res = ancast_load(&ctx);
+    if(res) return 0;
+
+#if !defined(MINUTE_BOOT1) || defined(ISFSHAX_STAGE2)
+    if(!(ctx.header.unk1 & 0b1)) {
+        aes_reset();
+        aes_set_key(get_key());
+
+        static const u8 iv[16] = {0x91, 0xC9, 0xD0, 0x08, 0x31, 0x28, 0x51, 0xEF,
+                                  0x6B, 0x22, 0x8B, 0xF1, 0x4B, 0xAD, 0x43, 0x22};
+        aes_set_iv((u8*)iv);
+
+        printf("ancast: decrypting %s...\n", path);
+        aes_decrypt(ctx.body, ctx.body, ctx.header.body_size / 0x10, 0);
+    }
+#endif
+
+    dc_flushrange(ctx.load, ctx.header_size + ctx.header.body_size);
+
+    ios_header* header = ctx.body;
+    u32 vector = (u32) ctx.body + header->header_size;
+
+#ifdef MINUTE_BOOT1
+    serial_send_u32((u32) ctx.body);
+    serial_send_u32(header->header_size);
+    serial_send_u32(vector);
+#endif
+
+    res = ancast_fini(&ctx);
+    if(res) return 0;
+
+    return vector;
+}
+
 extern int main_allow_legacy_patches;
 u32 ancast_patch_load(const char* fn_ios, const char* fn_patch, const char* plugins_fpath, bool rednand)
 {
@@ -15,6 +15,7 @@
 
 #include "sha.h"
 #include "prsh.h"
+#include "ff.h"
 
 #define STROOPWAFEL_ABI_VERSION 0x65667301
 
@@ -44,6 +45,7 @@ u32 ancast_ppc_load(const char* path);
 
 u32 ancast_iop_load_from_raw_sector(int sector_idx);
 u32 ancast_iop_load_from_memory(void* ancast_mem);
+u32 ancast_iop_load_from_fatfs(FIL* fil, const char* path);
 u32 ancast_patch_load(const char* fn_ios, const char* fn_patch, const char* plugins_fpath, bool rednand);
 
 int ancast_plugins_load(const char* plugins_fpath, bool rednand);
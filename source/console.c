@@ -12,6 +12,8 @@
 #include "gfx.h"
 #include "serial.h"
 #include "smc.h"
+#include "utils.h"
+#include "task.h"
 #include <string.h>
 
 char console[MAX_LINES][MAX_LINE_LENGTH];
@@ -59,60 +61,91 @@ int console_get_border_width(int width)
     return border_width;
 }
 
+// What the screens and the serial terminal currently show, so console_show()
+// only has to redraw the lines that actually changed.
+static char console_shown[MAX_LINES][MAX_LINE_LENGTH];
+static int console_shown_lines = 0;
+static int console_shown_color = -1;
+static int console_shown_x = -1, console_shown_y = -1;
+static u32 console_shown_epoch = 0;
+static bool console_serial_flushed = true;
+static bool console_serial_valid = false;
+static u32 console_serial_count = 0;
+
+static void console_draw_border(gfx_screen_t screen, int bx, int by, int bw, int bh)
+{
+    int bsz = border_width + 1;
+
+    gfx_fill_rect(screen, bx, by, bw + border_width, bsz, border_color);
+    gfx_fill_rect(screen, bx, by + bh - 1, bw + border_width, bsz, border_color);
+    gfx_fill_rect(screen, bx, by, bsz, bh + border_width, border_color);
+    gfx_fill_rect(screen, bx + bw - 1, by, bsz, bh + border_width, border_color);
+}
+
 void console_show()
 {
-    int i = 0, x = 0, y = 0;
-    for(y = console_y; y < console_h + console_y + border_width; y++)
-    {
-        for(x = console_x; x < console_w + console_x + border_width; x++)
-        {
-            if((x >= console_x && x <= console_x + border_width) ||
-               (y >= console_y && y <= console_y + border_width) ||
-               (x >= console_w + console_x - 1 && x <= console_w + console_x - 1 + border_width) ||
-               (y >= console_h + console_y - 1 && y <= console_h + console_y - 1 + border_width)) {
-                gfx_draw_plot(GFX_DRC, x, y, border_color);
-            }
-            else {
-                //gfx_draw_plot(GFX_DRC, x, y, background_color);
-            }
-        }
-    }
+    int i = 0;
+    int count = max(lines, console_shown_lines);
+    u32 epoch = gfx_get_epoch();
+    bool full = console_shown_epoch != epoch || console_shown_color != text_color ||
+                console_shown_x != console_x || console_shown_y != console_y;
+
+    // Redraw in place over ANSI only if nobody printed since our last show,
+    // otherwise behave like before and clear (or append).
+    bool serial_partial = console_serial_valid && serial_get_output_count() == console_serial_count;
+    bool serial_cleared = !serial_partial && console_serial_flushed;
+    if (serial_cleared)
+        serial_clear();
 
-    for(y = console_tv_y; y < console_tv_h + console_tv_y + border_width; y++)
-    {
-        for(x = console_tv_x; x < console_tv_w + console_tv_x + border_width; x++)
-        {
-            if((x >= console_tv_x && x <= console_tv_x + border_width) ||
-               (y >= console_tv_y && y <= console_tv_y + border_width) ||
-               (x >= console_tv_w + console_tv_x - 1 && x <= console_tv_w + console_tv_x - 1 + border_width) ||
-               (y >= console_tv_h + console_tv_y - 1 && y <= console_tv_h + console_tv_y - 1 + border_width)) {
-                gfx_draw_plot(GFX_TV, x, y, border_color);
-            }
-            else {
-                //gfx_draw_plot(GFX_DRC, x, y, background_color);
-            }
-        }
+    if (full) {
+        console_draw_border(GFX_DRC, console_x, console_y, console_w, console_h);
+        console_draw_border(GFX_TV, console_tv_x, console_tv_y, console_tv_w, console_tv_h);
     }
 
-    for(i = 0; i < lines; i++) {
-        for (int j = console_x; j < console_w-CHAR_WIDTH; j += CHAR_WIDTH) {
-            gfx_draw_string(GFX_DRC, " ", j + CHAR_WIDTH * 1, i * CHAR_WIDTH + console_y + CHAR_WIDTH * 2, background_color);
-            gfx_draw_string(GFX_TV, " ", j + CHAR_WIDTH * 1, i * CHAR_WIDTH + console_y + CHAR_WIDTH * 2, background_color);
+    for(i = 0; i < count; i++) {
+        const char* text = i < lines ? console[i] : "";
+        bool changed = strcmp(text, console_shown[i]) != 0;
+
+        if (full || changed) {
+            int line_y = i * CHAR_WIDTH + console_y + CHAR_WIDTH * 2;
+
+            gfx_fill_rect(GFX_ALL, console_x + CHAR_WIDTH, line_y, console_w - CHAR_WIDTH * 2, 8, background_color);
+            gfx_draw_string(GFX_DRC, (char*)text, console_x + CHAR_WIDTH * 1, line_y, text_color);
+            gfx_draw_string(GFX_TV, (char*)text, console_x + CHAR_WIDTH * 1, line_y, text_color);
         }
-        gfx_draw_string(GFX_DRC, console[i], console_x + CHAR_WIDTH * 1, i * CHAR_WIDTH + console_y + CHAR_WIDTH * 2, text_color);
-        gfx_draw_string(GFX_TV, console[i], console_x + CHAR_WIDTH * 1, i * CHAR_WIDTH + console_y + CHAR_WIDTH * 2, text_color);
+
         //if (gfx_is_currently_headless()) 
-        {
-            serial_printf("%s\n", console[i]);
+        if (!serial_partial) {
+            if (i < lines)
+                serial_printf("%s\n", text);
+        }
+        else if (changed) {
+            serial_printf("\033[%d;1H\033[2K%s", i + 1, text);
         }
+
+        strncpy(console_shown[i], text, MAX_LINE_LENGTH);
+    }
+
+    if (serial_partial && count) {
+        serial_printf("\033[%d;1H", lines + 1);
     }
+
+    console_shown_lines = lines;
+    console_shown_color = text_color;
+    console_shown_x = console_x;
+    console_shown_y = console_y;
+    console_shown_epoch = epoch;
+
+    console_serial_flushed = false;
+    console_serial_valid = serial_partial || serial_cleared;
+    console_serial_count = serial_get_output_count();
 }
 
 void console_flush()
 {
     //if (gfx_is_currently_headless())
     {
-        serial_clear();
+        console_serial_flushed = true;
     }
 
     lines = 0;
@@ -315,6 +348,8 @@ int console_select_poll()
 {
     int ret = 0;
 
+    // Everyone waiting for input ends up here, let background tasks run.
+    task_yield();
     serial_poll();
     console_serial_len = serial_in_read(console_serial_tmp);
     for (int i = 0; i < console_serial_len; i++) {
@@ -419,5 +454,9 @@ int console_select_poll()
     if(input & SMC_EJECT_BUTTON) ret |= CONSOLE_KEY_EJECT;
     if(input & SMC_POWER_BUTTON) ret |= CONSOLE_KEY_POWER;
 
+    // Nothing happened, doze until the next button poll instead of spinning.
+    if(!ret && !console_serial_len)
+        smc_events_idle();
+
     return ret;
 }
\ No newline at end of file
@@ -0,0 +1,189 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#include "crashlog.h"
+
+#ifndef MINUTE_BOOT1
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "latte.h"
+#include "memory.h"
+#include "crc32.h"
+#include "rtc.h"
+#include "exception.h"
+
+extern u8 __crashlog_start[], __crashlog_end[];
+extern u8 __text_start[], __text_end[];
+
+#define CRASHLOG_ENTRIES    ((u32)(__crashlog_end - __crashlog_start) / sizeof(crashlog_entry))
+#define CRASHLOG_SLOT(i)    ((crashlog_entry*)__crashlog_start + (i))
+
+// Stack words scanned for return addresses.
+#define CRASHLOG_WALK_WORDS (1024)
+
+static u32 _crashlog_crc(const crashlog_entry* e)
+{
+    return crc32(&e->type, sizeof(*e) - offsetof(crashlog_entry, type));
+}
+
+static bool _crashlog_valid(const crashlog_entry* e)
+{
+    return e->magic == CRASHLOG_MAGIC && e->crc == _crashlog_crc(e);
+}
+
+// Only our own image, stacks and heap; anything else could fault again.
+static bool _crashlog_readable(u32 addr)
+{
+    return !(addr & 3) && addr >= (u32)__text_start && addr < (u32)__crashlog_start;
+}
+
+// Looks for a bl/blx right before addr.
+static bool _crashlog_is_return(u32 addr)
+{
+    if((addr & 3) || addr < (u32)__text_start + 4 || addr >= (u32)__text_end)
+        return false;
+
+    u32 insn = read32(addr - 4);
+    return (insn & 0x0F000000) == 0x0B000000 ||     // bl
+           (insn & 0xFE000000) == 0xFA000000 ||     // blx imm
+           (insn & 0x0FFFFFF0) == 0x012FFF30;       // blx reg
+}
+
+void crashlog_record(u32 type, u32 spsr, const u32* regs, u32 pc, u32 far, u32 fsr)
+{
+    u32 count = CRASHLOG_ENTRIES;
+    u32 seq = 0, slot = 0;
+
+    for(u32 i = 0; i < count; i++) {
+        crashlog_entry* e = CRASHLOG_SLOT(i);
+        if(_crashlog_valid(e) && e->seq >= seq) {
+            seq = e->seq + 1;
+            slot = (i + 1) % count;
+        }
+    }
+
+    crashlog_entry* e = CRASHLOG_SLOT(slot);
+    memset(e, 0, sizeof(*e));
+    e->seq = seq;
+    e->type = type;
+    memcpy(e->regs, regs, 15 * sizeof(u32));
+    e->regs[15] = pc;
+    e->spsr = spsr;
+    e->cpsr = get_cpsr();
+    e->far = far;
+    e->fsr = fsr;
+    e->timestamp = read32(LT_TIMER);
+
+    u32 sp = regs[13];
+    for(int i = 0; i < CRASHLOG_STACK_WORDS && _crashlog_readable(sp + i * 4); i++)
+        e->stack[i] = read32(sp + i * 4);
+
+    // No frame pointers, so guess from what looks like a return address.
+    int frames = 0;
+    e->backtrace[frames++] = pc;
+    if(_crashlog_is_return(regs[14]))
+        e->backtrace[frames++] = regs[14];
+    for(int i = 0; i < CRASHLOG_WALK_WORDS && frames < CRASHLOG_BACKTRACE; i++) {
+        if(!_crashlog_readable(sp + i * 4))
+            break;
+        u32 val = read32(sp + i * 4);
+        if(_crashlog_is_return(val) && val != e->backtrace[frames - 1])
+            e->backtrace[frames++] = val;
+    }
+
+    e->crc = _crashlog_crc(e);
+    e->magic = CRASHLOG_MAGIC;
+    dc_flushrange(e, sizeof(*e));
+
+    // The SMC slot only says where to look.
+    char summary[64 + 1] = {0};
+    snprintf(summary, sizeof(summary), "minute crash #%lu: %s pc %08lx",
+             seq, exceptions[type], pc);
+    rtc_set_panic_reason(summary);
+}
+
+// Newest first.
+int crashlog_get(crashlog_entry* out, int max)
+{
+    u32 count = CRASHLOG_ENTRIES;
+    u32 below = 0xFFFFFFFF;
+    int found = 0;
+
+    while(found < max) {
+        crashlog_entry* newest = NULL;
+        for(u32 i = 0; i < count; i++) {
+            crashlog_entry* e = CRASHLOG_SLOT(i);
+            if(_crashlog_valid(e) && e->seq < below && (!newest || e->seq > newest->seq))
+                newest = e;
+        }
+        if(!newest)
+            break;
+
+        memcpy(&out[found++], newest, sizeof(*newest));
+        below = newest->seq;
+    }
+
+    return found;
+}
+
+void crashlog_clear(void)
+{
+    memset(__crashlog_start, 0, __crashlog_end - __crashlog_start);
+    dc_flushrange(__crashlog_start, __crashlog_end - __crashlog_start);
+}
+
+void crashlog_print(const crashlog_entry* e)
+{
+    printf("#%-4lu %-16s pc %08lx lr %08lx far %08lx t %08lx\n", e->seq,
+           exceptions[min(e->type, 8UL)], e->regs[15], e->regs[14], e->far, e->timestamp);
+}
+
+int crashlog_export(const crashlog_entry* e)
+{
+    char path[64];
+
+    if((mkdir("sdmc:/minute", 777) && errno != EEXIST) ||
+       (mkdir(CRASHLOG_DIR, 777) && errno != EEXIST))
+        return -1;
+
+    snprintf(path, sizeof(path), CRASHLOG_DIR "/crash_%04lu.txt", e->seq);
+    FILE* f = fopen(path, "w");
+    if(!f)
+        return -2;
+
+    const u32* regs = e->regs;
+    fprintf(f, "Exception %lu (%s), LT_TIMER %08lx\n", e->type, exceptions[min(e->type, 8UL)], e->timestamp);
+    fprintf(f, "  R0-R3: %08lx %08lx %08lx %08lx\n", regs[0], regs[1], regs[2], regs[3]);
+    fprintf(f, "  R4-R7: %08lx %08lx %08lx %08lx\n", regs[4], regs[5], regs[6], regs[7]);
+    fprintf(f, " R8-R11: %08lx %08lx %08lx %08lx\n", regs[8], regs[9], regs[10], regs[11]);
+    fprintf(f, "R12-R15: %08lx %08lx %08lx %08lx\n", regs[12], regs[13], regs[14], regs[15]);
+    fprintf(f, "SPSR: %08lx\nCPSR: %08lx\n", e->spsr, e->cpsr);
+    if(e->type == 3 || e->type == 4)
+        fprintf(f, "FSR:  %08lx (%s)\nFAR:  %08lx\n", e->fsr, aborts[e->fsr & 0xf], e->far);
+
+    fprintf(f, "\nBacktrace:\n");
+    for(int i = 0; i < CRASHLOG_BACKTRACE && e->backtrace[i]; i++)
+        fprintf(f, "  %08lx\n", e->backtrace[i]);
+
+    fprintf(f, "\nStack:\n");
+    for(int i = 0; i < CRASHLOG_STACK_WORDS; i += 4) {
+        fprintf(f, "%08lx: %08lx %08lx %08lx %08lx\n", regs[13] + i * 4,
+                e->stack[i], e->stack[i + 1], e->stack[i + 2], e->stack[i + 3]);
+    }
+
+    if(fclose(f))
+        return -3;
+    return 0;
+}
+
+#endif // MINUTE_BOOT1
@@ -0,0 +1,41 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#ifndef _CRASHLOG_H
+#define _CRASHLOG_H
+
+#include "types.h"
+
+#define CRASHLOG_MAGIC          (0x43524153) // "CRAS"
+#define CRASHLOG_STACK_WORDS    (64)
+#define CRASHLOG_BACKTRACE      (16)
+#define CRASHLOG_DIR            "sdmc:/minute/crash"
+
+// One exception, in the uninitialized crashlog region from stub.ld.
+typedef struct {
+    u32 magic;
+    u32 seq;
+    u32 crc;                                // crc32 of everything after it
+    u32 type;
+    u32 regs[16];                           // r15 is the faulting pc
+    u32 spsr;
+    u32 cpsr;
+    u32 far;
+    u32 fsr;
+    u32 timestamp;                          // LT_TIMER
+    u32 backtrace[CRASHLOG_BACKTRACE];      // pc, then return addresses
+    u32 stack[CRASHLOG_STACK_WORDS];        // from regs[13]
+} crashlog_entry;
+
+void crashlog_record(u32 type, u32 spsr, const u32* regs, u32 pc, u32 far, u32 fsr);
+int crashlog_get(crashlog_entry* out, int max);
+void crashlog_clear(void);
+
+void crashlog_print(const crashlog_entry* e);
+int crashlog_export(const crashlog_entry* e);
+
+#endif
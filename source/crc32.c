@@ -91,15 +91,140 @@ static const uint32_t crc32_tab[] = {
 };
 
 
+#ifndef MINUTE_BOOT1
+/*
+ * Slice-by-8: crc32_slice[k][n] is the crc of byte n followed by k zero
+ * bytes, so eight bytes fold in with eight independent lookups instead of
+ * a chain of eight. On big endian the tables hold byte swapped values and
+ * the crc is kept swapped inside the loop, so the data can be loaded a word
+ * at a time. Built from crc32_tab on first use, boot1 keeps the byte loop.
+ */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define CRC32_SWAP(x)	__builtin_bswap32(x)
+#else
+#define CRC32_SWAP(x)	(x)
+#endif
+
+#define CRC32_POLY	0xedb88320
+
+static uint32_t crc32_slice[8][256];
+// x^(2^n) mod p, for crc32_combine
+static uint32_t crc32_x2n[32];
+static int crc32_ready = 0;
+
+// a * b mod p, with x^0 in the msb.
+static uint32_t
+crc32_multmodp(uint32_t a, uint32_t b)
+{
+	uint32_t m = 1U << 31, p = 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = (b & 1) ? (b >> 1) ^ CRC32_POLY : b >> 1;
+	}
+	return p;
+}
+
+static void
+crc32_init(void)
+{
+	int n, k;
+
+	for (n = 0; n < 256; n++) {
+		uint32_t c = crc32_tab[n];
+		crc32_slice[0][n] = CRC32_SWAP(c);
+		for (k = 1; k < 8; k++) {
+			c = crc32_tab[c & 0xFF] ^ (c >> 8);
+			crc32_slice[k][n] = CRC32_SWAP(c);
+		}
+	}
+
+	crc32_x2n[0] = 1U << 30;	// x^1
+	for (n = 1; n < 32; n++)
+		crc32_x2n[n] = crc32_multmodp(crc32_x2n[n - 1], crc32_x2n[n - 1]);
+
+	crc32_ready = 1;
+}
+
 uint32_t
-crc32(const void *buf, size_t size)
+crc32_update(uint32_t crc, const void *buf, size_t size)
 {
 	const uint8_t *p = buf;
-	uint32_t crc;
+	const uint32_t (*t)[256] = crc32_slice;
+
+	if (!crc32_ready)
+		crc32_init();
+
+	crc = ~crc;
+	while (size && ((uint32_t)p & 3)) {
+		crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		size--;
+	}
+
+	crc = CRC32_SWAP(crc);
+	while (size >= 8) {
+		uint32_t w1 = *(const uint32_t *)p ^ crc;
+		uint32_t w2 = *(const uint32_t *)(p + 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		crc = t[7][w1 >> 24] ^ t[6][(w1 >> 16) & 0xFF] ^
+		      t[5][(w1 >> 8) & 0xFF] ^ t[4][w1 & 0xFF] ^
+		      t[3][w2 >> 24] ^ t[2][(w2 >> 16) & 0xFF] ^
+		      t[1][(w2 >> 8) & 0xFF] ^ t[0][w2 & 0xFF];
+#else
+		crc = t[7][w1 & 0xFF] ^ t[6][(w1 >> 8) & 0xFF] ^
+		      t[5][(w1 >> 16) & 0xFF] ^ t[4][w1 >> 24] ^
+		      t[3][w2 & 0xFF] ^ t[2][(w2 >> 8) & 0xFF] ^
+		      t[1][(w2 >> 16) & 0xFF] ^ t[0][w2 >> 24];
+#endif
+		p += 8;
+		size -= 8;
+	}
+	crc = CRC32_SWAP(crc);
 
-	crc = ~0U;
+	while (size--) {
+		crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	}
+	return crc ^ ~0U;
+}
+
+uint32_t
+crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+	uint32_t p = 1U << 31;	// x^0
+	int k = 3;		// x^(8 * len2)
+
+	if (!crc32_ready)
+		crc32_init();
+
+	while (len2) {
+		if (len2 & 1)
+			p = crc32_multmodp(crc32_x2n[k & 31], p);
+		len2 >>= 1;
+		k++;
+	}
+	return crc32_multmodp(p, crc1) ^ crc2;
+}
+#else
+uint32_t
+crc32_update(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	crc = ~crc;
 	while (size--) {
 		crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
     }
 	return crc ^ ~0U;
 }
+#endif
+
+uint32_t
+crc32(const void *buf, size_t size)
+{
+	return crc32_update(0, buf, size);
+}
@@ -46,5 +46,11 @@
 #define __CRC32_H
 
 uint32_t crc32(const void *buf, size_t size);
+// Continues a crc32() result (start from 0), e.g. over streamed data.
+uint32_t crc32_update(uint32_t crc, const void *buf, size_t size);
+#ifndef MINUTE_BOOT1
+// crc32 of A followed by B, from crc32(A), crc32(B) and B's length.
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+#endif
 
 #endif // __CRC32_H
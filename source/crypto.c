@@ -21,6 +21,7 @@
 #include "seeprom.h"
 #include "crc32.h"
 #include "serial.h"
+#include "task.h"
 
 #define     AES_CMD_RESET   0
 #define     AES_CMD_DECRYPT 0x9800
@@ -249,152 +250,236 @@ int crypto_encrypt_verify_seeprom_ptr(seeprom_t* pOut, seeprom_t* pSeeprom)
     return crypto_decrypt_verify_seeprom_ptr(&extra_verify, pOut);
 }
 
-static int _aes_irq = 0;
+#define AES_CTRL_EXEC       0x80000000
+#define AES_CTRL_IRQ        0x40000000
+#define AES_CTRL_ERR        0x20000000
+#define AES_CTRL_KEEP_IV    0x1000
+// aes_command has always used a 7-bit block count
+#define AES_MAX_BLOCKS      0x80
+
+static const u16 aes_job_cmds[] = {
+    [AES_JOB_DECRYPT] = AES_CMD_DECRYPT,
+    [AES_JOB_ENCRYPT] = AES_CMD_ENCRYPT,
+    [AES_JOB_COPY] = AES_CMD_COPY,
+};
+
+static aes_job *aes_queue_head = NULL, *aes_queue_tail = NULL;
+static bool aes_running = false;
+
+static u32 aes_key_cache[4];
+static bool aes_key_valid = false;
+
+static void _aes_load_key(const u8 *key)
+{
+    u32 key_tmp[4];
+    memcpy(key_tmp, key, sizeof(key_tmp));
+
+    if(aes_key_valid && !memcmp(key_tmp, aes_key_cache, sizeof(key_tmp)))
+        return;
+
+    for(int i = 0; i < 4; i++) {
+        write32(AES_KEY, key_tmp[i]);
+    }
+    memcpy(aes_key_cache, key_tmp, sizeof(key_tmp));
+    aes_key_valid = true;
+}
+
+static void _aes_write_iv(const u8 *iv)
+{
+    u32 iv_tmp[4] = {0};
+    if(iv) memcpy(iv_tmp, iv, sizeof(iv_tmp));
+
+    for(int i = 0; i < 4; i++) {
+        write32(AES_IV, iv_tmp[i]);
+    }
+}
+
+// Engine must be idle.
+static void _aes_start(aes_job *job)
+{
+    bool keep_iv = true;
+
+    if(!job->progress) {
+        if(job->key)
+            _aes_load_key(job->key);
+        if(job->flags & AES_JOB_SET_IV)
+            _aes_write_iv(job->iv);
+        keep_iv = !(job->flags & AES_JOB_SET_IV) && (job->flags & AES_JOB_KEEP_IV);
+        ahb_flush_to(RB_AES);
+    }
+
+    u32 blocks = min(job->blocks - job->progress, AES_MAX_BLOCKS);
+    job->chunk = blocks;
+
+    write32(AES_SRC, dma_addr(job->src + (job->progress << 4)));
+    write32(AES_DEST, dma_addr(job->dst + (job->progress << 4)));
+    write32(AES_CTRL, (aes_job_cmds[job->op] << 16) | AES_CTRL_IRQ |
+                      (keep_iv ? AES_CTRL_KEEP_IV : 0) | ((blocks - 1) & 0x7f));
+    aes_running = true;
+}
+
+// Call with IRQs disabled. Advances the queue if the engine went idle.
+static void _aes_service(void)
+{
+    aes_job *job = aes_queue_head;
+
+    if(aes_running) {
+        u32 ctrl = read32(AES_CTRL);
+        if(ctrl & AES_CTRL_EXEC)
+            return;
+        aes_running = false;
+
+        if(ctrl & AES_CTRL_ERR) {
+            job->result = -1;
+            write32(AES_CTRL, 0);
+            while (read32(AES_CTRL) != 0);
+            aes_key_valid = false;
+        } else {
+            job->progress += job->chunk;
+            if(job->progress < job->blocks) {
+                _aes_start(job);
+                return;
+            }
+        }
+
+        ahb_flush_from(WB_AES);
+        ahb_flush_to(RB_IOD);
+
+        aes_queue_head = job->next;
+        if(!aes_queue_head)
+            aes_queue_tail = NULL;
+        job->next = NULL;
+        job->state = AES_JOB_DONE;
+        if(job->callback)
+            job->callback(job);
+    }
+
+    // the callback may have queued (and started) another job
+    if(aes_queue_head && !aes_running)
+        _aes_start(aes_queue_head);
+}
 
 void aes_irq(void)
 {
-    _aes_irq = 1;
+    _aes_service();
+}
+
+void aes_job_init(aes_job *job, int op, void *src, void *dst, u32 blocks)
+{
+    memset(job, 0, sizeof(*job));
+    job->op = op;
+    job->src = src;
+    job->dst = dst;
+    job->blocks = blocks;
+}
+
+int aes_job_submit(aes_job *job)
+{
+    if(!job || job->op > AES_JOB_COPY || !job->blocks)
+        return -1;
+    if(job->state == AES_JOB_QUEUED)
+        return -2;
+
+    // Kinda have to do both flush/invalidate on both because if you crypt
+    // 1 block, an invalidate will corrupt the periphery memory in the cache
+    // line. In-place operations only need it once. The engine's own read
+    // path is flushed when the job starts.
+    dc_batch b;
+    dc_batch_init(&b);
+    dc_batch_flush_inval(&b, job->src, job->blocks * 16);
+    if(job->dst != job->src)
+        dc_batch_flush_inval(&b, job->dst, job->blocks * 16);
+    dc_batch_commit(&b, RB_IOD);
+
+    job->next = NULL;
+    job->progress = 0;
+    job->result = 0;
+    job->state = AES_JOB_QUEUED;
+
+    u32 cookie = irq_kill();
+    if(aes_queue_tail)
+        aes_queue_tail->next = job;
+    else
+        aes_queue_head = job;
+    aes_queue_tail = job;
+    if(!aes_running)
+        _aes_service();
+    irq_restore(cookie);
+
+    return 0;
 }
 
-static inline void aes_command(u16 cmd, u8 iv_keep, u32 blocks)
+int aes_job_wait(aes_job *job)
 {
-    if (blocks != 0)
-        blocks--;
-    _aes_irq = 0;
-    write32(AES_CTRL, (cmd << 16) | (iv_keep ? 0x1000 : 0) | (blocks&0x7f));
-    while (read32(AES_CTRL) & 0x80000000);
+    while(job->state == AES_JOB_QUEUED) {
+        // also covers builds where the AES IRQ is never taken
+        u32 cookie = irq_kill();
+        _aes_service();
+        irq_restore(cookie);
+        task_yield();
+    }
+    return job->result;
+}
+
+void aes_wait_idle(void)
+{
+    while(aes_queue_head) {
+        u32 cookie = irq_kill();
+        _aes_service();
+        irq_restore(cookie);
+        task_yield();
+    }
+}
+
+static void aes_run(int op, u8 *src, u8 *dst, u32 blocks, u8 keep_iv)
+{
+    if(!blocks) return;
+
+    aes_job job;
+    aes_job_init(&job, op, src, dst, blocks);
+    if(keep_iv)
+        job.flags |= AES_JOB_KEEP_IV;
+    aes_job_submit(&job);
+    aes_job_wait(&job);
 }
 
 void aes_reset(void)
 {
+    aes_wait_idle();
     write32(AES_CTRL, 0);
     while (read32(AES_CTRL) != 0);
+    aes_key_valid = false;
 }
 
 void aes_set_iv(u8 *iv)
 {
-    u32 iv_tmp[4];
-    memcpy(iv_tmp, iv, 4*sizeof(u32));
-
-    for(int i = 0; i < 4; i++) {
-        write32(AES_IV, iv_tmp[i]);
-    }
+    aes_wait_idle();
+    _aes_write_iv(iv);
 }
 
 void aes_empty_iv(void)
 {
-    for(int i = 0; i < 4; i++) {
-        write32(AES_IV, 0);
-    }
+    aes_wait_idle();
+    _aes_write_iv(NULL);
 }
 
 void aes_set_key(u8 *key)
 {
-    u32 key_tmp[4];
-    memcpy(key_tmp, key, 4*sizeof(u32));
-
-    for(int i = 0; i < 4; i++) {
-        write32(AES_KEY, key_tmp[i]);
-    }
+    aes_wait_idle();
+    _aes_load_key(key);
 }
 
 void aes_decrypt(u8 *src, u8 *dst, u32 blocks, u8 keep_iv)
 {
-    // Kinda have to do both flush/invalidate on both because if you crypt
-    // 1 block, an invalidate will corrupt the periphery memory in the cache
-    // line.
-    dc_flushrange(src, blocks * 16);
-    dc_invalidaterange(src, blocks * 16);
-    dc_flushrange(dst, blocks * 16);
-    dc_invalidaterange(dst, blocks * 16);
-    ahb_flush_to(RB_AES);
-
-    int this_blocks = 0;
-    while(blocks > 0) {
-        this_blocks = blocks;
-        if (this_blocks > 0x80)
-            this_blocks = 0x80;
-
-        write32(AES_SRC, dma_addr(src));
-        write32(AES_DEST, dma_addr(dst));
-
-        aes_command(AES_CMD_DECRYPT, keep_iv, this_blocks);
-
-        blocks -= this_blocks;
-        src += this_blocks<<4;
-        dst += this_blocks<<4;
-        keep_iv = 1;
-    }
-
-    ahb_flush_from(WB_AES);
-    ahb_flush_to(RB_IOD);
-    //dc_flushrange(dst, blocks * 16);
-    //dc_invalidaterange(dst, blocks * 16);
+    aes_run(AES_JOB_DECRYPT, src, dst, blocks, keep_iv);
 }
 
 void aes_encrypt(u8 *src, u8 *dst, u32 blocks, u8 keep_iv)
 {
-    // Kinda have to do both flush/invalidate on both because if you crypt
-    // 1 block, an invalidate will corrupt the periphery memory in the cache
-    // line.
-    dc_flushrange(src, blocks * 16);
-    dc_invalidaterange(src, blocks * 16);
-    dc_flushrange(dst, blocks * 16);
-    dc_invalidaterange(dst, blocks * 16);
-    ahb_flush_to(RB_AES);
-
-    int this_blocks = 0;
-    while(blocks > 0) {
-        this_blocks = blocks;
-        if (this_blocks > 0x80)
-            this_blocks = 0x80;
-
-        write32(AES_SRC, dma_addr(src));
-        write32(AES_DEST, dma_addr(dst));
-
-        aes_command(AES_CMD_ENCRYPT, keep_iv, this_blocks);
-
-        blocks -= this_blocks;
-        src += this_blocks<<4;
-        dst += this_blocks<<4;
-        keep_iv = 1;
-    }
-
-    ahb_flush_from(WB_AES);
-    ahb_flush_to(RB_IOD);
-    //dc_flushrange(dst, blocks * 16);
-    //dc_invalidaterange(dst, blocks * 16);
+    aes_run(AES_JOB_ENCRYPT, src, dst, blocks, keep_iv);
 }
 
 void aes_copy(u8 *src, u8 *dst, u32 blocks)
 {
-    // Kinda have to do both flush/invalidate on both because if you crypt
-    // 1 block, an invalidate will corrupt the periphery memory in the cache
-    // line.
-    dc_flushrange(src, blocks * 16);
-    dc_invalidaterange(src, blocks * 16);
-    dc_flushrange(dst, blocks * 16);
-    dc_invalidaterange(dst, blocks * 16);
-    ahb_flush_to(RB_AES);
-
-    int this_blocks = 0;
-    while(blocks > 0) {
-        this_blocks = blocks;
-        if (this_blocks > 0xFFF)
-            this_blocks = 0xFFF;
-
-        write32(AES_SRC, dma_addr(src));
-        write32(AES_DEST, dma_addr(dst));
-
-        aes_command(AES_CMD_COPY, false, this_blocks);
-
-        blocks -= this_blocks;
-        src += this_blocks<<4;
-        dst += this_blocks<<4;
-    }
-
-    ahb_flush_from(WB_AES);
-    ahb_flush_to(RB_IOD);
-    //dc_flushrange(dst, blocks * 16);
-    //dc_invalidaterange(dst, blocks * 16);
+    aes_run(AES_JOB_COPY, src, dst, blocks, 0);
 }
@@ -259,6 +259,47 @@ void crypto_decrypt_seeprom(void);
 int crypto_decrypt_verify_seeprom_ptr(seeprom_t* pOut, seeprom_t* pSeeprom);
 int crypto_encrypt_verify_seeprom_ptr(seeprom_t* pOut, seeprom_t* pSeeprom);
 
+enum {
+    AES_JOB_DECRYPT = 0,
+    AES_JOB_ENCRYPT,
+    AES_JOB_COPY,
+};
+
+#define AES_JOB_SET_IV      (1 << 0)    // load iv (NULL: zeroes) before the job
+#define AES_JOB_KEEP_IV     (1 << 1)    // continue from the previous job's IV
+
+#define AES_JOB_IDLE        (0)
+#define AES_JOB_QUEUED      (1)
+#define AES_JOB_DONE        (2)
+
+// One engine operation. Jobs run in submission order; key (if set) stays
+// loaded across jobs, so queueing jobs with the same key costs nothing.
+// src/dst must not be touched by the CPU until the job is done.
+typedef struct aes_job {
+    struct aes_job *next;
+    int op;
+    u32 flags;
+    const u8 *key;
+    const u8 *iv;
+    u8 *src;
+    u8 *dst;
+    u32 blocks;
+
+    u32 progress;
+    u32 chunk;
+    volatile int state;
+    volatile int result;
+
+    void (*callback)(struct aes_job *job);
+    void *priv;
+} aes_job;
+
+void aes_job_init(aes_job *job, int op, void *src, void *dst, u32 blocks);
+int aes_job_submit(aes_job *job);
+int aes_job_wait(aes_job *job);
+void aes_wait_idle(void);
+void aes_irq(void);
+
 void aes_reset(void);
 void aes_set_iv(u8 *iv);
 void aes_empty_iv();
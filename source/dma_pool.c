@@ -0,0 +1,164 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#include "dma_pool.h"
+
+#include "types.h"
+#include "utils.h"
+#include "memory.h"
+#include "irq.h"
+
+#include <stdio.h>
+#include <malloc.h>
+
+// Map the pool without the data cache, so dc_flushrange/dc_invalidaterange
+// on pool buffers only drain the buses. CPU access to the buffers gets slower.
+//#define DMA_POOL_UNCACHED
+//#define DMA_POOL_WRITE_COMBINE
+
+typedef struct {
+    u32 size;
+    u32 count;
+    u32 offset;
+    u32 free_mask;
+    u32 used;
+    u32 high_water;
+    u32 fallbacks;
+} dma_pool_class;
+
+// Largest first, so every slot stays DMA_POOL_ALIGN aligned.
+static dma_pool_class classes[DMA_POOL_CLASSES] = {
+    { DMA_POOL_BURST,   6 },    // BACKUP_QUEUE deep
+    { DMA_POOL_CLUSTER, 4 },
+    { DMA_POOL_PAGE,    16 },
+    { DMA_POOL_SECTOR,  16 },
+};
+
+#ifndef MINUTE_BOOT1
+// One MMU section, so it can be remapped on its own.
+#define DMA_POOL_SIZE (0x100000)
+static u8 dma_pool_mem[DMA_POOL_SIZE] ALIGNED(DMA_POOL_SIZE);
+#endif
+
+static u32 pool_start = 0, pool_end = 0;
+
+void dma_pool_init(void)
+{
+#ifndef MINUTE_BOOT1
+    u32 offset = 0;
+    for(int i = 0; i < DMA_POOL_CLASSES; i++) {
+        dma_pool_class* c = &classes[i];
+        c->offset = offset;
+        c->free_mask = (c->count < 32) ? ((1 << c->count) - 1) : 0xFFFFFFFF;
+        c->used = c->high_water = c->fallbacks = 0;
+        offset += c->size * c->count;
+    }
+
+    if(offset > DMA_POOL_SIZE) {
+        printf("dma_pool: classes need 0x%lx bytes, pool is 0x%x!\n", offset, DMA_POOL_SIZE);
+        panic(0);
+    }
+
+#ifdef DMA_POOL_UNCACHED
+#ifdef DMA_POOL_WRITE_COMBINE
+    mem_map_uncached(dma_pool_mem, DMA_POOL_SIZE, true);
+#else
+    mem_map_uncached(dma_pool_mem, DMA_POOL_SIZE, false);
+#endif
+#endif
+
+    pool_start = (u32)dma_pool_mem;
+    pool_end = pool_start + offset;
+#endif
+}
+
+void* dma_pool_alloc(u32 size)
+{
+    if(!size) return NULL;
+
+    // smallest class that fits
+    int best = DMA_POOL_CLASSES - 1;
+    while(best > 0 && size > classes[best].size)
+        best--;
+
+    // then the larger ones, before giving up on the pool
+    u32 cookie = irq_kill();
+    for(int i = best; i >= 0 && size <= classes[i].size; i--) {
+        dma_pool_class* c = &classes[i];
+        u32 mask = c->free_mask;
+        if(!mask)
+            continue;
+
+        u32 slot = __builtin_ctz(mask);
+        c->free_mask = mask & ~(1 << slot);
+        if(++c->used > c->high_water)
+            c->high_water = c->used;
+        irq_restore(cookie);
+        return (void*)(pool_start + c->offset + slot * c->size);
+    }
+    classes[best].fallbacks++;
+    irq_restore(cookie);
+
+    // Exhausted or too large, take it from the heap. Whole cache lines, so
+    // invalidating the buffer can't hit neighbouring allocations.
+    return memalign(DMA_POOL_ALIGN, ALIGN_FORWARD(size, DMA_POOL_ALIGN));
+}
+
+void dma_pool_free(void* p)
+{
+    u32 addr = (u32)p;
+    if(!p) return;
+
+    if(addr < pool_start || addr >= pool_end) {
+        free(p);
+        return;
+    }
+
+    for(int i = 0; i < DMA_POOL_CLASSES; i++) {
+        dma_pool_class* c = &classes[i];
+        u32 start = pool_start + c->offset;
+        if(addr < start || addr >= start + c->size * c->count)
+            continue;
+
+        u32 slot = (addr - start) / c->size;
+        u32 cookie = irq_kill();
+        if(c->free_mask & (1 << slot)) {
+            irq_restore(cookie);
+            printf("dma_pool: double free of %p!\n", p);
+            return;
+        }
+        c->free_mask |= 1 << slot;
+        c->used--;
+        irq_restore(cookie);
+        return;
+    }
+}
+
+int dma_pool_get_stats(dma_pool_stats* stats, int max)
+{
+    int i;
+    for(i = 0; i < DMA_POOL_CLASSES && i < max; i++) {
+        stats[i].size = classes[i].size;
+        stats[i].count = pool_start ? classes[i].count : 0;
+        stats[i].used = classes[i].used;
+        stats[i].high_water = classes[i].high_water;
+        stats[i].fallbacks = classes[i].fallbacks;
+    }
+    return i;
+}
+
+void dma_pool_print_stats(void)
+{
+    dma_pool_stats stats[DMA_POOL_CLASSES];
+    int n = dma_pool_get_stats(stats, DMA_POOL_CLASSES);
+
+    printf("dma_pool:   size  used/count  high  heap\n");
+    for(int i = 0; i < n; i++) {
+        printf("dma_pool: %6lx  %4lu/%-5lu  %4lu  %4lu\n", stats[i].size,
+               stats[i].used, stats[i].count, stats[i].high_water, stats[i].fallbacks);
+    }
+}
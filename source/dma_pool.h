@@ -0,0 +1,39 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#ifndef _DMA_POOL_H
+#define _DMA_POOL_H
+
+#include "types.h"
+
+// Every pool buffer is aligned to at least this (NAND_DATA_ALIGN, SHA).
+#define DMA_POOL_ALIGN      (128)
+
+#define DMA_POOL_SECTOR     (0x200)
+#define DMA_POOL_PAGE       (0x880)     // page + spare, rounded to DMA_POOL_ALIGN
+#define DMA_POOL_CLUSTER    (0x4000)
+#define DMA_POOL_BURST      (0x21000)   // a full backup RAW chunk, 64 pages + spare
+
+typedef struct {
+    u32 size;
+    u32 count;
+    u32 used;
+    u32 high_water;
+    u32 fallbacks;
+} dma_pool_stats;
+
+#define DMA_POOL_CLASSES    (4)
+
+void dma_pool_init(void);
+
+void* dma_pool_alloc(u32 size);
+void dma_pool_free(void* p);
+
+int dma_pool_get_stats(dma_pool_stats* stats, int max);
+void dma_pool_print_stats(void);
+
+#endif
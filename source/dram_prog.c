@@ -0,0 +1,288 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#include "dram_prog.h"
+#include "dram.h"
+#include "latte.h"
+
+// Same sequence mem_clocks_related_3__3___DdrCafeInit used to open-code,
+// which was lifted from boot1/c2w. Keep the order, the sequencer cares.
+
+#define MEM_OFS(r)      ((u16)((r) - MEM_REG_BASE))
+
+#define W16(r, v)       { DRAM_OP_W16, MEM_OFS(r), (v) }
+#define SET16(r, v)     { DRAM_OP_SET16, MEM_OFS(r), (v) }
+#define R16(r)          { DRAM_OP_R16, MEM_OFS(r), 0 }
+#define SEQ(a, v)       { DRAM_OP_SEQ, (a), (v) }
+#define DELAY(us)       { DRAM_OP_DELAY, 0, (us) }
+
+#define ARRAY_LEN(a)    (sizeof(a) / sizeof(*(a)))
+
+//                        mhz   tcl twl madj  sadj recen0  recen1 pll
+static const dram_profile dram_profile_864 =
+                        { 864,  7,  6,  0xFA, 12,  0x7C0,  0,     &dram_3_pllcfg };
+static const dram_profile dram_profile_1431 =
+                        { 1431, 11, 8,  0x82, 11,  0xFC00, 0,     &dram_2_pllcfg };
+static const dram_profile dram_profile_1593 =
+                        { 1593, 11, 8,  0x82, 6,   0xF800, 0,     &dram_1_pllcfg };
+static const dram_profile dram_profile_1593_hw28 =
+                        { 1593, 11, 8,  0x82, 8,   0xF800, 0,     &dram_1_pllcfg };
+static const dram_profile dram_profile_1593_hw10 =
+                        { 1593, 11, 8,  0x82, 11,  0xF800, 1,     &dram_1_pllcfg };
+
+// Skipped on CCBOOT.
+static const dram_op dram_ops_idk[] = {
+    W16(MEM_REG_BASE + 0x4E6, 0x970),
+    W16(MEM_REG_BASE + 0x4E8, 0),
+    W16(MEM_REG_BASE + 0x4EA, 0),
+    R16(MEM_REG_BASE + 0x4E8),
+    R16(MEM_REG_BASE + 0x4EA),
+
+    W16(MEM_REG_BASE + 0x4E0, 0x83B),
+    W16(MEM_REG_BASE + 0x4E2, 0x1FD),
+    W16(MEM_REG_BASE + 0x4E4, 0),
+    R16(MEM_REG_BASE + 0x4E8),
+    R16(MEM_REG_BASE + 0x4EA),
+
+    W16(MEM_REG_BASE + 0x4E0, 0x809),
+    W16(MEM_REG_BASE + 0x4E2, 0),
+    W16(MEM_REG_BASE + 0x4E4, 0xFFFF),
+    R16(MEM_REG_BASE + 0x4E8),
+    R16(MEM_REG_BASE + 0x4EA),
+
+    W16(MEM_REG_BASE + 0x4E0, 0x835),
+    W16(MEM_REG_BASE + 0x4E2, 0x8016),
+    W16(MEM_REG_BASE + 0x4E4, 0),
+    R16(MEM_REG_BASE + 0x4E8),
+    R16(MEM_REG_BASE + 0x4EA),
+};
+
+static const dram_op dram_ops_arb[] = {
+    W16(MEM_SEQRD_HWM, 8),
+    W16(MEM_SEQWR_HWM, 12),
+    W16(MEM_SEQCMD_HWM, 24),
+    W16(MEM_ARB_MAXWR, 6),
+    W16(MEM_ARB_MINRD, 6),
+    W16(MEM_WRMUX, 8),
+    W16(MEM_CPUAHM_WR_T, 4),
+    W16(MEM_ACC_WR_T, 4),
+    W16(MEM_DMAAHM0_WR_T, 4),
+    W16(MEM_DMAAHM1_WR_T, 4),
+    W16(MEM_PI_WR_T, 4),
+    W16(MEM_PE_WR_T, 5),
+    W16(MEM_IO_WR_T, 4),
+    W16(MEM_DSP_WR_T, 4),
+    W16(MEM_ACC_WR_T, 4),
+    SET16(MEM_UNK_306, 1),
+    W16(MEM_RDPR_PI, 16),
+    W16(MEM_COLMSK, 0x3FF),
+    W16(MEM_ROWMSK, 0x7FFF),
+    W16(MEM_BANKMSK, 7),
+    W16(MEM_RANKSEL, 5),
+    W16(MEM_COLSEL, 4),
+    W16(MEM_ROWSEL, 5),
+    W16(MEM_BANKSEL, 3),
+};
+
+static const dram_op dram_ops_pads[] = {
+    SEQ(DDR_SEQ_ODTDYN, 1),
+    SEQ(DDR_SEQ_ODTON, 0),
+    SEQ(DDR_SEQ_NPLCONF, 8),
+    SEQ(DDR_SEQ_BANK4, 0),
+    SEQ(DDR_SEQ_QSDEF, 1),
+    SEQ(DDR_SEQ_STR0, 0x318C),
+    SEQ(DDR_SEQ_STR1, 0x318C),
+    SEQ(DDR_SEQ_STR2, 0x318C),
+    SEQ(DDR_SEQ_STR3, 204),
+    SEQ(DDR_SEQ_APAD0, 0xE8EE),
+    SEQ(DDR_SEQ_APAD1, 3),
+    SEQ(DDR_SEQ_CKPAD0, 0xE8EE),
+    SEQ(DDR_SEQ_CKPAD1, 3),
+    SEQ(DDR_SEQ_CMDPAD0, 0xE8EE),
+    SEQ(DDR_SEQ_CMDPAD1, 3),
+    SEQ(DDR_SEQ_DQPAD0, 0xE6FE),
+    SEQ(DDR_SEQ_DQPAD1, 3),
+    SEQ(DDR_SEQ_QSPAD0, 0xF36E),
+    SEQ(DDR_SEQ_QSPAD1, 1),
+    SEQ(DDR_SEQ_BL4, 0),
+    SEQ(DDR_SEQ_DDR2, 1),
+    SEQ(DDR_SEQ_SYNC, 0),
+};
+
+// Mode register commands, issued through both EX ports.
+static const u16 dram_mrs_cmds[] = { 34, 35, 34, 36, 37, 36 };
+static const u16 dram_zq_cmds[][3] = { { 0x10, 17, 0x10 }, { 32, 33, 32 }, { 2, 3, 2 } };
+
+typedef struct {
+    dram_op *prog;
+    int count;
+    int max;
+} dram_prog_ctx;
+
+static void _emit(dram_prog_ctx *ctx, u16 op, u16 reg, u16 val)
+{
+    if (ctx->count < ctx->max) {
+        ctx->prog[ctx->count].op = op;
+        ctx->prog[ctx->count].reg = reg;
+        ctx->prog[ctx->count].val = val;
+    }
+    ctx->count++;
+}
+
+static void _emit_list(dram_prog_ctx *ctx, const dram_op *ops, int count)
+{
+    for (int i = 0; i < count; i++)
+        _emit(ctx, ops[i].op, ops[i].reg, ops[i].val);
+}
+
+static void _emit_ex(dram_prog_ctx *ctx, u16 addr, const u16 *cmds, int count)
+{
+    _emit(ctx, DRAM_OP_W16, MEM_OFS(MEM_ARB_EXADDR), addr);
+    for (int i = 0; i < count; i++)
+        _emit(ctx, DRAM_OP_W16, MEM_OFS(MEM_ARB_EXCMD), cmds[i]);
+    _emit(ctx, DRAM_OP_W16, MEM_OFS(MEM_UNK_2D0), addr); // c2w omits these regs
+    for (int i = 0; i < count; i++)
+        _emit(ctx, DRAM_OP_W16, MEM_OFS(MEM_UNK_2D2), cmds[i]);
+}
+
+const dram_profile* dram_prog_profile(u16 mode, u8 ddr3_speed, u32 bspVer)
+{
+    if ((mode & DRAM_MODE_CCBOOT) || ddr3_speed == 1)
+        return &dram_profile_864;
+    if (ddr3_speed == 3)
+        return &dram_profile_1431;
+
+    // ddr3_speed == 2, 0, ...
+    if ((bspVer & 0xFFFF) == 0x10)
+        return &dram_profile_1593_hw10;
+    if ((bspVer & 0xFFFF) == 0x28 || (bspVer & 0xFFFF) == 0x29)
+        return &dram_profile_1593_hw28;
+    return &dram_profile_1593;
+}
+
+// 7.8us refresh interval in controller clocks.
+u16 dram_prog_refresh(const dram_profile *p)
+{
+    return ((7800000u / (2000000u / p->mhz)) >> 1) - 1;
+}
+
+// Returns the number of ops, or -1 if they don't fit in max.
+int dram_prog_build(const dram_profile *p, u16 mode, u16 ddr3_size, dram_op *prog, int max)
+{
+    dram_prog_ctx ctx = { prog, 0, max };
+    u16 madj = p->madj | (p->madj << 8);
+    u16 sadj = p->sadj | (p->sadj << 8);
+    u32 qsoe = 0x1FFC0u << ((2 * p->twl) - 4);
+    u16 mr0 = (p->tcl == 11) ? 0x1D70 : 0x1D30; // used in c2w
+    u16 mr2 = (p->twl == 8) ? 0x8018 : 0x8008; // used in c2w
+
+    _emit(&ctx, DRAM_OP_W16, MEM_OFS(MEM_COMPAT), 0); // c2w sets this to 4
+    _emit(&ctx, DRAM_OP_R16, MEM_OFS(MEM_COMPAT), 0);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_SYNC, 0);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_RSTB, (mode & DRAM_MODE_SREFRESH) != 0);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_CKEEN, 0);
+    _emit(&ctx, DRAM_OP_W16, MEM_OFS(MEM_REFRESH_FLAG), 0);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_MADJL, madj);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_MADJH, madj);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_SADJ0L, sadj);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_SADJ0H, sadj);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_SADJ1L, sadj);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_SADJ1H, sadj);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_PAD1, 0xE0B);
+    _emit(&ctx, DRAM_OP_DELAY, 0, 2);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_PAD1, 0x60B);
+    _emit(&ctx, DRAM_OP_DELAY, 0, 2);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_PAD1, 0x20B);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_PAD0, 0x8040);
+    _emit(&ctx, DRAM_OP_R16, MEM_OFS(MEM_SEQ_REG_VAL), 0);
+    _emit(&ctx, DRAM_OP_R16, MEM_OFS(MEM_SEQ0_REG_VAL), 0);
+    _emit(&ctx, DRAM_OP_DELAY, 0, 2);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_SYNC, 0);
+    _emit(&ctx, DRAM_OP_W16, MEM_OFS(MEM_ARB_MISC), 0xEFF);
+
+    if (!(mode & DRAM_MODE_CCBOOT))
+    {
+        // Four 9-register blocks at 0x600, only the second word differs
+        for (int i = 0; i < 4; i++)
+        {
+            u16 base = 0x600 + i * 0x12;
+            _emit(&ctx, DRAM_OP_W16, base, 0x5555);
+            _emit(&ctx, DRAM_OP_W16, base + 2, i ? 53 : 21);
+            _emit(&ctx, DRAM_OP_W16, base + 4, 15);
+            for (int j = 6; j < 0x12; j += 2)
+                _emit(&ctx, DRAM_OP_W16, base + j, 0);
+        }
+        _emit_list(&ctx, dram_ops_idk, ARRAY_LEN(dram_ops_idk));
+    }
+
+    _emit_list(&ctx, dram_ops_arb, ARRAY_LEN(dram_ops_arb));
+    if (ddr3_size == 0x1000)
+    {
+        _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_RANK2, 1);
+        _emit(&ctx, DRAM_OP_W16, MEM_OFS(MEM_CAFE_DDR_RANGE_TOP), 0xD000); // 3GB
+    }
+    else
+    {
+        _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_RANK2, 0);
+        _emit(&ctx, DRAM_OP_W16, MEM_OFS(MEM_CAFE_DDR_RANGE_TOP), 0x9000); // 2GB
+    }
+
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TCL, p->tcl - 1);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TWL, p->twl - 2);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TRFC, 239);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TRCDW, 10);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TRCDR, 10);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_QSOE0, qsoe);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_QSOE1, qsoe >> 16);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_QSOE2, 0);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_QSOE3, 0);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_ODT0, 255);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_ODT1, 0);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_RRL, (p->tcl > 7) ? 14 : 12);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_NPLRD, (p->tcl > 7) ? 268 : 266);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TRDWR, p->tcl - p->twl + 9);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TWRRD, p->twl + 9);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TRC, 38);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_RDPR, (p->tcl > 7) ? p->tcl + 4 : 14);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_WRPR, p->twl + 26);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TRRD, 5);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TFAW, 32);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_TR2R, 6);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_RECEN0, p->recen0);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_RECEN1, p->recen1);
+    _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_IDLEST, 18);
+    _emit_list(&ctx, dram_ops_pads, ARRAY_LEN(dram_ops_pads));
+
+    if (mode & DRAM_MODE_SREFRESH)
+    {
+        _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_CKEEN, 1);
+        _emit(&ctx, DRAM_OP_DELAY, 0, 2);
+    }
+    else
+    {
+        _emit(&ctx, DRAM_OP_DELAY, 0, 200);
+        _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_RSTB, 1);
+        _emit(&ctx, DRAM_OP_DELAY, 0, 500);
+        _emit(&ctx, DRAM_OP_SEQ, DDR_SEQ_CKEEN, 1);
+    }
+
+    if (!(mode & DRAM_MODE_10))
+    {
+        _emit_ex(&ctx, mr2, dram_mrs_cmds, ARRAY_LEN(dram_mrs_cmds));
+        _emit_ex(&ctx, 0xC000, dram_mrs_cmds, ARRAY_LEN(dram_mrs_cmds));
+        _emit_ex(&ctx, 0x4040, dram_mrs_cmds, ARRAY_LEN(dram_mrs_cmds));
+        _emit_ex(&ctx, mr0, dram_mrs_cmds, ARRAY_LEN(dram_mrs_cmds));
+        _emit_ex(&ctx, 0xFFFF, dram_zq_cmds[0], 3);
+        _emit(&ctx, DRAM_OP_DELAY, 0, 2);
+        _emit_ex(&ctx, 0xFFFF, dram_zq_cmds[1], 3);
+        _emit_ex(&ctx, 0xFFFF, dram_zq_cmds[2], 3);
+    }
+
+    _emit(&ctx, DRAM_OP_W16, MEM_OFS(MEM_REFRESH_FLAG), dram_prog_refresh(p));
+
+    return (ctx.count <= max) ? ctx.count : -1;
+}
@@ -0,0 +1,57 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#ifndef _DRAM_PROG_H
+#define _DRAM_PROG_H
+
+#include "types.h"
+#include "pll.h"
+
+/*
+ * MEM2 controller and DDR3 sequencer setup as data.
+ *
+ * A dram_profile holds what differs between speed grades, dram_prog_build
+ * expands it into a flat list of register ops and dram_prog_run (dram.c)
+ * executes that list. The builder never touches hardware, so its output can
+ * be diffed against a register trace of the old code on the host.
+ */
+
+#define DRAM_OP_W16     (1)     // write16(MEM_REG_BASE + reg, val)
+#define DRAM_OP_SET16   (2)     // set16(MEM_REG_BASE + reg, val)
+#define DRAM_OP_R16     (3)     // read16(MEM_REG_BASE + reg), flushes posted writes
+#define DRAM_OP_SEQ     (4)     // ddr_seq_write16(reg, val)
+#define DRAM_OP_DELAY   (5)     // udelay(val)
+
+typedef struct dram_op
+{
+    u16 op;
+    u16 reg;
+    u16 val;
+} dram_op;
+
+typedef struct dram_profile
+{
+    u16 mhz;
+    u8 tcl;
+    u8 twl;
+    u8 madj;
+    u8 sadj;
+    u16 recen0;
+    u16 recen1;
+    bsp_pll_cfg *pll;
+} dram_profile;
+
+// Longest program any profile/mode builds, with some headroom.
+#define DRAM_PROG_MAX   (320)
+
+const dram_profile* dram_prog_profile(u16 mode, u8 ddr3_speed, u32 bspVer);
+u16 dram_prog_refresh(const dram_profile *p);
+int dram_prog_build(const dram_profile *p, u16 mode, u16 ddr3_size, dram_op *prog, int max);
+// In dram.c, next to the code it replaced.
+void dram_prog_run(const dram_op *prog, int count);
+
+#endif // _DRAM_PROG_H
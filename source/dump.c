@@ -38,6 +38,9 @@
 
 #include "smc.h"
 #include "crypto.h"
+#include "dma_pool.h"
+#include "nand_health.h"
+#include "task.h"
 
 #ifndef MINUTE_BOOT1
 #ifndef FASTBOOT
@@ -93,15 +96,18 @@ menu menu_dump = {
             {"Delete scfm.img", &_dump_delete_scfm},
             {"Delete SLCCMPT scfm.img", &_dump_delete_scfm_slccmpt},
             {"Delete redNAND scfm.img", &_dump_delete_scfm_rednand},
+            {"Install ios_plugins to SLC", &dump_install_slc_plugins},
             {"Restore redNAND MLC", &dump_restore_rednand},
             {"Sync SEEPROM boot1 versions with NAND", &dump_sync_seeprom_boot1_versions},
             {"Set SEEPROM SATA device type", &dump_set_sata_type},
             {"Test SLC and Restore SLC.RAW", &dump_restore_test_slc_raw},
             {"Print SLC superblocks", &dump_print_slc_superblocks},
+            {"Scan SLC health", &dump_scan_slc_health},
+            {"Scan SLCCMPT health", &dump_scan_slccmpt_health},
             {"Print MLC Info", &dump_print_mlc_info_menu},
             {"Return to Main Menu", &menu_close},
     },
-    29, // number of options
+    32, // number of options
     0,
     0
 };
@@ -347,7 +353,7 @@ void dump_factory_log()
         printf("Failed to open sdmc:/factory-log.txt\n");
         goto close_ret;
     }
-    u8* sector_buf = memalign(32, SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
+    u8* sector_buf = dma_pool_alloc(SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
 
     // calculate number of extra sectors
     u32 total_sec = mlc_get_card_info()->num_sectors;
@@ -373,7 +379,7 @@ void dump_factory_log()
         fwrite(sector_buf, 1, block_size_bytes, f_log);
     }
 
-    free(sector_buf);
+    dma_pool_free(sector_buf);
     printf("\nDone!\n");
 
 close_ret:
@@ -970,8 +976,8 @@ int _dump_mlc(u32 base)
     // and then wait for them both to complete at the end of each iteration.
     struct sdmmc_command mlc_cmd = {0}, sdcard_cmd = {0};
 
-    u8* sector_buf1 = memalign(32, SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
-    u8* sector_buf2 = memalign(32, SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
+    u8* sector_buf1 = dma_pool_alloc(SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
+    u8* sector_buf2 = dma_pool_alloc(SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
 
     u8* mlc_buf = sector_buf2;
     u8* sdcard_buf = sector_buf1;
@@ -1015,6 +1021,7 @@ int _dump_mlc(u32 base)
         }
 
         sdcard_sector += SDHC_BLOCK_COUNT_MAX;
+        task_set_progress(sector, mlc_sectors);
 
         if((sector % 0x10000) == 0) {
             printf("MLC: Sector 0x%08lX completed\n", sector);
@@ -1025,8 +1032,8 @@ int _dump_mlc(u32 base)
     do res = sdcard_write(sdcard_sector, SDHC_BLOCK_COUNT_MAX, sdcard_buf);
     while(res);
 
-    free(sector_buf1);
-    free(sector_buf2);
+    dma_pool_free(sector_buf1);
+    dma_pool_free(sector_buf2);
 
     return 0;
 }
@@ -1059,8 +1066,8 @@ int _dump_restore_mlc(u32 base)
     // and then wait for them both to complete at the end of each iteration.
     struct sdmmc_command mlc_cmd = {0}, sdcard_cmd = {0};
 
-    u8* sector_buf1 = memalign(32, SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
-    u8* sector_buf2 = memalign(32, SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
+    u8* sector_buf1 = dma_pool_alloc(SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
+    u8* sector_buf2 = dma_pool_alloc(SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX);
 
     u8* mlc_buf = sector_buf2;
     u8* sdcard_buf = sector_buf1;
@@ -1144,24 +1151,38 @@ int _dump_restore_mlc(u32 base)
 
         sdcard_sector += SDHC_BLOCK_COUNT_MAX;
         mlc_sector += SDHC_BLOCK_COUNT_MAX;
+        task_set_progress(mlc_sector, mlc_sectors);
     }
 
     // Finish up the last iteration.
     do res = mlc_write(mlc_sector, SDHC_BLOCK_COUNT_MAX, mlc_buf);
     while(res);
 
-    free(sector_buf1);
-    free(sector_buf2);
+    dma_pool_free(sector_buf1);
+    dma_pool_free(sector_buf2);
 
     return 0;
 }
 
+// Allocates size bytes for an empty file in one run and returns the card
+// sector it starts at, or 0 if FatFs couldn't find a large enough run.
+static u32 _dump_file_expand(FIL* file, u32 size)
+{
+    FRESULT fres = f_expand(file, size, NULL);
+    if(fres != FR_OK) {
+        printf("No contiguous space for %lu bytes (%d), writing through FatFs.\n", size, fres);
+        return 0;
+    }
+    return f_sector(file);
+}
+
 int _dump_slc_raw(u32 bank, int boot1_only)
 {
     #define PAGES_PER_ITERATION (0x10)
     #define TOTAL_ITERATIONS ((boot1_only ? BOOT1_MAX_PAGE : NAND_MAX_PAGE) / PAGES_PER_ITERATION)
+    #define SECTORS_PER_ITERATION (sizeof(file_buf[0]) / SDMMC_DEFAULT_BLOCKLEN)
 
-    static u8 file_buf[PAGES_PER_ITERATION][PAGE_SIZE + PAGE_SPARE_SIZE];
+    static u8 file_buf[2][PAGES_PER_ITERATION][PAGE_SIZE + PAGE_SPARE_SIZE] ALIGNED(NAND_DATA_ALIGN);
 
     sdcard_ack_card();
     if(sdcard_check_card() != SDMMC_INSERTED) {
@@ -1191,33 +1212,70 @@ int _dump_slc_raw(u32 bank, int boot1_only)
         return -3;
     }
 
+    // With the whole image allocated in one run, pages go straight to the
+    // card and the FAT is only written once. Fragmented cards fall back to
+    // f_write.
+    u32 lba = _dump_file_expand(&file, TOTAL_ITERATIONS * sizeof(file_buf[0]));
+
     printf("Initializing %s...\n", name);
     nand_initialize(bank);
 
+    struct sdmmc_command cmd = {0};
+    bool pending = false;
+    int res = 0;
     for(u32 i = 0; i < TOTAL_ITERATIONS; i++)
     {
+        u8 (*buf)[PAGE_SIZE + PAGE_SPARE_SIZE] = file_buf[i & 1];
         u32 page_base = i * PAGES_PER_ITERATION;
         for(u32 page = 0; page < PAGES_PER_ITERATION; page++)
         {
             nand_read_page(page_base + page, nand_page_buf, nand_ecc_buf);
             nand_correct(page_base + page, nand_page_buf, nand_ecc_buf);
 
-            memcpy(file_buf[page], nand_page_buf, PAGE_SIZE);
-            memcpy(file_buf[page] + PAGE_SIZE, nand_ecc_buf, PAGE_SPARE_SIZE);
+            memcpy(buf[page], nand_page_buf, PAGE_SIZE);
+            memcpy(buf[page] + PAGE_SIZE, nand_ecc_buf, PAGE_SPARE_SIZE);
         }
 
-        fres = f_write(&file, file_buf, sizeof(file_buf), &btx);
-        if(fres != FR_OK || btx != sizeof(file_buf)) {
-            f_close(&file);
-            printf("Failed to write %s (%d).\n", path, fres);
-            return -4;
+        // The previous chunk was written while we read this one.
+        if(pending) {
+            pending = false;
+            if(sdcard_end_write(&cmd)) {
+                res = -4;
+                break;
+            }
         }
 
+        if(lba) {
+            if(sdcard_start_write(lba + i * SECTORS_PER_ITERATION, SECTORS_PER_ITERATION, buf, &cmd)) {
+                res = -4;
+                break;
+            }
+            pending = true;
+        } else {
+            fres = f_write(&file, buf, sizeof(file_buf[0]), &btx);
+            if(fres != FR_OK || btx != sizeof(file_buf[0])) {
+                res = -4;
+                break;
+            }
+        }
+        task_set_progress(page_base + PAGES_PER_ITERATION, PAGES_PER_ITERATION * TOTAL_ITERATIONS);
+
         if((i % 0x100) == 0) {
             printf("%s-RAW: Page 0x%05lX / 0x%05lX completed\n", name, page_base, PAGES_PER_ITERATION * TOTAL_ITERATIONS);
         }
     }
 
+    if(pending && sdcard_end_write(&cmd))
+        res = -4;
+    if(res) {
+        f_close(&file);
+        printf("Failed to write %s (%d).\n", path, fres ? fres : res);
+        // A preallocated image is full size however far it got.
+        if(lba)
+            f_unlink(path);
+        return res;
+    }
+
     fres = f_close(&file);
     if(fres != FR_OK) {
         printf("Failed to close %s (%d).\n", path, fres);
@@ -1228,6 +1286,7 @@ int _dump_slc_raw(u32 bank, int boot1_only)
 
     #undef PAGES_PER_ITERATION
     #undef TOTAL_ITERATIONS
+    #undef SECTORS_PER_ITERATION
 }
 
 void _dump_print_superblocks(int volume){
@@ -1411,6 +1470,7 @@ int _dump_restore_slc_raw(u32 bank, int boot1_only, bool nand_test)
     u32 erase_test_failed = 0;
     u32 erase_test_failed_blocks = 0;
     u32 program_failed = 0;
+    u32 skipped_bad = 0;
 
 
     for(u32 page_base=0; page_base < total_pages; page_base += BLOCK_PAGES){
@@ -1432,6 +1492,14 @@ int _dump_restore_slc_raw(u32 bank, int boot1_only, bool nand_test)
             }
         }
 
+        // the health map knows this block won't take the data. blocks that
+        // are just unreadable are rewritten, that's what the restore is for
+        if(!nand_test && nand_health_get(bank, page_base / BLOCK_PAGES) == NAND_HEALTH_BAD){
+            printf("Skipping bad block 0x%03lX\n", page_base / BLOCK_PAGES);
+            skipped_bad++;
+            continue;
+        }
+
         if(nand_test){
             bool is_badblock = false;
             //Test if page can be fully programmed to 0
@@ -1455,7 +1523,12 @@ int _dump_restore_slc_raw(u32 bank, int boot1_only, bool nand_test)
             }
         }
 
-        nand_erase_block(page_base);
+        if(nand_erase_block(page_base) < 0){
+            printf("Failed to erase block 0x%03lX\n", page_base / BLOCK_PAGES);
+            nand_health_set(bank, page_base / BLOCK_PAGES, NAND_HEALTH_BAD);
+            program_failed += BLOCK_PAGES;
+            continue;
+        }
 
         if(nand_test){
             bool is_badblock = false;
@@ -1495,7 +1568,8 @@ int _dump_restore_slc_raw(u32 bank, int boot1_only, bool nand_test)
             if (!is_cleared) {
                 
                 //nand_correct(page_base + page, nand_page_buf, nand_ecc_buf);
-                nand_write_page_raw(page_base + page, nand_page_buf, nand_ecc_buf);
+                if (nand_write_page_raw(page_base + page, nand_page_buf, nand_ecc_buf) < 0)
+                    nand_health_set(bank, page_base / BLOCK_PAGES, NAND_HEALTH_BAD);
             }
 
             // This might not be optional? Bug?
@@ -1504,9 +1578,14 @@ int _dump_restore_slc_raw(u32 bank, int boot1_only, bool nand_test)
 
             if (memcmp(nand_page_buf, &file_buf[page*PAGE_STRIDE], PAGE_STRIDE)) {
                 printf("Failed to program page: 0x%05lX\n", page_base + page);
+                program_failed++;
             }
         }
 
+        // the block was rewritten, its old entry doesn't say much anymore
+        if(nand_health_loaded(bank) && nand_health_get(bank, page_base / BLOCK_PAGES) != NAND_HEALTH_BAD)
+            nand_health_check_block(bank, page_base / BLOCK_PAGES);
+
         if((page_base % (BLOCK_PAGES * 0x10)) == 0) 
         {
             printf("%s-RAW: Page 0x%05lX / 0x%05lX completed\n", name, page_base, total_pages);
@@ -1527,6 +1606,11 @@ int _dump_restore_slc_raw(u32 bank, int boot1_only, bool nand_test)
                     erase_test_failed, erase_test_failed_blocks);
     }
     printf("%u pages failed to program\n", program_failed);
+    if(skipped_bad)
+        printf("%lu bad blocks skipped\n", skipped_bad);
+
+    if(!ret && nand_health_loaded(bank) && nand_health_save(bank))
+        printf("Failed to update the %s health map\n", name);
 
     _dump_sync_seeprom_boot1_versions();
 
@@ -1622,12 +1706,22 @@ int _dump_restore_slc_img(u32 bank, int boot1_only)
             return -4;
         }
 
+        if(nand_health_get(bank, cluster / BLOCK_CLUSTERS) == NAND_HEALTH_BAD){
+            printf("Skipping bad block 0x%03lX\n", cluster / BLOCK_CLUSTERS);
+            program_failed++;
+            continue;
+        }
+
         isfs_hmac_meta seed = { .cluster = cluster };
         int res = isfs_write_volume(ctx, cluster, BLOCK_CLUSTERS, ISFSVOL_FLAG_HMAC | ISFSVOL_FLAG_READBACK, &seed, file_buf);
         if(res){
             printf("Failed to program block: 0x%05lX\n", cluster / BLOCK_CLUSTERS);
             program_failed++;
         }
+        if(res == ISFSVOL_ERROR_ERASE || res == ISFSVOL_ERROR_WRITE)
+            nand_health_set(bank, cluster / BLOCK_CLUSTERS, NAND_HEALTH_BAD);
+        else if(nand_health_loaded(bank))
+            nand_health_check_block(bank, cluster / BLOCK_CLUSTERS);
         if((cluster % (BLOCK_CLUSTERS * 0x10)) == 0) 
         {
             printf("%s: Page 0x%05lX / 0x%05lX completed\n", name, cluster * CLUSTER_PAGES, total_pages);
@@ -1643,6 +1737,9 @@ int _dump_restore_slc_img(u32 bank, int boot1_only)
 
     printf("%u pages failed to program\n", program_failed);
 
+    if(!ret && nand_health_loaded(bank) && nand_health_save(bank))
+        printf("Failed to update the %s health map\n", name);
+
     _dump_sync_seeprom_boot1_versions();
 
     return ret;
@@ -1710,7 +1807,107 @@ int _dump_slc_to_sdcard_sectors(u32 base, u32 bank)
     #undef TOTAL_ITERATIONS
 }
 
-int _dump_copy_rednand(u32 slc_base, u32 slccmpt_base, u32 mlc_base)
+// One SD writer fed by two independent readers: the eMMC (async DMA on SD2)
+// and the NAND controller (page at a time, driven from here). While the SD
+// card writes chunk N, the eMMC fetches the next MLC chunk and the CPU reads
+// NAND pages, so the total time approaches what the SD card can write.
+#define BACKUP_CHUNK_SECTORS    (SDHC_BLOCK_COUNT_MAX)
+#define BACKUP_CHUNK_PAGES      (BACKUP_CHUNK_SECTORS / (PAGE_SIZE / SDMMC_DEFAULT_BLOCKLEN))
+#define BACKUP_RAW_PAGE         (PAGE_SIZE + PAGE_SPARE_SIZE)
+#define BACKUP_QUEUE            (6)
+_Static_assert(BACKUP_CHUNK_PAGES * BACKUP_RAW_PAGE <= DMA_POOL_BURST, "RAW chunk exceeds DMA_POOL_BURST");
+#define BACKUP_RETRIES          (16)
+
+typedef struct {
+    u8* buf;
+    FIL* file;      // NULL: raw sectors at lba
+    u32 lba;
+    u32 size;       // sectors for raw, bytes for files
+    u32 done;       // sectors already written
+} backup_item;
+
+typedef struct {
+    backup_item items[BACKUP_QUEUE];
+    u32 head, count;
+} backup_queue;
+
+typedef struct {
+    const char* name;
+    u32 bank;
+    u32 base;       // redNAND partition, 0 to skip
+    FIL file;
+    bool raw;       // also write <name>.RAW with spare
+    u32 raw_lba;    // where .RAW starts on the card, 0 if fragmented
+    u32 page;
+} backup_nand;
+
+static void _backup_push(backup_queue* q, u8* buf, FIL* file, u32 lba, u32 size)
+{
+    backup_item* it = &q->items[(q->head + q->count++) % BACKUP_QUEUE];
+    it->buf = buf;
+    it->file = file;
+    it->lba = lba;
+    it->size = size;
+    it->done = 0;
+}
+
+static void _backup_pop(backup_queue* q)
+{
+    dma_pool_free(q->items[q->head].buf);
+    q->head = (q->head + 1) % BACKUP_QUEUE;
+    q->count--;
+}
+
+// Reads the next chunk of the current bank, queueing up to two items.
+static int _backup_nand_chunk(backup_queue* q, backup_nand* n)
+{
+    u8* data = dma_pool_alloc(BACKUP_CHUNK_PAGES * PAGE_SIZE);
+    u8* raw = n->raw ? dma_pool_alloc(BACKUP_CHUNK_PAGES * BACKUP_RAW_PAGE) : NULL;
+    if(!data || (n->raw && !raw)) {
+        dma_pool_free(data);
+        dma_pool_free(raw);
+        return -1;
+    }
+
+    if(n->page == 0) {
+        printf("Initializing %s...\n", n->name);
+        nand_initialize(n->bank);
+    }
+
+    for(u32 i = 0; i < BACKUP_CHUNK_PAGES; i++) {
+        u8* page = data + i * PAGE_SIZE;
+        int retries = 0;
+        while(nand_read_page(n->page + i, page, nand_ecc_buf)) {
+            if(++retries > BACKUP_RETRIES) {
+                printf("%s: Failed to read page 0x%05lX\n", n->name, n->page + i);
+                dma_pool_free(data);
+                dma_pool_free(raw);
+                return -1;
+            }
+        }
+        nand_correct(n->page + i, page, nand_ecc_buf);
+
+        if(raw) {
+            memcpy(raw + i * BACKUP_RAW_PAGE, page, PAGE_SIZE);
+            memcpy(raw + i * BACKUP_RAW_PAGE + PAGE_SIZE, nand_ecc_buf, PAGE_SPARE_SIZE);
+        }
+    }
+
+    if(n->base)
+        _backup_push(q, data, NULL, n->base + n->page * (PAGE_SIZE / SDMMC_DEFAULT_BLOCKLEN), BACKUP_CHUNK_SECTORS);
+    else
+        dma_pool_free(data);
+    if(raw && n->raw_lba)
+        _backup_push(q, raw, NULL, n->raw_lba + n->page * BACKUP_RAW_PAGE / SDMMC_DEFAULT_BLOCKLEN,
+                     BACKUP_CHUNK_PAGES * BACKUP_RAW_PAGE / SDMMC_DEFAULT_BLOCKLEN);
+    else if(raw)
+        _backup_push(q, raw, &n->file, 0, BACKUP_CHUNK_PAGES * BACKUP_RAW_PAGE);
+
+    n->page += BACKUP_CHUNK_PAGES;
+    return 0;
+}
+
+int _dump_full_backup(u32 slc_base, u32 slccmpt_base, u32 mlc_base, bool raw_files)
 {
     sdcard_ack_card();
     if(sdcard_check_card() != SDMMC_INSERTED) {
@@ -1718,26 +1915,201 @@ int _dump_copy_rednand(u32 slc_base, u32 slccmpt_base, u32 mlc_base)
         return -1;
     }
 
-    if(slc_base == 0 && slccmpt_base == 0 && mlc_base == 0) {
+    if(slc_base == 0 && slccmpt_base == 0 && mlc_base == 0 && !raw_files) {
         return -2;
     }
 
-    // Dump SLC.
-    if(slc_base != 0) {
-        _dump_slc_to_sdcard_sectors(slc_base, NAND_BANK_SLC);
+    u32 mlc_sectors = 0;
+    if(mlc_base != 0) {
+        if(mlc_init()) {
+            printf("Error initilizing MLC\n");
+            return -3;
+        }
+        mlc_sectors = dump_get_iosu_mlc_sectors();
+        if(mlc_sectors == -1) {
+            printf("Error getting MLC size\n");
+            return -3;
+        }
     }
 
-    // Dump SLCCMPT.
-    if(slccmpt_base != 0) {
-        _dump_slc_to_sdcard_sectors(slccmpt_base, NAND_BANK_SLCCMPT);
+    backup_nand nand[2] = {
+        { .name = "SLC", .bank = NAND_BANK_SLC, .base = slc_base, .raw = raw_files },
+        { .name = "SLCCMPT", .bank = NAND_BANK_SLCCMPT, .base = slccmpt_base, .raw = raw_files },
+    };
+    int res = 0;
+
+    for(int i = 0; i < 2; i++) {
+        if(!nand[i].raw)
+            continue;
+
+        char path[64] = {0};
+        sprintf(path, "%s.RAW", nand[i].name);
+        FRESULT fres = f_open(&nand[i].file, path, FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
+        if(fres != FR_OK) {
+            printf("Failed to open %s (%d).\n", path, fres);
+            if(i && nand[0].raw) {
+                f_close(&nand[0].file);
+                if(nand[0].raw_lba)
+                    f_unlink("SLC.RAW");
+            }
+            return -4;
+        }
+        nand[i].raw_lba = _dump_file_expand(&nand[i].file, NAND_MAX_PAGE * BACKUP_RAW_PAGE);
     }
 
-    // Dump MLC.
-    if(mlc_base != 0) {
-        _dump_mlc(mlc_base);
+    backup_queue q = {0};
+    struct sdmmc_command mlc_cmd = {0}, sdcard_cmd = {0};
+    u8* mlc_buf = NULL;
+    bool mlc_pending = false, write_pending = false;
+    u32 mlc_sector = 0, mlc_count = 0, write_count = 0;
+    int mlc_retries = 0, write_retries = 0;
+    int cur = 0;
+
+    const u32 total = mlc_sectors + ((slc_base || raw_files) ? NAND_MAX_PAGE : 0) +
+                      ((slccmpt_base || raw_files) ? NAND_MAX_PAGE : 0);
+    u32 done = 0, written = 0, reported = 0;
+
+    while(true) {
+        while(cur < 2 && !nand[cur].base && !nand[cur].raw)
+            cur++;
+        if(cur < 2 && nand[cur].page >= NAND_MAX_PAGE) {
+            cur++;
+            continue;
+        }
+
+        bool mlc_left = mlc_sector < mlc_sectors;
+        if(!mlc_left && !mlc_pending && cur >= 2 && !q.count)
+            break;
+
+        // Writer: always the queue head, strictly in order.
+        if(!write_pending && q.count) {
+            backup_item* it = &q.items[q.head];
+            if(it->file) {
+                UINT btx = 0;
+                FRESULT fres = f_write(it->file, it->buf, it->size, &btx);
+                if(fres != FR_OK || btx != it->size) {
+                    printf("Failed to write RAW image (%d).\n", fres);
+                    res = -6;
+                    break;
+                }
+                _backup_pop(&q);
+                written++;
+            } else {
+                // .RAW chunks are a bit more than one command can take.
+                write_count = min(it->size - it->done, (u32)BACKUP_CHUNK_SECTORS);
+                if(!sdcard_start_write(it->lba + it->done, write_count,
+                                       it->buf + it->done * SDMMC_DEFAULT_BLOCKLEN, &sdcard_cmd))
+                    write_pending = true;
+                else if(++write_retries > BACKUP_RETRIES) {
+                    printf("SD: Failed to write sector 0x%08lX\n", it->lba + it->done);
+                    res = -6;
+                    break;
+                }
+            }
+        }
+
+        // A slot for an MLC chunk, two for a NAND chunk with RAW images.
+        // Counting every live buffer keeps them all in the DMA pool.
+        u32 room = BACKUP_QUEUE - q.count - (mlc_buf ? 1 : 0);
+
+        if(mlc_left && !mlc_pending && room >= 1) {
+            if(!mlc_buf)
+                mlc_buf = dma_pool_alloc(BACKUP_CHUNK_SECTORS * SDMMC_DEFAULT_BLOCKLEN);
+            if(!mlc_buf) {
+                res = -5;
+                break;
+            }
+            mlc_count = min(mlc_sectors - mlc_sector, (u32)BACKUP_CHUNK_SECTORS);
+            if(!mlc_start_read(mlc_sector, mlc_count, mlc_buf, &mlc_cmd)) {
+                mlc_pending = true;
+                room--;
+            } else if(++mlc_retries > BACKUP_RETRIES) {
+                printf("MLC: Failed to read sector 0x%08lX\n", mlc_sector);
+                res = -5;
+                break;
+            }
+        }
+
+        // Both DMA engines are busy now, so spend the time on NAND.
+        if(cur < 2 && room >= (nand[cur].base && nand[cur].raw ? 2 : 1)) {
+            if(_backup_nand_chunk(&q, &nand[cur])) {
+                res = -5;
+                break;
+            }
+            done += BACKUP_CHUNK_PAGES;
+        }
+
+        if(mlc_pending) {
+            mlc_pending = false;
+            if(!mlc_end_read(&mlc_cmd)) {
+                _backup_push(&q, mlc_buf, NULL, mlc_base + mlc_sector, mlc_count);
+                mlc_buf = NULL;
+                mlc_sector += mlc_count;
+                done += mlc_count;
+                mlc_retries = 0;
+            } else if(++mlc_retries > BACKUP_RETRIES) {
+                printf("MLC: Failed to read sector 0x%08lX\n", mlc_sector);
+                res = -5;
+                break;
+            }
+        }
+
+        if(write_pending) {
+            write_pending = false;
+            backup_item* it = &q.items[q.head];
+            if(!sdcard_end_write(&sdcard_cmd)) {
+                it->done += write_count;
+                if(it->done == it->size) {
+                    _backup_pop(&q);
+                    written++;
+                }
+                write_retries = 0;
+            } else if(++write_retries > BACKUP_RETRIES) {
+                printf("SD: Failed to write sector 0x%08lX\n", it->lba + it->done);
+                res = -6;
+                break;
+            }
+        }
+
+        task_set_progress(done, total);
+        if((written / 0x100) != reported) {
+            reported = written / 0x100;
+            printf("Backup: SLC 0x%05lX SLCCMPT 0x%05lX MLC 0x%08lX / 0x%08lX\n",
+                   nand[0].page, nand[1].page, mlc_sector, mlc_sectors);
+        }
     }
 
-    return 0;
+    // Let the DMA finish before its buffers go away.
+    if(mlc_pending)
+        mlc_end_read(&mlc_cmd);
+    if(write_pending)
+        sdcard_end_write(&sdcard_cmd);
+    while(q.count)
+        _backup_pop(&q);
+    dma_pool_free(mlc_buf);
+
+    for(int i = 0; i < 2; i++) {
+        if(nand[i].raw && f_close(&nand[i].file) != FR_OK && !res) {
+            printf("Failed to close %s.RAW.\n", nand[i].name);
+            res = -7;
+        }
+    }
+
+    // Preallocated images are full size however far they got.
+    for(int i = 0; i < 2 && res; i++) {
+        if(nand[i].raw_lba) {
+            char path[64] = {0};
+            sprintf(path, "%s.RAW", nand[i].name);
+            f_unlink(path);
+        }
+    }
+
+    return res;
+}
+
+int _dump_copy_rednand(u32 slc_base, u32 slccmpt_base, u32 mlc_base)
+{
+    return _dump_full_backup(slc_base, slccmpt_base, mlc_base, false);
 }
 
 int _dump_partition_rednand(void)
@@ -1848,6 +2220,53 @@ int _dump_partition_rednand(void)
     return 0;
 }
 
+// Runs a long dump job on a pool task and keeps its progress line drawn
+// until it finishes. Runs it inline if every pool stack is taken.
+// The menu stays here meanwhile, so it's one job at a time: every job
+// writes through FatFs, which isn't reentrant, and ends on the console.
+static int _dump_run_task(const char* name, task_entry_t entry, void* arg)
+{
+    task_progress progress;
+    int id = task_spawn(name, entry, arg);
+    if(id < 0) {
+        int res = entry(arg);
+        task_set_progress(0, 0);
+        task_draw_overlay();
+        return res;
+    }
+
+    do {
+        task_draw_overlay();
+    } while(!task_get_progress(id, &progress) && !progress.finished && task_yield());
+
+    task_draw_overlay();
+    return task_join(id);
+}
+
+typedef struct {
+    u32 bank;
+    int boot1_only;
+} dump_slc_raw_job;
+
+static int _dump_slc_raw_task(void* arg)
+{
+    dump_slc_raw_job* job = arg;
+    return _dump_slc_raw(job->bank, job->boot1_only);
+}
+
+typedef struct {
+    u32 slc_base;
+    u32 slccmpt_base;
+    u32 mlc_base;
+    bool raw_files;
+} dump_full_backup_job;
+
+static int _dump_full_backup_task(void* arg)
+{
+    dump_full_backup_job* job = arg;
+    return _dump_full_backup(job->slc_base, job->slccmpt_base, job->mlc_base, job->raw_files);
+}
+
 void dump_slc(void)
 {
     int res = 0;
@@ -1884,7 +2303,8 @@ void dump_slc_raw(void)
     gfx_clear(GFX_ALL, BLACK);
     printf("Dumping SLC.RAW...\n");
 
-    res = _dump_slc_raw(NAND_BANK_SLC, 0);
+    dump_slc_raw_job job = { NAND_BANK_SLC, 0 };
+    res = _dump_run_task("SLC.RAW", _dump_slc_raw_task, &job);
     if(res) {
         printf("Failed to dump SLC.RAW (%d)!\n", res);
         goto slc_exit;
@@ -1901,7 +2321,8 @@ void dump_slccmpt_raw(void)
     gfx_clear(GFX_ALL, BLACK);
     printf("Dumping SLCCMPT.RAW...\n");
 
-    res = _dump_slc_raw(NAND_BANK_SLCCMPT, 0);
+    dump_slc_raw_job job = { NAND_BANK_SLCCMPT, 0 };
+    res = _dump_run_task("SLCCMPT.RAW", _dump_slc_raw_task, &job);
     if(res) {
         printf("Failed to dump SLCCMPT.RAW (%d)!\n", res);
         goto slc_exit;
@@ -1918,7 +2339,8 @@ void dump_boot1_raw(void)
     gfx_clear(GFX_ALL, BLACK);
     printf("Dumping BOOT1_SLC.RAW...\n");
 
-    res = _dump_slc_raw(NAND_BANK_SLC, 1);
+    dump_slc_raw_job job = { NAND_BANK_SLC, 1 };
+    res = _dump_run_task("BOOT1_SLC.RAW", _dump_slc_raw_task, &job);
     if(res) {
         printf("Failed to dump BOOT1_SLC.RAW (%d)!\n", res);
         goto slc_exit;
@@ -1935,7 +2357,8 @@ void dump_boot1_vwii_raw(void)
     gfx_clear(GFX_ALL, BLACK);
     printf("Dumping BOOT1_SLCCMPT.RAW...\n");
 
-    res = _dump_slc_raw(NAND_BANK_SLCCMPT, 1);
+    dump_slc_raw_job job = { NAND_BANK_SLCCMPT, 1 };
+    res = _dump_run_task("BOOT1_SLCCMPT.RAW", _dump_slc_raw_task, &job);
     if(res) {
         printf("Failed to dump BOOT1_SLCCMPT.RAW (%d)!\n", res);
         goto slc_exit;
@@ -2102,29 +2525,16 @@ void dump_format_rednand(void)
 
     smc_get_events(); // Eat all existing events
     printf("Dump SLC/SLCCMPT-RAW images? These are useful for sysNAND restore.\n");
-    if(!console_abort_confirmation_power_skip_eject_dump())
-    {
-        printf("Dumping SLC-RAW to FAT32...\n");
-        res = _dump_slc_raw(NAND_BANK_SLC, 0);
-        if(res) {
-            printf("Failed to dump SLC-RAW (%d)!\n", res);
-            goto format_exit;
-        }
-
-        printf("Dumping SLCCMPT-RAW to FAT32...\n");
-        res = _dump_slc_raw(NAND_BANK_SLCCMPT, 0);
-        if(res) {
-            printf("Failed to dump SLCCMPT-RAW (%d)!\n", res);
-            goto format_exit;
-        }
-    }
+    bool raw_files = !console_abort_confirmation_power_skip_eject_dump();
 
     u32 mlc_base = LD_DWORD(mbr.partition[1].lba_start);
     u32 slc_base = LD_DWORD(mbr.partition[2].lba_start);
     u32 slccmpt_base = LD_DWORD(mbr.partition[3].lba_start);
 
-    printf("Dumping redNAND...\n");
-    res = _dump_copy_rednand(slc_base, slccmpt_base, mlc_base);
+    // The RAW images come from the same NAND reads as the redNAND copy.
+    printf(raw_files ? "Dumping redNAND and SLC/SLCCMPT-RAW...\n" : "Dumping redNAND...\n");
+    dump_full_backup_job job = { slc_base, slccmpt_base, mlc_base, raw_files };
+    res = _dump_run_task("redNAND", _dump_full_backup_task, &job);
     if(res) {
         printf("Failed to dump redNAND (%d)!\n", res);
         goto format_exit;
@@ -2551,5 +2961,93 @@ void dump_logs_redslc(void){
     console_power_or_eject_to_return();
 }
 
+static void _dump_scan_health(u32 bank, const char* name){
+    gfx_clear(GFX_ALL, BLACK);
+    printf("Scanning %s, nothing will be written to it\n", name);
+
+    int res = nand_health_scan(bank);
+    if(res)
+        printf("%s scan failed: %d\n", name, res);
+    else
+        printf("%s health map saved\n", name);
+
+    console_power_to_continue();
+}
+
+void dump_scan_slc_health(void){
+    _dump_scan_health(NAND_BANK_SLC, "SLC");
+}
+
+void dump_scan_slccmpt_health(void){
+    _dump_scan_health(NAND_BANK_SLCCMPT, "SLCCMPT");
+}
+
+void dump_install_slc_plugins(void){
+    const char* src = "sdmc:/wiiu/ios_plugins";
+    const char* dest = "slc:/sys/hax/ios_plugins";
+
+    gfx_clear(GFX_ALL, BLACK);
+    if(!isfs_slc_has_isfshax_installed()){
+        printf("ISFShax is not installed, it wouldn't load plugins from SLC\n");
+        console_power_to_continue();
+        return;
+    }
+    if(isfs_init(ISFSVOL_SLC)<0){
+        console_power_to_continue();
+        return;
+    }
+
+    DIR *dfd = opendir(src);
+    if(!dfd){
+        printf("ERROR opening %s: %i\n", src, errno);
+        console_power_to_continue();
+        return;
+    }
+
+    printf("Install plugins from %s to %s\n", src, dest);
+    if (console_abort_confirmation_power_no_eject_yes()) {
+        closedir(dfd);
+        return;
+    }
+
+    /* the SLC superblock is only committed once, after all plugins are copied */
+    isfs_batch_begin(ISFSVOL_SLC);
+
+    if((mkdir("slc:/sys/hax", 777) && errno != EEXIST) ||
+       (mkdir(dest, 777) && errno != EEXIST)){
+        printf("ERROR creating %s: %i\n", dest, errno);
+        goto out;
+    }
+
+    struct dirent *dp;
+    while(dp = readdir(dfd)){
+        size_t len = strlen(dp->d_name);
+        if(len < 4 || strcmp(dp->d_name + len - 4, ".ipx"))
+            continue;
+
+        char src_pathbuf[255];
+        snprintf(src_pathbuf, 254, "%s/%s", src, dp->d_name);
+        char dst_pathbuf[255];
+        snprintf(dst_pathbuf, 254, "%s/%s", dest, dp->d_name);
+
+        printf("Installing %s\n", dp->d_name);
+        if(unlink(dst_pathbuf) && errno != ENOENT){
+            printf("Error deleting old %s: %i\n", dst_pathbuf, errno);
+            continue;
+        }
+        if(copy_file(src_pathbuf, dst_pathbuf))
+            printf("Error copying %s: %i\n", src_pathbuf, errno);
+    }
+
+out:
+    closedir(dfd);
+    printf("Committing SLC...\n");
+    if(isfs_batch_end(ISFSVOL_SLC))
+        printf("ERROR committing SLC superblock\n");
+    else
+        printf("Done!\n");
+    console_power_to_continue();
+}
+
 #endif // FASTBOOT
 #endif // MINUTE_BOOT1
@@ -25,6 +25,7 @@ int _dump_restore_mlc(u32 base);
 
 int _dump_partition_rednand(void);
 int _dump_copy_rednand(u32 slc_base, u32 slccmpt_base, u32 mlc_base);
+int _dump_full_backup(u32 slc_base, u32 slccmpt_base, u32 mlc_base, bool raw_files);
 
 void dump_slc_raw(void);
 void dump_slccmpt_raw(void);
@@ -47,6 +48,9 @@ void dump_espresso(void);
 void dump_factory_log(void);
 void dump_logs_slc(void);
 void dump_logs_redslc(void);
+void dump_install_slc_plugins(void);
+void dump_scan_slc_health(void);
+void dump_scan_slccmpt_health(void);
 
 void dump_otp_via_prshhax(void);
 
@@ -14,6 +14,8 @@
 #include "memory.h"
 #include "serial.h"
 #include "latte.h"
+#include "exception.h"
+#include "crashlog.h"
 
 const char *exceptions[] = {
     "RESET", "UNDEFINED INSTR", "SWI", "INSTR ABORT", "DATA ABORT",
@@ -62,7 +64,6 @@ void exc_handler(u32 type, u32 spsr, u32 *regs)
 #endif
 
     if (type > 8) type = 8;
-    printf("Exception %d (%s):\n", type, exceptions[type]);
 
     u32 pc, fsr;
 
@@ -81,6 +82,17 @@ void exc_handler(u32 type, u32 spsr, u32 *regs)
             break;
     }
 
+#ifndef MINUTE_BOOT1
+    // Before any printing, which might be what's broken.
+    if(type == 3)
+        crashlog_record(type, spsr, regs, pc, 0, get_ifsr());
+    else if(type == 4)
+        crashlog_record(type, spsr, regs, pc, get_far(), get_dfsr());
+    else
+        crashlog_record(type, spsr, regs, pc, 0, 0);
+#endif
+
+    printf("Exception %d (%s):\n", type, exceptions[type]);
     printf("Registers (%p):\n", regs);
     printf("  R0-R3: %08x %08x %08x %08x\n", regs[0], regs[1], regs[2], regs[3]);
     printf("  R4-R7: %08x %08x %08x %08x\n", regs[4], regs[5], regs[6], regs[7]);
@@ -11,6 +11,9 @@
 #ifndef __EXCEPTION_H__
 #define __EXCEPTION_H__
 
+extern const char *exceptions[];
+extern const char *aborts[];
+
 void exception_initialize(void);
 
 #endif
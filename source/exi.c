@@ -35,40 +35,49 @@ void exi0_wait_complete(void)
     while(read32(EXI0_CR) & 1);
 }
 
-// TODO device num
-void exi0_write32(u32 addr, u32 val)
+static void _exi0_imm_write(u32 val)
 {
-    exi0_select(1, 0);
-    write32(EXI0_DATA, 0x80000000 | addr);
-    write32(EXI0_CR, EXI_TRANSFER_LENGTH(4) | EXI_TRANSFER_TYPE_W | EXI_START_TRANSFER);
-    exi0_wait_complete();
-
-    exi0_select(1, 0);
     write32(EXI0_DATA, val);
     write32(EXI0_CR, EXI_TRANSFER_LENGTH(4) | EXI_TRANSFER_TYPE_W | EXI_START_TRANSFER);
     exi0_wait_complete();
+}
 
-    exi0_deselect();
+static u32 _exi0_imm_read(void)
+{
+    write32(EXI0_CR, EXI_TRANSFER_LENGTH(4) | EXI_TRANSFER_TYPE_R | EXI_START_TRANSFER);
+    exi0_wait_complete();
+    return read32(EXI0_DATA);
 }
 
 // TODO device num
-u32 exi0_read32(u32 addr)
+void exi0_burst_write(u32 cmd, const u32* buf, u32 words)
 {
-    u32 val = 0;
-
     exi0_select(1, 0);
-    write32(EXI0_DATA, addr & ~0x80000000);
-    write32(EXI0_CR, EXI_TRANSFER_LENGTH(4) | EXI_TRANSFER_TYPE_W | EXI_START_TRANSFER);
-    exi0_wait_complete();
+    _exi0_imm_write(cmd);
+    for(u32 i = 0; i < words; i++)
+        _exi0_imm_write(buf[i]);
+    exi0_deselect();
+}
 
+// TODO device num
+void exi0_burst_read(u32 cmd, u32* buf, u32 words)
+{
     exi0_select(1, 0);
-    write32(EXI0_CR, EXI_TRANSFER_LENGTH(4) | EXI_TRANSFER_TYPE_R | EXI_START_TRANSFER);
-    exi0_wait_complete();
-
-    val = read32(EXI0_DATA); // 0x0D806810
-
+    _exi0_imm_write(cmd);
+    for(u32 i = 0; i < words; i++)
+        buf[i] = _exi0_imm_read();
     exi0_deselect();
+}
+
+void exi0_write32(u32 addr, u32 val)
+{
+    exi0_burst_write(0x80000000 | addr, &val, 1);
+}
 
+u32 exi0_read32(u32 addr)
+{
+    u32 val = 0;
+    exi0_burst_read(addr & ~0x80000000, &val, 1);
     return val;
 }
 
@@ -22,6 +22,10 @@
 
 void exi_init(void);
 
+// One select and command word for the whole buffer.
+void exi0_burst_write(u32 cmd, const u32* buf, u32 words);
+void exi0_burst_read(u32 cmd, u32* buf, u32 words);
+
 void exi0_write32(u32 addr, u32 val);
 u32 exi0_read32(u32 addr);
 void exi1_write32(u32 addr, u32 val);
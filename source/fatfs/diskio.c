@@ -11,11 +11,14 @@
 #include "ff.h"
 
 #include <wctype.h>
+#include <time.h>
 
 #include "string.h"
 #include "sdcard.h"
 #include "sdhc.h"
 #include "utils.h"
+#include "memory.h"
+#include "rtc.h"
 
 static u8 buffer[SDMMC_DEFAULT_BLOCKLEN * SDHC_BLOCK_COUNT_MAX] ALIGNED(32);
 
@@ -71,6 +74,14 @@ DRESULT disk_read (
 {
     (void)pdrv;
 
+    // FatFs hands multi-sector reads straight to us, let the SDHC DMA them
+    // into place when the destination allows it.
+    if(can_sdcard_dma_addr(buff)) {
+        if(sdcard_read(sector, count, buff) != 0)
+            return RES_ERROR;
+        return RES_OK;
+    }
+
     while(count) {
         u32 work = min(count, SDHC_BLOCK_COUNT_MAX);
 
@@ -160,8 +171,20 @@ DRESULT disk_ioctl (
 
 DWORD get_fattime()
 {
-    // NO
+#if _FS_NORTC
     return 0;
+#else
+    u32 secs = rtc_get_time();
+    if(!secs)
+        return (DWORD)(_NORTC_YEAR - 1980) << 25 | (DWORD)_NORTC_MON << 21 | (DWORD)_NORTC_MDAY << 16;
+
+    time_t t = secs + RTC_EPOCH_UNIX;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+
+    return (DWORD)(tm.tm_year - 80) << 25 | (DWORD)(tm.tm_mon + 1) << 21 | (DWORD)tm.tm_mday << 16 |
+           (DWORD)tm.tm_hour << 11 | (DWORD)tm.tm_min << 5 | (DWORD)(tm.tm_sec / 2);
+#endif
 }
 
 #include "option/unicode.c"
@@ -82,6 +82,22 @@ typedef struct {
 #endif
 
 
+/* Sector cache under the window */
+#if _FS_WINCACHE && (_FS_TINY || _FS_READONLY)
+#undef _FS_WINCACHE
+#define _FS_WINCACHE    0
+#endif
+#if _FS_WINCACHE
+typedef struct {
+    FATFS *fs;              /* Owner volume (NULL:blank entry) */
+    DWORD sect;             /* Sector number */
+    DWORD used;             /* Last access stamp for LRU eviction */
+    BYTE dirty;             /* Sector has to be written back */
+    BYTE buf[_MAX_SS];      /* Sector data */
+} WINCACHE;
+#endif
+
+
 
 /* DBCS code ranges and SBCS upper conversion tables */
 
@@ -456,6 +472,11 @@ static BYTE CurrVol;            /* Current drive */
 static FILESEM Files[_FS_LOCK]; /* Open object lock semaphores */
 #endif
 
+#if _FS_WINCACHE
+static WINCACHE WinCache[_FS_WINCACHE]; /* FAT/directory sector cache */
+static DWORD WinStamp;                  /* LRU clock */
+#endif
+
 #if _USE_LFN == 0           /* Non LFN feature */
 #define DEFINE_NAMEBUF      BYTE sfn[12]
 #define INIT_BUF(dobj)      (dobj).fn = sfn
@@ -692,6 +713,117 @@ void clear_lock (   /* Clear lock entries of the volume */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Sector cache under the disk access window                             */
+/*-----------------------------------------------------------------------*/
+#if _FS_WINCACHE
+static
+WINCACHE* wc_find ( /* Pointer to the entry, 0:not cached */
+    FATFS* fs,      /* File system object */
+    DWORD sect      /* Sector number */
+)
+{
+    UINT i;
+
+
+    for (i = 0; i < _FS_WINCACHE; i++) {
+        if (WinCache[i].fs == fs && WinCache[i].sect == sect) {
+            WinCache[i].used = ++WinStamp;
+            return &WinCache[i];
+        }
+    }
+    return 0;
+}
+
+
+static
+FRESULT wc_write (  /* FR_OK:succeeded, !=0:error */
+    WINCACHE* wc    /* Dirty entry to be written back */
+)
+{
+    FATFS *fs = wc->fs;
+    DWORD wsect = wc->sect;
+    UINT nf;
+
+
+    if (disk_write(fs->drv, wc->buf, wsect, 1) != RES_OK) return FR_DISK_ERR;
+    wc->dirty = 0;
+    if (wsect - fs->fatbase < fs->fsize) {      /* Is it in the FAT area? */
+        for (nf = fs->n_fats; nf >= 2; nf--) {  /* Reflect the change to all FAT copies */
+            wsect += fs->fsize;
+            disk_write(fs->drv, wc->buf, wsect, 1);
+        }
+    }
+    return FR_OK;
+}
+
+
+static
+FRESULT wc_alloc (  /* FR_OK:succeeded, !=0:error */
+    FATFS* fs,      /* File system object */
+    DWORD sect,     /* Sector number to be cached */
+    WINCACHE** ent  /* Returns a clean entry bound to the sector */
+)
+{
+    WINCACHE *wc = 0;
+    UINT i;
+
+
+    for (i = 0; i < _FS_WINCACHE; i++) {        /* Blank entry or least recently used one */
+        if (!WinCache[i].fs) { wc = &WinCache[i]; break; }
+        if (!wc || WinStamp - WinCache[i].used > WinStamp - wc->used) wc = &WinCache[i];
+    }
+    if (wc->fs && wc->dirty && wc_write(wc) != FR_OK) return FR_DISK_ERR;
+
+    wc->fs = fs;
+    wc->sect = sect;
+    wc->used = ++WinStamp;
+    wc->dirty = 0;
+    *ent = wc;
+    return FR_OK;
+}
+
+
+static
+FRESULT wc_flush (  /* FR_OK:succeeded, !=0:error */
+    FATFS* fs       /* File system object */
+)
+{
+    WINCACHE *wc;
+    UINT i;
+
+
+    for (;;) {          /* Write back dirty sectors of the volume in ascending order */
+        wc = 0;
+        for (i = 0; i < _FS_WINCACHE; i++) {
+            if (WinCache[i].fs == fs && WinCache[i].dirty && (!wc || WinCache[i].sect < wc->sect))
+                wc = &WinCache[i];
+        }
+        if (!wc) return FR_OK;
+        if (wc_write(wc) != FR_OK) return FR_DISK_ERR;
+    }
+}
+
+
+static
+void wc_drop (
+    FATFS* fs,      /* File system object */
+    DWORD sect,     /* First sector to be discarded */
+    DWORD count     /* Number of sectors (0xFFFFFFFF:all of the volume) */
+)
+{
+    UINT i;
+
+
+    for (i = 0; i < _FS_WINCACHE; i++) {
+        if (WinCache[i].fs == fs && WinCache[i].sect - sect < count) WinCache[i].fs = 0;
+    }
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Move/Flush disk access window in the file system object               */
 /*-----------------------------------------------------------------------*/
@@ -701,11 +833,26 @@ FRESULT sync_window ( /* FR_OK:succeeded, !=0:error */
     FATFS* fs         /* File system object */
 )
 {
+#if _FS_WINCACHE
+    WINCACHE *wc;
+#else
     DWORD wsect;
     UINT nf;
+#endif
     FRESULT res = FR_OK;
 
 
+#if _FS_WINCACHE
+    if (fs->wflag) {    /* Leave the dirty sector to the cache, it is written back later */
+        wc = wc_find(fs, fs->winsect);
+        if (!wc) res = wc_alloc(fs, fs->winsect, &wc);
+        if (res == FR_OK) {
+            mem_cpy(wc->buf, fs->win, SS(fs));
+            wc->dirty = 1;
+            fs->wflag = 0;
+        }
+    }
+#else
     if (fs->wflag) {    /* Write back the sector if it is dirty */
         wsect = fs->winsect;    /* Current sector number */
         if (disk_write(fs->drv, fs->win, wsect, 1) != RES_OK) {
@@ -720,6 +867,7 @@ FRESULT sync_window ( /* FR_OK:succeeded, !=0:error */
             }
         }
     }
+#endif
     return res;
 }
 #endif
@@ -732,12 +880,35 @@ FRESULT move_window ( /* FR_OK(0):succeeded, !=0:error */
 )
 {
     FRESULT res = FR_OK;
+#if _FS_WINCACHE
+    WINCACHE *wc;
+#endif
 
 
     if (sector != fs->winsect) {    /* Window offset changed? */
 #if !_FS_READONLY
         res = sync_window(fs);      /* Write-back changes */
 #endif
+#if _FS_WINCACHE
+        if (res == FR_OK) {         /* Fill sector window from the cache if possible */
+            wc = wc_find(fs, sector);
+            if (wc) {
+                mem_cpy(fs->win, wc->buf, SS(fs));
+            } else {
+                res = wc_alloc(fs, sector, &wc);
+                if (res == FR_OK) {
+                    if (disk_read(fs->drv, fs->win, sector, 1) != RES_OK) {
+                        wc->fs = 0;
+                        res = FR_DISK_ERR;
+                    } else {
+                        mem_cpy(wc->buf, fs->win, SS(fs));
+                    }
+                }
+                if (res != FR_OK) sector = 0xFFFFFFFF;  /* Invalidate window if data is not reliable */
+            }
+            fs->winsect = sector;
+        }
+#else
         if (res == FR_OK) {         /* Fill sector window with new data */
             if (disk_read(fs->drv, fs->win, sector, 1) != RES_OK) {
                 sector = 0xFFFFFFFF;    /* Invalidate window if data is not reliable */
@@ -745,6 +916,7 @@ FRESULT move_window ( /* FR_OK(0):succeeded, !=0:error */
             }
             fs->winsect = sector;
         }
+#endif
     }
     return res;
 }
@@ -765,6 +937,9 @@ FRESULT sync_fs (   /* FR_OK:succeeded, !=0:error */
 
 
     res = sync_window(fs);
+#if _FS_WINCACHE
+    if (res == FR_OK) res = wc_flush(fs);   /* Write back cached FAT/directory sectors */
+#endif
     if (res == FR_OK) {
         /* Update FSInfo sector if needed */
         if (fs->fs_type == FS_FAT32 && fs->fsi_flag == 1) {
@@ -778,6 +953,9 @@ FRESULT sync_fs (   /* FR_OK:succeeded, !=0:error */
             /* Write it into the FSInfo sector */
             fs->winsect = fs->volbase + 1;
             disk_write(fs->drv, fs->win, fs->winsect, 1);
+#if _FS_WINCACHE
+            wc_drop(fs, fs->winsect, 1);    /* Written around the cache */
+#endif
             fs->fsi_flag = 0;
         }
         /* Make sure that no pending write process in the physical drive */
@@ -957,6 +1135,9 @@ FRESULT remove_chain (  /* FR_OK(0):succeeded, !=0:error */
             if (nxt == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }    /* Disk error? */
             res = put_fat(fs, clst, 0);         /* Mark the cluster "empty" */
             if (res != FR_OK) break;
+#if _FS_WINCACHE
+            wc_drop(fs, clust2sect(fs, clst), fs->csize);   /* Discard it if it was a directory */
+#endif
             if (fs->free_clust != 0xFFFFFFFF) { /* Update FSINFO */
                 fs->free_clust++;
                 fs->fsi_flag |= 1;
@@ -2241,6 +2422,9 @@ FRESULT find_volume (   /* FR_OK(0): successful, !=0: any error occurred */
     /* Following code attempts to mount the volume. (analyze BPB and initialize the fs object) */
 
     fs->fs_type = 0;                    /* Clear the file system object */
+#if _FS_WINCACHE
+    wc_drop(fs, 0, 0xFFFFFFFF);         /* Anything cached may be stale now */
+#endif
     fs->drv = LD2PD(vol);               /* Bind the logical drive and a physical drive */
     stat = disk_initialize(fs->drv);    /* Initialize the physical drive */
     if (stat & STA_NOINIT)              /* Check if the initialization succeeded */
@@ -2424,10 +2608,17 @@ FRESULT f_mount (
         if (!ff_del_syncobj(cfs->sobj)) return FR_INT_ERR;
 #endif
         cfs->fs_type = 0;               /* Clear old fs object */
+#if _FS_WINCACHE
+        wc_flush(cfs);                  /* Write back and discard its cached sectors */
+        wc_drop(cfs, 0, 0xFFFFFFFF);
+#endif
     }
 
     if (fs) {
         fs->fs_type = 0;                /* Clear new fs object */
+#if _FS_WINCACHE
+        wc_drop(fs, 0, 0xFFFFFFFF);
+#endif
 #if _FS_REENTRANT                       /* Create sync object for the new volume */
         if (!ff_cre_syncobj((BYTE)vol, &fs->sobj)) return FR_INT_ERR;
 #endif
@@ -3520,6 +3711,106 @@ FRESULT f_truncate (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Allocate a Contiguous Cluster Chain to an Empty File                  */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_expand (
+    FIL* fp,        /* Pointer to the file object (opened for write, size 0) */
+    DWORD fsz,      /* File size to be allocated */
+    DWORD* clmt     /* Linear link map table (4 items) for fast seek, NULL:not used */
+)
+{
+    FRESULT res;
+    FATFS *fs;
+    DWORD val, clst, scl, ecl, stcl, ncl, tcl;
+
+
+    res = validate(fp);                     /* Check validity of the object */
+    if (res == FR_OK) {
+        if (fp->err) {                      /* Check error */
+            res = (FRESULT)fp->err;
+        } else {
+            if (!(fp->flag & FA_WRITE))     /* Check access mode */
+                res = FR_DENIED;
+            else if (!fsz || fp->fsize || fp->sclust)   /* Only for a new, empty file */
+                res = FR_INVALID_PARAMETER;
+        }
+    }
+    if (res == FR_OK) {
+        fs = fp->fs;
+        val = (DWORD)fs->csize * SS(fs);    /* Bytes per cluster */
+        tcl = (fsz + val - 1) / val;        /* Number of clusters required */
+        stcl = fs->last_clust;              /* Search from the last allocation */
+        if (stcl < 2 || stcl >= fs->n_fatent) stcl = 2;
+
+        /* Find a free run of tcl clusters, one pass over the FAT */
+        scl = clst = stcl; ncl = 0;
+        for (;;) {
+            val = get_fat(fs, clst);
+            if (val == 1) { res = FR_INT_ERR; break; }
+            if (val == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
+            if (val == 0) {
+                if (++ncl == tcl) break;    /* Found scl..clst */
+            } else {
+                ncl = 0;
+            }
+            if (++clst >= fs->n_fatent) {   /* A run can't wrap around */
+                clst = 2; ncl = 0;
+            }
+            if (!ncl) scl = clst;
+            if (clst == stcl) { res = FR_DENIED; break; }   /* No room */
+        }
+
+        if (res == FR_OK) {                 /* Write the chain in one pass */
+            ecl = scl + tcl - 1;
+            for (clst = scl; clst < ecl && res == FR_OK; clst++)
+                res = put_fat(fs, clst, clst + 1);
+            if (res == FR_OK)
+                res = put_fat(fs, ecl, 0x0FFFFFFF);
+        }
+        if (res == FR_OK) {
+            fs->last_clust = ecl;           /* Update FSINFO */
+            if (fs->free_clust != 0xFFFFFFFF) {
+                fs->free_clust -= tcl;
+                fs->fsi_flag |= 1;
+            }
+            fp->sclust = scl;
+            fp->fsize = fsz;
+            fp->flag |= FA__WRITTEN;
+#if _USE_FASTSEEK
+            if (clmt) {                     /* A single fragment */
+                clmt[0] = 4; clmt[1] = tcl; clmt[2] = scl; clmt[3] = 0;
+                fp->cltbl = clmt;
+            }
+#endif
+        }
+        if (res != FR_OK && res != FR_DENIED) fp->err = (FRESULT)res;
+    }
+
+    LEAVE_FF(fp->fs, res);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get the Physical Sector a File Starts at                              */
+/*-----------------------------------------------------------------------*/
+/* After f_expand the whole file is the sector run from here on */
+
+DWORD f_sector (    /* !=0:Sector number, 0:Failed (invalid object or empty file) */
+    FIL* fp         /* Pointer to the file object */
+)
+{
+    if (validate(fp) != FR_OK || !fp->sclust) return 0;
+
+    return clust2sect(fp->fs, fp->sclust);
+}
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Delete a File or Directory                                            */
 /*-----------------------------------------------------------------------*/
@@ -4091,6 +4382,9 @@ FRESULT f_mkfs (
     fs = FatFs[vol];
     if (!fs) return FR_NOT_ENABLED;
     fs->fs_type = 0;
+#if _FS_WINCACHE
+    wc_drop(fs, 0, 0xFFFFFFFF);     /* The volume is overwritten */
+#endif
     pdrv = LD2PD(vol);  /* Physical drive */
     part = LD2PT(vol);  /* Partition (0:auto detect, 1-4:get from partition table)*/
 
@@ -32,6 +32,7 @@
 #define _USE_TRIM   0
 #define _FS_NOFSINFO    0
 #define _FS_TINY    1
+#define _FS_WINCACHE    0
 #define _FS_NORTC   1
 #define _NORTC_MON  1
 #define _NORTC_MDAY 1
@@ -234,7 +235,17 @@
 /  data transfer. */
 
 
-#define _FS_NORTC   1
+#define _FS_WINCACHE    64
+/* This option sets the number of sectors kept in a write-back cache under the
+/  sector window (fs->win), shared by all volumes. FAT and directory sectors
+/  are then served from memory after the first access, and changes to them are
+/  written to the disk when the cache entry is evicted (LRU) or at the next
+/  f_sync()/f_close() or other call that syncs the volume. Each entry takes
+/  _MAX_SS bytes plus a few words of BSS. (0:Disable or >0:Number of sectors)
+/  It has no effect at tiny or read-only configuration. */
+
+
+#define _FS_NORTC   0
 #define _NORTC_MON  1
 #define _NORTC_MDAY 1
 #define _NORTC_YEAR 2015
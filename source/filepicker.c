@@ -142,6 +142,11 @@ void picker_init(picker* new_picker)
     while(true)
     {
         u8 input = smc_get_events();
+        if(!input)
+        {
+            smc_events_idle();
+            continue;
+        }
 
         //TODO: There's no way to exit
         //break;
@@ -45,6 +45,16 @@ void gfx_clear(gfx_screen_t screen, u32 color)
 
 }
 
+void gfx_fill_rect(gfx_screen_t screen, int x, int y, int w, int h, u32 color)
+{
+
+}
+
+u32 gfx_get_epoch(void)
+{
+	return 0;
+}
+
 void gfx_draw_char(gfx_screen_t screen, char c, int x, int y, u32 color)
 {
 
@@ -115,6 +125,57 @@ struct {
 
 static int gfx_currently_headless = 0;
 
+// Bumped whenever the screen is changed behind the console's back
+static u32 gfx_epoch = 1;
+
+#define GLYPH_CACHE_COLORS (4)
+
+typedef u32 glyph_row_t[CHAR_SIZE_X];
+
+// Every possible 8 pixel glyph row, pre-rendered for a few text colors
+static struct {
+	u32 color;
+	bool valid;
+	glyph_row_t rows[256];
+} glyph_cache[GLYPH_CACHE_COLORS];
+static int glyph_cache_next = 0;
+
+static const glyph_row_t* gfx_glyph_rows(u32 color)
+{
+	for(int i = 0; i < GLYPH_CACHE_COLORS; i++)
+	{
+		if(glyph_cache[i].valid && glyph_cache[i].color == color)
+			return glyph_cache[i].rows;
+	}
+
+	int slot = glyph_cache_next;
+	glyph_cache_next = (glyph_cache_next + 1) % GLYPH_CACHE_COLORS;
+
+	for(int v = 0; v < 256; v++)
+	{
+		for(int j = 0; j < CHAR_SIZE_X; j++)
+			glyph_cache[slot].rows[v][j] = (v & (128 >> j)) ? color : 0x00000000;
+	}
+	glyph_cache[slot].color = color;
+	glyph_cache[slot].valid = true;
+
+	return glyph_cache[slot].rows;
+}
+
+static void gfx_fill_words(u32* dst, u32 color, int count)
+{
+	while(count >= 8)
+	{
+		dst[0] = color; dst[1] = color; dst[2] = color; dst[3] = color;
+		dst[4] = color; dst[5] = color; dst[6] = color; dst[7] = color;
+		dst += 8;
+		count -= 8;
+	}
+
+	while(count--)
+		*dst++ = color;
+}
+
 void gfx_init(void)
 {
 	if (!gpu_tv_primary_surface_addr()) {
@@ -168,14 +229,41 @@ void gfx_clear(gfx_screen_t screen, u32 color)
 		for(int i = 0; i < GFX_ALL; i++)
 			gfx_clear(i, color);
 	} else {
-	    for(int i = 0; i < fbs[screen].width * fbs[screen].height; i++)
-	        fbs[screen].ptr[i] = color;
+	    gfx_fill_words(fbs[screen].ptr, color, fbs[screen].width * fbs[screen].height);
 
 	    fbs[screen].current_x = 10;
 	    fbs[screen].current_y = 10;
+	    gfx_epoch++;
+	}
+}
+
+void gfx_fill_rect(gfx_screen_t screen, int x, int y, int w, int h, u32 color)
+{
+	if (gfx_currently_headless) return;
+
+	if(screen == GFX_ALL) {
+		for(int i = 0; i < GFX_ALL; i++)
+			gfx_fill_rect(i, x, y, w, h, color);
+	} else {
+		if(x < 0) { w += x; x = 0; }
+		if(y < 0) { h += y; y = 0; }
+		if(x + w > fbs[screen].width) w = fbs[screen].width - x;
+		if(y + h > fbs[screen].height) h = fbs[screen].height - y;
+		if(w <= 0 || h <= 0) return;
+
+		size_t stride = gfx_get_stride(screen) / sizeof(u32);
+		u32* fb = &fbs[screen].ptr[x + y * stride];
+
+		for(int i = 0; i < h; i++, fb += stride)
+			gfx_fill_words(fb, color, w);
 	}
 }
 
+u32 gfx_get_epoch(void)
+{
+	return gfx_epoch;
+}
+
 void gfx_draw_char(gfx_screen_t screen, char c, int x, int y, u32 color)
 {
 	if (gfx_currently_headless) return;
@@ -188,20 +276,16 @@ void gfx_draw_char(gfx_screen_t screen, char c, int x, int y, u32 color)
 		c -= 32;
 
 		const u8* charData = &msx_font[(CHAR_SIZE_X * CHAR_SIZE_Y * c) / 8];
-		u32* fb = &fbs[screen].ptr[x + y * (gfx_get_stride(screen) / sizeof(u32))];
+		const glyph_row_t* rows = gfx_glyph_rows(color);
+		size_t stride = gfx_get_stride(screen) / sizeof(u32);
+		u32* fb = &fbs[screen].ptr[x + y * stride];
 
-		for(int i = 0; i < CHAR_SIZE_Y; ++i)
+		for(int i = 0; i < CHAR_SIZE_Y; ++i, fb += stride)
 		{
-			u8 v = *(charData++);
-
-			for(int j = 0; j < CHAR_SIZE_X; ++j)
-			{
-				if(v & (128 >> j)) *fb = color;
-				else *fb = 0x00000000;
-				fb++;
-			}
+			const u32* row = rows[*(charData++)];
 
-			fb += (gfx_get_stride(screen) / sizeof(u32)) - CHAR_SIZE_X;
+			fb[0] = row[0]; fb[1] = row[1]; fb[2] = row[2]; fb[3] = row[3];
+			fb[4] = row[4]; fb[5] = row[5]; fb[6] = row[6]; fb[7] = row[7];
 		}
 	}
 }
@@ -267,6 +351,7 @@ int printf(const char* fmt, ...)
 		}
 	}
 
+	gfx_epoch++;
 	for(int i = 0; i < GFX_ALL; i++) {
 		if(fbs[i].current_y + lines >= fbs[i].height - 20)
 			gfx_clear(i, BLACK);
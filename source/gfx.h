@@ -30,6 +30,8 @@ void gfx_init(void);
 bool gfx_is_currently_headless(void);
 void gfx_draw_plot(gfx_screen_t screen, int x, int y, u32 color);
 void gfx_clear(gfx_screen_t screen, u32 color);
+void gfx_fill_rect(gfx_screen_t screen, int x, int y, int w, int h, u32 color);
+u32 gfx_get_epoch(void);
 void gfx_draw_string(gfx_screen_t screen, char* str, int x, int y, u32 color);
 void gfx_printf_to_display(bool on);
 
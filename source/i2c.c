@@ -8,269 +8,374 @@
  *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
  */
 
+#include "i2c.h"
 #include "types.h"
 #include "utils.h"
 #include "latte.h"
 #include "gfx.h"
 #include "gpio.h"
+#include "irq.h"
+#include "timer.h"
 
 //#define I2C_DEBUG
 
-void i2c_init(u32 clock, u32 channel)
+// Same 5s budget the old 4999 x 1ms polling loop had
+#define I2C_TIMEOUT_MS (5000)
+#define I2C_TIMEOUT IRQ_ALARM_MS2REG(I2C_TIMEOUT_MS)
+// A short register read is a few hundred us at bus speed.
+#define I2C_POLL_US (100)
+
+typedef struct {
+    u32 reg_clock;
+    u32 reg_inout_data;
+    u32 reg_inout_ctrl;
+    u32 reg_inout_size;
+    u32 reg_int_mask;
+    u32 reg_int_state;
+
+    u32 int_write;
+    u32 int_read;
+    u32 int_done;
+    u32 int_error;
+
+    i2c_xfer_t* head;
+    i2c_xfer_t* tail;
+    u32 start_time;
+    u32 clock;
+} i2c_bus_t;
+
+static i2c_bus_t i2c_buses[I2C_BUS_COUNT] = {
+    [I2C_BUS_SMC] = {
+        .reg_clock = LT_SMC_I2C_CLOCK,
+        .reg_inout_data = LT_SMC_I2C_INOUT_DATA,
+        .reg_inout_ctrl = LT_SMC_I2C_INOUT_CTRL,
+        .reg_inout_size = LT_SMC_I2C_INOUT_SIZE,
+        .reg_int_mask = LT_SMC_I2C_INT_MASK,
+        .reg_int_state = LT_SMC_I2C_INT_STATE,
+        .int_write = 0x1E,
+        .int_read = 0x1D,
+        .int_done = 0x3,
+        .int_error = 0x1C,
+    },
+    [I2C_BUS_AVE] = {
+        .reg_clock = LT_AVE_I2C_CLOCK,
+        .reg_inout_data = LT_AVE_I2C_INOUT_DATA,
+        .reg_inout_ctrl = LT_AVE_I2C_INOUT_CTRL,
+        .reg_inout_size = LT_AVE_I2C_INOUT_SIZE,
+        .reg_int_mask = LT_AVE_I2C_INT_MASK,
+        .reg_int_state = LT_AVE_I2C_INT_STATE,
+        .int_write = 0xCC0,
+        .int_read = 0xCE0,
+        .int_done = 0x060,
+        .int_error = 0xC80,
+    },
+};
+
+static void _i2c_inout_data(i2c_bus_t* bus, u8 data, bool last)
 {
-    write32(LT_SMC_I2C_CLOCK, ((channel << 1) & 0xFFFF) | ((243000000 / 2) / clock << 16) | 1);
-    write32(LT_SMC_I2C_INOUT_CTRL, 0);
+    u32 value = data | (last ? 1 << 8 : 0);
+#ifdef I2C_DEBUG
+    printf("i2c: writing value 0x%lx\n", value);
+#endif
+    write32(bus->reg_inout_data, value);
+    write32(bus->reg_inout_ctrl, 1);
 }
 
-void i2c_enable_int(u32 mask)
+static void _i2c_start(i2c_bus_t* bus)
 {
-    write32(LT_SMC_I2C_INT_STATE, mask);
-    set32(LT_SMC_I2C_INT_MASK, mask);
-}
+    i2c_xfer_t* xfer = bus->head;
+    if(!xfer) return;
 
-void i2c_disable_int(u32 mask)
-{
-    clear32(LT_SMC_I2C_INT_MASK, mask);
+    bool is_read = !!(xfer->flags & I2C_XFER_READ);
+    u32 mask = is_read ? bus->int_read : bus->int_write;
+
+    write32(bus->reg_int_state, mask);
+    set32(bus->reg_int_mask, mask);
+
+    _i2c_inout_data(bus, (xfer->slave_7bit << 1) | (is_read ? 1 : 0), 0);
+    for(size_t i = 0; i < xfer->size; i++)
+        _i2c_inout_data(bus, is_read ? 0 : xfer->data[i], i == xfer->size - 1);
+
+    bus->start_time = read32(LT_TIMER);
 }
 
-void i2c_inout_data(u8 data, bool last)
+static int _i2c_read_back(i2c_bus_t* bus, i2c_xfer_t* xfer)
 {
-    u32 value = data | (last ? 1 << 8 : 0);
+    if(xfer->size > ((read32(bus->reg_inout_size) & 0xFF0000) >> 16)) {
 #ifdef I2C_DEBUG
-    printf("i2c: writing value 0x%lx\n", value);
+        printf("i2c: read size fail!\n");
 #endif
-    write32(LT_SMC_I2C_INOUT_DATA, value);
-    write32(LT_SMC_I2C_INOUT_CTRL, 1);
+        return -5;
+    }
+
+    for(size_t pos = 0; pos < xfer->size; pos++)
+    {
+        xfer->data[pos] = read32(bus->reg_inout_size);
+#ifdef I2C_DEBUG
+        printf("i2c: read byte 0x%x @ %d\n", xfer->data[pos], pos);
+#endif
+    }
+
+    return 0;
+}
+
+// Must be called with IRQs disabled.
+static void _i2c_complete(i2c_bus_t* bus, int res)
+{
+    i2c_xfer_t* xfer = bus->head;
+    i2c_xfer_t* finished = xfer;
+
+    if(!res && (xfer->flags & I2C_XFER_READ))
+        res = _i2c_read_back(bus, xfer);
+
+    clear32(bus->reg_int_mask, bus->int_write | bus->int_read);
+
+    bus->head = xfer->next;
+    xfer->result = res;
+
+    // A failed transfer takes the rest of its chain down with it, the same
+    // way the blocking register helpers bailed out after a failed write.
+    while(res && (xfer->flags & I2C_XFER_LINKED) && bus->head) {
+        xfer = bus->head;
+        bus->head = xfer->next;
+        xfer->result = res;
+    }
+    xfer->next = NULL;
+    if(!bus->head)
+        bus->tail = NULL;
+
+    _i2c_start(bus);
+
+    // Callbacks run after the next transfer went out, so they may submit.
+    while(finished) {
+        i2c_xfer_t* next = finished->next;
+        finished->next = NULL;
+        finished->done = true;
+        if(finished->callback)
+            finished->callback(finished);
+        finished = next;
+    }
 }
 
-int i2c_wait_xfer_done(void)
+static void _i2c_service(i2c_bus_t* bus)
 {
-    u32 mask = 0;
+    u32 cookie = irq_kill();
 
-    for(int i = 0; i < 4999; i++)
+    if(bus->head)
     {
-        mask = read32(LT_SMC_I2C_INT_STATE) & read32(LT_SMC_I2C_INT_MASK);
-        if(mask & 0x1C)
+        u32 mask = read32(bus->reg_int_state) & read32(bus->reg_int_mask);
+        if(mask & bus->int_error)
         {
-            clear32(LT_SMC_I2C_INT_STATE, ~read32(LT_SMC_I2C_INT_MASK));
+            clear32(bus->reg_int_state, ~read32(bus->reg_int_mask));
 #ifdef I2C_DEBUG
             printf("i2c: xfer error, mask 0x%lx!\n", mask);
 #endif
-            return -2;
+            _i2c_complete(bus, -2);
         }
-        if(mask & 3)
+        else if(mask & bus->int_done)
         {
-            clear32(LT_SMC_I2C_INT_STATE, ~read32(LT_SMC_I2C_INT_MASK));
+            clear32(bus->reg_int_state, ~read32(bus->reg_int_mask));
 #ifdef I2C_DEBUG
             printf("i2c: xfer complete, mask 0x%lx\n", mask);
 #endif
-            return 0;
+            _i2c_complete(bus, 0);
         }
-
-        udelay(1000);
-    }
-
+        else if(read32(LT_TIMER) - bus->start_time > I2C_TIMEOUT)
+        {
 #ifdef I2C_DEBUG
-    printf("i2c: xfer fail, mask 0x%lx!\n", mask);
+            printf("i2c: xfer fail, mask 0x%lx!\n", mask);
 #endif
-    write32(LT_SMC_I2C_INT_STATE, mask);
-    return -1;
-}
-
-int i2c_write(u8 slave_7bit, const u8* data, size_t size)
-{
-    int res = 0;
-
-    if(!data || size == 0 || size > 0x40)
-        return -4;
-
-    i2c_enable_int(0x1E);
-    i2c_inout_data(slave_7bit << 1, 0);
-
-    while(true) {
-        if(size-- == 0) break;
-        i2c_inout_data(*data++, size == 0);
+            write32(bus->reg_int_state, mask);
+            _i2c_complete(bus, -1);
+        }
     }
 
-    res = i2c_wait_xfer_done();
-
-    i2c_disable_int(0x1E);
-    return res;
+    irq_restore(cookie);
 }
 
-int i2c_read(u8 slave_7bit, u8* data, size_t size)
+/*
+ * Neither controller's interrupt line is routed to us, so the queue is
+ * serviced from the timer tick and from anyone waiting on a transfer.
+ */
+void i2c_irq(void)
 {
-    int res = 0;
-
-    if(!data || size == 0 || size > 0x40)
-        return -4;
+    for(int i = 0; i < I2C_BUS_COUNT; i++)
+        _i2c_service(&i2c_buses[i]);
+}
 
-    i2c_enable_int(0x1D);
-    i2c_inout_data((slave_7bit << 1) | 1, 0);
+void i2c_submit(i2c_xfer_t* xfer)
+{
+    i2c_xfer_t* last = xfer;
 
-    size_t counter = size;
-    while(true) {
-        if(counter-- == 0) break;
-        i2c_inout_data(0, counter == 0);
+    for(i2c_xfer_t* it = xfer; it; it = it->next)
+    {
+        it->done = false;
+        it->result = 0;
+        last = it;
     }
 
-    res = i2c_wait_xfer_done();
-    if(res) {
-        i2c_disable_int(0x1D);
-        return res;
+    for(i2c_xfer_t* it = xfer; it; it = it->next)
+    {
+        if(it->bus != xfer->bus || !it->data || it->size == 0 || it->size > 0x40)
+        {
+            for(it = xfer; it; ) {
+                i2c_xfer_t* next = it->next;
+                it->next = NULL;
+                it->result = -4;
+                it->done = true;
+                if(it->callback)
+                    it->callback(it);
+                it = next;
+            }
+            return;
+        }
     }
 
-    if(size > ((read32(LT_SMC_I2C_INOUT_SIZE) & 0xFF0000) >> 16)) {
-#ifdef I2C_DEBUG
-        printf("i2c: read size fail!\n");
-#endif
-        i2c_disable_int(0x1D);
-        return -5;
-    }
+    i2c_bus_t* bus = &i2c_buses[xfer->bus];
+    u32 cookie = irq_kill();
 
-    size_t pos = 0;
-    do
-    {
-        data[pos++] = read32(LT_SMC_I2C_INOUT_SIZE);
-#ifdef I2C_DEBUG
-        printf("i2c: read byte 0x%x @ %d\n", data[pos - 1], pos - 1);
-#endif
+    if(bus->tail) {
+        bus->tail->next = xfer;
+        bus->tail = last;
+    } else {
+        bus->head = xfer;
+        bus->tail = last;
+        _i2c_start(bus);
     }
-    while(pos != size);
 
-    i2c_disable_int(0x1D);
-    return 0;
+    irq_restore(cookie);
 }
 
+static bool _i2c_xfer_done(void* arg)
+{
+    i2c_xfer_t* xfer = arg;
 
+    _i2c_service(&i2c_buses[xfer->bus]);
+    return xfer->done;
+}
 
-
-void ave_i2c_init(u32 clock, u32 channel)
+int i2c_xfer_wait(i2c_xfer_t* xfer)
 {
-    gpio_ave_i2c_init();
+    // Every transfer ahead of us times out on its own, so this ends.
+    while(timer_wait_until(_i2c_xfer_done, xfer, I2C_TIMEOUT_MS * 1000, I2C_POLL_US));
 
-    write32(LT_AVE_I2C_CLOCK, ((channel << 1) & 0xFFFF) | (((243000000 / 2) / clock) << 16) | 1);
-    write32(LT_AVE_I2C_INOUT_CTRL, 0);
+    return xfer->result;
 }
 
-void ave_i2c_enable_int(u32 mask)
+static void _i2c_drain(i2c_bus_t* bus)
 {
-    write32(LT_AVE_I2C_INT_STATE, mask);
-    set32(LT_AVE_I2C_INT_MASK, mask);
+    while(bus->head)
+        _i2c_service(bus);
 }
 
-void ave_i2c_disable_int(u32 mask)
+static int _i2c_write_sync(int bus, u8 slave_7bit, const u8* data, size_t size)
 {
-    clear32(LT_AVE_I2C_INT_MASK, mask);
+    i2c_xfer_t xfer = {
+        .bus = bus,
+        .slave_7bit = slave_7bit,
+        .data = (u8*)data,
+        .size = size,
+    };
+
+    i2c_submit(&xfer);
+    return i2c_xfer_wait(&xfer);
 }
 
-void ave_i2c_inout_data(u8 data, bool last)
+static int _i2c_read_sync(int bus, u8 slave_7bit, u8* data, size_t size)
 {
-    u32 value = data | (last ? 1 << 8 : 0);
-#ifdef I2C_DEBUG
-    printf("i2c: writing value 0x%lx\n", value);
-#endif
-    write32(LT_AVE_I2C_INOUT_DATA, value);
-    write32(LT_AVE_I2C_INOUT_CTRL, 1);
+    i2c_xfer_t xfer = {
+        .bus = bus,
+        .slave_7bit = slave_7bit,
+        .flags = I2C_XFER_READ,
+        .data = data,
+        .size = size,
+    };
+
+    i2c_submit(&xfer);
+    return i2c_xfer_wait(&xfer);
 }
 
-int ave_i2c_wait_xfer_done(void)
+static int _i2c_write_read_sync(int bus, u8 slave_7bit, const u8* wdata, size_t wsize, u8* rdata, size_t rsize)
 {
-    u32 mask = 0;
-
-    for(int i = 0; i < 4999; i++)
-    {
-        mask = read32(LT_AVE_I2C_INT_STATE) & read32(LT_AVE_I2C_INT_MASK);
-        if(mask & 0xC80)
+    i2c_xfer_t xfer[2] = {
         {
-            clear32(LT_AVE_I2C_INT_STATE, ~read32(LT_AVE_I2C_INT_MASK));
-#ifdef I2C_DEBUG
-            printf("i2c: xfer error, mask 0x%lx!\n", mask);
-#endif
-            return -2;
-        }
-        if(mask & 0x060)
+            .next = &xfer[1],
+            .bus = bus,
+            .slave_7bit = slave_7bit,
+            .flags = I2C_XFER_LINKED,
+            .data = (u8*)wdata,
+            .size = wsize,
+        },
         {
-            clear32(LT_AVE_I2C_INT_STATE, ~read32(LT_AVE_I2C_INT_MASK));
-#ifdef I2C_DEBUG
-            printf("i2c: xfer complete, mask 0x%lx\n", mask);
-#endif
-            return 0;
-        }
-
-        udelay(1000);
-    }
-
-#ifdef I2C_DEBUG
-    printf("i2c: xfer fail, mask 0x%lx!\n", mask);
-#endif
-    write32(LT_AVE_I2C_INT_STATE, mask);
-    return -1;
+            .bus = bus,
+            .slave_7bit = slave_7bit,
+            .flags = I2C_XFER_READ,
+            .data = rdata,
+            .size = rsize,
+        },
+    };
+
+    i2c_submit(&xfer[0]);
+    return i2c_xfer_wait(&xfer[1]);
 }
 
-int ave_i2c_write(u8 slave_7bit, const u8* data, size_t size)
+// Must be called with IRQs disabled, so the timer tick can't start a
+// transfer between the drain and the reprogramming.
+static void _i2c_set_clock(i2c_bus_t* bus, u32 clock, u32 channel)
 {
-    int res = 0;
+    u32 value = ((channel << 1) & 0xFFFF) | (((243000000 / 2) / clock) << 16) | 1;
 
-    if(!data || size == 0 || size > 0x40)
-        return -4;
-
-    ave_i2c_enable_int(0xCC0);
-#if 1
-    ave_i2c_inout_data(slave_7bit << 1, 0);
+    _i2c_drain(bus);
+    if(bus->clock != value) {
+        write32(bus->reg_clock, value);
+        bus->clock = value;
+    }
+    // Every init resets the pad direction, same as before the shortcut.
+    write32(bus->reg_inout_ctrl, 0);
+}
 
+void i2c_init(u32 clock, u32 channel)
+{
+    u32 cookie = irq_kill();
+    _i2c_set_clock(&i2c_buses[I2C_BUS_SMC], clock, channel);
+    irq_restore(cookie);
+}
 
-    while(true) {
-        if(size-- == 0) break;
-        ave_i2c_inout_data(*data++, size == 0);
-    }
+int i2c_write(u8 slave_7bit, const u8* data, size_t size)
+{
+    return _i2c_write_sync(I2C_BUS_SMC, slave_7bit, data, size);
+}
 
-    res = ave_i2c_wait_xfer_done();
-#endif
-    ave_i2c_disable_int(0xCC0);
-    return res;
+int i2c_read(u8 slave_7bit, u8* data, size_t size)
+{
+    return _i2c_read_sync(I2C_BUS_SMC, slave_7bit, data, size);
 }
 
-int ave_i2c_read(u8 slave_7bit, u8* data, size_t size)
+int i2c_write_read(u8 slave_7bit, const u8* wdata, size_t wsize, u8* rdata, size_t rsize)
 {
-    int res = 0;
+    return _i2c_write_read_sync(I2C_BUS_SMC, slave_7bit, wdata, wsize, rdata, rsize);
+}
 
-    if(!data || size == 0 || size > 0x40)
-        return -4;
 
-    ave_i2c_enable_int(0xCE0);
-    ave_i2c_inout_data((slave_7bit << 1) | 1, 0);
 
-    size_t counter = size;
-    while(true) {
-        if(counter-- == 0) break;
-        ave_i2c_inout_data(0, counter == 0);
-    }
 
-    res = ave_i2c_wait_xfer_done();
-    if(res) {
-        ave_i2c_disable_int(0xCE0);
-        return res;
-    }
+void ave_i2c_init(u32 clock, u32 channel)
+{
+    u32 cookie = irq_kill();
+    i2c_bus_t* bus = &i2c_buses[I2C_BUS_AVE];
 
-    if(size > ((read32(LT_AVE_I2C_INOUT_SIZE) & 0xFF0000) >> 16)) {
-#ifdef I2C_DEBUG
-        printf("i2c: read size fail!\n");
-#endif
-        ave_i2c_disable_int(0xCE0);
-        return -5;
-    }
+    _i2c_drain(bus);
+    gpio_ave_i2c_init();
+    _i2c_set_clock(bus, clock, channel);
+    irq_restore(cookie);
+}
 
-    size_t pos = 0;
-    do
-    {
-        data[pos++] = read32(LT_AVE_I2C_INOUT_SIZE);
-#ifdef I2C_DEBUG
-        printf("i2c: read byte 0x%x @ %d\n", data[pos - 1], pos - 1);
-#endif
-    }
-    while(pos != size);
+int ave_i2c_write(u8 slave_7bit, const u8* data, size_t size)
+{
+    return _i2c_write_sync(I2C_BUS_AVE, slave_7bit, data, size);
+}
 
-    ave_i2c_disable_int(0xCE0);
-    return 0;
+int ave_i2c_read(u8 slave_7bit, u8* data, size_t size)
+{
+    return _i2c_read_sync(I2C_BUS_AVE, slave_7bit, data, size);
 }
@@ -15,9 +15,42 @@
 
 #define I2C_SLAVE_SMC (0x50)
 
+#define I2C_BUS_SMC   (0)
+#define I2C_BUS_AVE   (1)
+#define I2C_BUS_COUNT (2)
+
+#define I2C_XFER_READ   (1 << 0)
+// Abort the next transfer in the chain if this one fails
+#define I2C_XFER_LINKED (1 << 1)
+
+typedef struct i2c_xfer_t {
+    struct i2c_xfer_t* next;
+    u8 bus;
+    u8 slave_7bit;
+    u8 flags;
+    u8* data;
+    size_t size;
+
+    volatile int result;
+    volatile bool done;
+
+    // Called from IRQ context once the transfer has completed.
+    void (*callback)(struct i2c_xfer_t* xfer);
+    void* priv;
+} i2c_xfer_t;
+
+/*
+ * Queues a transfer (or a chain linked through ->next, which is kept
+ * together on the bus) and returns immediately.
+ */
+void i2c_submit(i2c_xfer_t* xfer);
+int i2c_xfer_wait(i2c_xfer_t* xfer);
+void i2c_irq(void);
+
 void i2c_init(u32 clock, u32 channel);
 int i2c_read(u8 slave_7bit, u8* data, size_t size);
 int i2c_write(u8 slave_7bit, const u8* data, size_t size);
+int i2c_write_read(u8 slave_7bit, const u8* wdata, size_t wsize, u8* rdata, size_t rsize);
 
 void ave_i2c_init(u32 clock, u32 channel);
 int ave_i2c_read(u8 slave_7bit, u8* data, size_t size);
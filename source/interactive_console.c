@@ -23,9 +23,11 @@
 #include "main.h"
 #include "ancast.h"
 #include "utils.h"
-#include "sha.h"
+#include "serial_xfer.h"
+#include "crc32.h"
 #include "asic.h"
 #include "ppc.h"
+#include "dma_pool.h"
 
 #define INTCON_HISTORY_DEPTH (64)
 #define INTCON_COMMAND_MAX_LEN (256)
@@ -103,7 +105,7 @@ void intcon_delete()
 
 void intcon_show_help(void)
 {
-    printf("Valid commands: exit, quit, reset, restart, shutdown, smc, peek, poke, set, clear, help, ?\n");
+    printf("Valid commands: exit, quit, reset, restart, shutdown, put, get, crc32, smc, peek, poke, set, clear, dmapool, help, ?\n");
 }
 
 void intcon_smc_cmd(int argc, char** argv)
@@ -502,135 +504,44 @@ void intcon_memory_cmd(int argc, char** argv)
     }
 }
 
-int intcon_upload(const char* fpath)
+void intcon_crc32_file(const char* path)
 {
-    u8 serial_tmp[256];
-    u8 last_12[12];
-    int serial_len = 0;
-    int serial_idx = 0;
-    int serial_remainder;
-    u32 transfer_len;
-    u32 bytes_left;
-    int is_synced = 0;
-    u8* out_iter;
-    FILE* f_fw;
-    int attempts;
-
-    const u8 magic_upld[13] = {0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0x50, 0x4C, 0x44, 0x0a};
-    const u8 magic_sync[8] = {0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA};
-
-    serial_allow_zeros();
-    for (int i = 0; i < sizeof(magic_upld); i++) {
-        serial_send(magic_upld[i]);
-    }
-    serial_printf("%s\n", fpath);
-
-    out_iter = (u8*)ALL_PURPOSE_TMP_BUF;
-
-    memset(last_12, 0, sizeof(last_12));
-    attempts = 5000;
-    while(--attempts)
-    {
-        udelay(1000);
-
-        serial_poll();
-        serial_len = serial_in_read(serial_tmp);
-        serial_idx = 0;
-        if (serial_len) {
-            attempts = 5000;
-        }
-
-        for (int i = 0; i < serial_len; i++) {
-            serial_idx++;
-            memmove(last_12, last_12+1, 11);
-            last_12[11] = serial_tmp[i];
-
-            if (!memcmp(last_12, magic_sync, 8)) {
-                is_synced = 1;
-                break;
-            }
-        }
-        if (is_synced) break;
-    }
-
-    if (attempts <= 0) {
-        goto fail;
-    }
-
-    f_fw = fopen(fpath, "wb");
-    if(!f_fw)
-    {
-        printf("Failed to open `%s` for writing.\n", fpath);
-        goto fail;
+    const size_t chunk = 0x10000;
+    u32 crc = 0;
+    u64 total = 0;
+    size_t read;
+
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        printf("Failed to open `%s`.\n", path);
+        return;
     }
 
-    serial_remainder = serial_len-serial_idx;
-    transfer_len = read32_unaligned(last_12+8);
-    bytes_left = transfer_len;
-    //printf("Transferring 0x%08x bytes (%x)\n", transfer_len, serial_remainder);
-
-    if (bytes_left < serial_remainder) {
-        memcpy(out_iter, serial_tmp+serial_idx, bytes_left);
-        bytes_left = 0;
-        goto done;
+    u8* buf = malloc(chunk);
+    if (!buf) {
+        printf("Out of memory.\n");
+        fclose(f);
+        return;
     }
 
-    if (serial_remainder)
-    {
-        memcpy(out_iter, serial_tmp+serial_idx, serial_remainder);
-        out_iter += serial_remainder;
-        bytes_left -= serial_remainder;
+    while ((read = fread(buf, 1, chunk, f)) > 0) {
+        crc = crc32_update(crc, buf, read);
+        total += read;
     }
 
-    attempts = 5000;
-    while (--attempts)
-    {
-        //for (int i = 0; i < 128; i++)
-        {
-            serial_poll();
-        }
-        serial_len = serial_in_read(serial_tmp);
-        if (serial_len) {
-            attempts = 5000;
-        }
-
-        if (serial_len > bytes_left) {
-            serial_len = bytes_left;
-        }
-
-        //printf("%x %x\n", bytes_left, serial_len);
-
-        memcpy(out_iter, serial_tmp, serial_len);
-        out_iter += serial_len;
-        bytes_left -= serial_len;
-        if (bytes_left <= 0) {
-            break;
-        }
-    }
+    printf("%s: 0x%llx bytes, crc32 %08lX\n", path, total, crc);
+    free(buf);
+    fclose(f);
+}
 
-    if (attempts <= 0) {
-        goto fail;
+int intcon_upload(const char* fpath)
+{
+    if (serial_xfer_receive(fpath) < 0) {
+        console_power_to_exit();
+        return 1;
     }
 
-    fwrite((u8*)ALL_PURPOSE_TMP_BUF, transfer_len, 1, f_fw);
-
-done:
-    serial_disallow_zeros();
-    printf("Transfer complete!\n");
-    u32 hash[SHA_HASH_WORDS] = {0};
-    sha_hash((void*)ALL_PURPOSE_TMP_BUF, hash, transfer_len);
-
-    printf("sha1:   %08lX%08lX%08lX%08lX%08lX\n", hash[0], hash[1], hash[2], hash[3], hash[4]);
-    fclose(f_fw);
-
     return 0;
-fail:
-    serial_disallow_zeros();
-    printf("Transfer failed.\n");
-    fclose(f_fw);
-
-    console_power_to_exit();
-    return 1;
 }
 
 void intcon_handle_cmd(const char* pCmd)
@@ -698,6 +609,30 @@ void intcon_handle_cmd(const char* pCmd)
             intcon_active = 0;
         }
     }
+    else if (!strcmp(cmd, "put")) {
+        if (argc < 2) {
+            printf("Usage: put <path>\n");
+        }
+        else {
+            serial_xfer_receive(argv[1]);
+        }
+    }
+    else if (!strcmp(cmd, "get")) {
+        if (argc < 2) {
+            printf("Usage: get <path>\n");
+        }
+        else {
+            serial_xfer_send(argv[1]);
+        }
+    }
+    else if (!strcmp(cmd, "crc32")) {
+        if (argc < 2) {
+            printf("Usage: crc32 <path>\n");
+        }
+        else {
+            intcon_crc32_file(argv[1]);
+        }
+    }
     else if (!strcmp(cmd, "smc")) {
         intcon_smc_cmd(argc, argv);
     }
@@ -714,6 +649,9 @@ void intcon_handle_cmd(const char* pCmd)
             ppc_test(strtoll(argv[1], NULL, 0));
         }
     }
+    else if (!strcmp(cmd, "dmapool")) {
+        dma_pool_print_stats();
+    }
     else if (!strcmp(cmd, "help") || !strcmp(cmd, "?")) {
         intcon_show_help();
     }
@@ -21,8 +21,24 @@
 #include "sdcard.h"
 #include "mlc.h"
 #include "serial.h"
+#include "i2c.h"
+#include "smc.h"
+#include "rtc.h"
+#include "timer.h"
 
+#ifdef MINUTE_BOOT1
 static u32 _alarm_frequency = 0;
+#else
+// The periodic alarm is just another timer now.
+static timer_event_t _alarm_tick;
+
+static void _irq_tick(timer_event_t* timer)
+{
+    i2c_irq();
+    smc_irq();
+    rtc_tick();
+}
+#endif
 
 void irq_setup_stack(void);
 
@@ -70,10 +86,17 @@ void irq_handler(void)
             all_enabled, all_flags, all_mask, lt_enabled, lt_flags, lt_mask);*/
 
     if(all_mask & IRQF_TIMER) {
+#ifdef MINUTE_BOOT1
         if (_alarm_frequency)
             write32(LT_ALARM, read32(LT_TIMER) + _alarm_frequency);
 
         write32(LT_INTSR_AHBALL_ARM, IRQF_TIMER);
+        i2c_irq();
+        smc_irq();
+#else
+        write32(LT_INTSR_AHBALL_ARM, IRQF_TIMER);
+        timer_irq();
+#endif
     }
 
     if(all_mask & IRQF_NAND) {
@@ -103,7 +126,9 @@ void irq_handler(void)
     }
     if(all_mask & IRQF_AES) {
 //      printf("IRQ: AES\n");
+        // ack first, aes_irq may already start the next command
         write32(LT_INTSR_AHBALL_ARM, IRQF_AES);
+        aes_irq();
     }
     if(all_mask & IRQF_SD0) {
 //      printf("IRQ: SD0\n");
@@ -156,10 +181,19 @@ void irql_disable(u32 irq)
 
 void irq_set_alarm(u32 ms, u8 enable)
 {
+#ifdef MINUTE_BOOT1
     _alarm_frequency = IRQ_ALARM_MS2REG(ms);
 
     if (enable)
         write32(LT_ALARM, read32(LT_TIMER) + _alarm_frequency);
+#else
+    if (!ms)
+        timer_cancel(&_alarm_tick);
+    else if (enable || _alarm_tick.pending) {
+        _alarm_tick.callback = _irq_tick;
+        timer_start(&_alarm_tick, ms * 1000, ms * 1000);
+    }
+#endif
 }
 
 void irq_wait(void)
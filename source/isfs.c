@@ -26,6 +26,8 @@
 #include "sdcard.h"
 #include "memory.h"
 #include "rednand.h"
+#include "dma_pool.h"
+#include "nand_health.h"
 
 #include "isfshax.h"
 
@@ -108,33 +110,121 @@ static int _isfs_super_check_slot(isfs_ctx *ctx, u32 index)
     return 0;
 }
 
-static int _isfs_decrypt_cluster(const isfs_ctx* ctx, u8 *cluster_data){
-    aes_reset();
-    aes_set_key((u8*)ctx->aes);
-    aes_empty_iv();
-    aes_decrypt(cluster_data, cluster_data, CLUSTER_SIZE / ISFSAES_BLOCK_SIZE, 0);  
+#ifdef NAND_WRITE_ENABLED
+static int _isfs_block_sync(const isfs_ctx* ctx, u32 startblock, u32 endblock);
+#endif
+
+/* clusters are crypted in the background while the next ones are read,
+ * a whole nand block can be queued at once */
+#define ISFS_AES_JOBS       (BLOCK_CLUSTERS)
+/* clusters per SD transfer when decrypting redNAND */
+#define ISFS_SD_CHUNK       (4)
+
+typedef struct {
+    aes_job jobs[ISFS_AES_JOBS];
+    u32 next;
+    int error;
+} isfs_aes_queue;
+
+static void _isfs_aes_queue_cluster(const isfs_ctx* ctx, isfs_aes_queue* q, int op, void *src, void *dst){
+    aes_job* job = &q->jobs[q->next++ % ISFS_AES_JOBS];
+    if(aes_job_wait(job))
+        q->error = -1;
+
+    /* every cluster starts from a zero IV */
+    aes_job_init(job, op, src, dst, CLUSTER_SIZE / ISFSAES_BLOCK_SIZE);
+    job->key = (const u8*)ctx->aes;
+    job->flags = AES_JOB_SET_IV;
+    aes_job_submit(job);
 }
 
-static int _isfs_read_sd(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count, u32 flags, void *data){
-    inline u32 make_sector(u32 page) {
-        return (page * CLUSTER_SIZE) / SDMMC_DEFAULT_BLOCKLEN;
+/* wait for the n-th cluster queued so far */
+static int _isfs_aes_queue_wait(isfs_aes_queue* q, u32 n){
+    if(aes_job_wait(&q->jobs[n % ISFS_AES_JOBS]))
+        q->error = -1;
+    return q->error;
+}
+
+static int _isfs_aes_queue_finish(isfs_aes_queue* q){
+    for (int i = 0; i < ISFS_AES_JOBS; i++)
+        if(aes_job_wait(&q->jobs[i]))
+            q->error = -1;
+    return q->error;
+}
+
+static inline u32 _isfs_sd_sector(u32 cluster){
+    return (cluster * CLUSTER_SIZE) / SDMMC_DEFAULT_BLOCKLEN;
+}
+
+static bool _isfs_sd_crypted(const isfs_ctx* ctx, u32 flags){
+    u8 index = ctx->bank & 0xFF;
+    bool nocrypto = index ? rednand.slccmpt_nocrypto : rednand.slc_nocrypto;
+    return (flags & ISFSVOL_FLAG_ENCRYPTED) && !nocrypto;
+}
+
+static int _isfs_read_sd_sync(const isfs_ctx* ctx, u32 lba, u32 cluster_count, bool crypted, void *data){
+    if(sdcard_read(lba, _isfs_sd_sector(cluster_count), data))
+        return -1;
+    if(!crypted)
+        return 0;
+
+    isfs_aes_queue q = {0};
+    for (u32 p = 0; p < cluster_count; p++){
+        u8 *cluster = (u8*)data + p * CLUSTER_SIZE;
+        _isfs_aes_queue_cluster(ctx, &q, AES_JOB_DECRYPT, cluster, cluster);
     }
+    return _isfs_aes_queue_finish(&q);
+}
 
+static int _isfs_read_sd(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count, u32 flags, void *data){
     u8 index = ctx->bank & 0xFF;
     rednand_partition redpart = index?rednand.slccmpt:rednand.slc;
 
     if(!redpart.lba_length)
         return -1;
 
-    if(sdcard_read(redpart.lba_start + make_sector(start_cluster), make_sector(cluster_count), data))
-        return -1;
+    u32 lba = redpart.lba_start + _isfs_sd_sector(start_cluster);
+    bool crypted = _isfs_sd_crypted(ctx, flags);
+    if(!crypted || cluster_count <= ISFS_SD_CHUNK || !can_sdcard_dma_addr(data))
+        return _isfs_read_sd_sync(ctx, lba, cluster_count, crypted, data);
+
+    /* decrypt chunk N while chunk N+1 is in flight */
+    struct sdmmc_command cmd;
+    isfs_aes_queue q = {0};
+    int res = 0;
+    u32 count = min(cluster_count, ISFS_SD_CHUNK);
+    if(sdcard_start_read(lba, _isfs_sd_sector(count), data, &cmd))
+        return _isfs_read_sd_sync(ctx, lba, cluster_count, crypted, data);
+
+    for (u32 c = 0; c < cluster_count; c += count){
+        u8 *chunk = (u8*)data + c * CLUSTER_SIZE;
+        count = min(cluster_count - c, ISFS_SD_CHUNK);
+        if(sdcard_end_read(&cmd)){
+            res = -1;
+            break;
+        }
 
-    if(flags & ISFSVOL_FLAG_ENCRYPTED){
-        for (int p = 0; p < cluster_count; p++){
-            _isfs_decrypt_cluster(ctx, data + p * CLUSTER_SIZE);
+        u32 next = c + count;
+        if(next < cluster_count){
+            u32 next_count = min(cluster_count - next, ISFS_SD_CHUNK);
+            if(sdcard_start_read(lba + _isfs_sd_sector(next), _isfs_sd_sector(next_count), chunk + count * CLUSTER_SIZE, &cmd)){
+                res = -1;
+                break;
+            }
+        }
+
+        for (u32 p = 0; p < count; p++){
+            u8 *cluster = chunk + p * CLUSTER_SIZE;
+            _isfs_aes_queue_cluster(ctx, &q, AES_JOB_DECRYPT, cluster, cluster);
         }
     }
-    return 0;
+    if(_isfs_aes_queue_finish(&q))
+        res = -1;
+
+    /* the plain path knows how to deal with flaky multi-block reads */
+    if(res)
+        res = _isfs_read_sd_sync(ctx, lba, cluster_count, crypted, data);
+    return res;
 }
 
 static int _nand_read_page_rawfile(u32 pageno, void *data, void *ecc, FIL* file){
@@ -169,16 +259,33 @@ int isfs_read_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count,
     u8 saved_hmacs[2][20] = {0}, hmac[20] = {0};
     u32 i, p;
 
+#ifdef NAND_WRITE_ENABLED
+    if(!ctx->file && _isfs_block_sync(ctx, start_cluster / BLOCK_CLUSTERS,
+                                      (start_cluster + cluster_count + BLOCK_CLUSTERS - 1) / BLOCK_CLUSTERS) < 0)
+        return ISFSVOL_ERROR_WRITE;
+#endif
+
     /* enable slc or slccmpt bank */
     if(!ctx->file)
         nand_initialize(ctx->bank);
 
+    isfs_aes_queue q = {0};
     bool ecc_correctable = false;
     bool ecc_uncorrectable = false;
     bool hmac_error = false;
     bool hmac_partial = false;
     bool nand_error = false;
 
+    /* the hmac is fed cluster by cluster as the data becomes plain */
+    hmac_ctx calc_hmac;
+    bool check_hmac = flags & ISFSVOL_FLAG_HMAC;
+    bool decrypt = flags & ISFSVOL_FLAG_ENCRYPTED;
+    if (check_hmac)
+    {
+        hmac_init(&calc_hmac, ctx->hmac, 20);
+        hmac_update(&calc_hmac, (const u8 *)hmac_seed, SHA_BLOCK_SIZE);
+    }
+
     /* read all requested clusters */
     for (i = 0; i < cluster_count; i++)
     {
@@ -226,12 +333,27 @@ int isfs_read_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count,
                 memcpy(&saved_hmacs[1][12], &ecc_buf[1], 8);
         }
 
-        /* decrypt cluster */
-        if (flags & ISFSVOL_FLAG_ENCRYPTED)
-            _isfs_decrypt_cluster(ctx, cluster_data);
-
+        /* decrypt cluster while the next one is read, and hash the
+         * previous one while this one is decrypted */
+        if (decrypt)
+        {
+            _isfs_aes_queue_cluster(ctx, &q, AES_JOB_DECRYPT, cluster_data, cluster_data);
+            if (check_hmac && i > 0)
+            {
+                _isfs_aes_queue_wait(&q, i - 1);
+                hmac_update(&calc_hmac, cluster_data - CLUSTER_SIZE, CLUSTER_SIZE);
+            }
+        }
+        else if (check_hmac)
+            hmac_update(&calc_hmac, cluster_data, CLUSTER_SIZE);
     }
 
+    if(_isfs_aes_queue_finish(&q))
+        nand_error = true;
+
+    if (check_hmac && decrypt && cluster_count)
+        hmac_update(&calc_hmac, (u8 *)data + (cluster_count - 1) * CLUSTER_SIZE, CLUSTER_SIZE);
+
     if(nand_error)
         return ISFSVOL_ERROR_READ; 
 
@@ -239,15 +361,10 @@ int isfs_read_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count,
         return ISFSVOL_ERROR_ECC;
 
     /* verify hmac */
-    if (flags & ISFSVOL_FLAG_HMAC)
+    if (check_hmac)
     {
-        hmac_ctx calc_hmac;
         int matched = 0;
 
-        /* compute clusters hmac */
-        hmac_init(&calc_hmac, ctx->hmac, 20);
-        hmac_update(&calc_hmac, (const u8 *)hmac_seed, SHA_BLOCK_SIZE);
-        hmac_update(&calc_hmac, (const u8 *)data, cluster_count * CLUSTER_SIZE);
         hmac_final(&calc_hmac, hmac);
 
         /* ensure at least one of the saved hmacs matches */
@@ -274,25 +391,185 @@ int isfs_read_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count,
 
 #ifdef NAND_WRITE_ENABLED
 static int _isfs_write_sd(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count, u32 flags, void *data){
-    inline u32 make_sector(u32 page) {
-        return (page * CLUSTER_SIZE) / SDMMC_DEFAULT_BLOCKLEN;
-    }
-
     u8 index = ctx->bank & 0xFF;
     rednand_partition redpart = index?rednand.slccmpt:rednand.slc;
 
     if(!redpart.lba_length)
         return -1;
 
-    if(sdcard_write(redpart.lba_start + make_sector(start_cluster), make_sector(cluster_count), data))
+    u32 lba = redpart.lba_start + _isfs_sd_sector(start_cluster);
+    if(!_isfs_sd_crypted(ctx, flags))
+        return sdcard_write(lba, _isfs_sd_sector(cluster_count), data) ? -1 : 0;
+
+    /* encrypt chunk N+1 into one staging buffer while chunk N is written from
+     * the other, the caller's data is left alone */
+    u8 *stage[2];
+    stage[0] = dma_pool_alloc(ISFS_SD_CHUNK * CLUSTER_SIZE);
+    stage[1] = dma_pool_alloc(ISFS_SD_CHUNK * CLUSTER_SIZE);
+    if(!stage[0] || !stage[1]){
+        dma_pool_free(stage[0]);
+        dma_pool_free(stage[1]);
         return -1;
+    }
+    bool async = can_sdcard_dma_addr(stage[0]) && can_sdcard_dma_addr(stage[1]);
 
-    if(flags & ISFSVOL_FLAG_ENCRYPTED){
-        for (int p = 0; p < cluster_count; p++){
-            _isfs_decrypt_cluster(ctx, data + p * CLUSTER_SIZE);
+    struct sdmmc_command cmd;
+    bool pending = false;
+    isfs_aes_queue q = {0};
+    int res = 0;
+    u32 count;
+    for (u32 c = 0, i = 0; c < cluster_count; c += count, i ^= 1){
+        count = min(cluster_count - c, ISFS_SD_CHUNK);
+        for (u32 p = 0; p < count; p++)
+            _isfs_aes_queue_cluster(ctx, &q, AES_JOB_ENCRYPT, (u8*)data + (c + p) * CLUSTER_SIZE, stage[i] + p * CLUSTER_SIZE);
+        if(_isfs_aes_queue_finish(&q)){
+            res = -1;
+            break;
+        }
+
+        if(pending){
+            pending = false;
+            if(sdcard_end_write(&cmd)){
+                res = -1;
+                break;
+            }
+        }
+
+        if(!async){
+            if(sdcard_write(lba + _isfs_sd_sector(c), _isfs_sd_sector(count), stage[i])){
+                res = -1;
+                break;
+            }
+        } else {
+            if(sdcard_start_write(lba + _isfs_sd_sector(c), _isfs_sd_sector(count), stage[i], &cmd)){
+                res = -1;
+                break;
+            }
+            pending = true;
         }
     }
-    return 0;
+    if(pending && sdcard_end_write(&cmd))
+        res = -1;
+
+    dma_pool_free(stage[0]);
+    dma_pool_free(stage[1]);
+    return res;
+}
+
+/* write-back copy of one nand block: writes that end inside a block are held
+ * here, so following writes to the same block are merged into a single
+ * read, erase and program cycle. the block stays held until it was
+ * programmed successfully, those writes were already reported as done */
+static u8 blockpg[BLOCK_PAGES][PAGE_SIZE] ALIGNED(NAND_DATA_ALIGN), blocksp[BLOCK_PAGES][PAGE_SPARE_SIZE];
+static struct {
+    const isfs_ctx* ctx;    /* NULL if nothing is held */
+    u32 block;
+    bool readback;
+    int status;             /* ECC status of held blocks programmed on behalf of someone else */
+} wb_block;
+
+static int _isfs_block_flush(void)
+{
+    static u8 pgbuf[PAGE_SIZE] ALIGNED(NAND_DATA_ALIGN);
+    const isfs_ctx* ctx = wb_block.ctx;
+    u32 firstblockpage = wb_block.block * BLOCK_PAGES;
+    bool ecc_corrected = false;
+    u32 p;
+
+    if (!ctx)
+        return ISFSVOL_OK;
+
+    nand_initialize(ctx->bank);
+
+    ISFS_debug("Erase block\n");
+    /* erase block */
+    if (nand_erase_block(firstblockpage) < 0)
+        return ISFSVOL_ERROR_ERASE;
+
+    int write_error = 0;
+    ISFS_debug("Writing\n");
+    /* write block */
+    for (p = 0; p < BLOCK_PAGES; p++)
+        if (nand_write_page(firstblockpage + p, blockpg[p], blocksp[p]) < 0){
+            printf("ISFS: Error writing page\n");
+            write_error = ISFSVOL_ERROR_WRITE;
+        }
+    if(write_error)
+        return write_error;
+
+    /* check if pages should be verified after writing */
+    if (!wb_block.readback) {
+        wb_block.ctx = NULL;
+        return ISFSVOL_OK;
+    }
+
+    ISFS_debug("Reading back\n");
+    /* read back pages */
+    for (p = 0; p < BLOCK_PAGES; p++)
+    {
+        memset(ecc_buf, 0xDEADBEEF, ECC_BUFFER_ALLOC);
+        if(nand_read_page(firstblockpage + p, pgbuf, ecc_buf) < 0){
+            printf("ISFS: Error reading back\n");
+            return ISFSVOL_ERROR_READ;
+        }
+        int res = nand_correct(firstblockpage + p, pgbuf, ecc_buf);
+        if(res<0)
+            return ISFSVOL_ERROR_READ;
+        if(res>0)
+            ecc_corrected = true;
+
+        /* page content doesn't match */
+        if (memcmp(blockpg[p], pgbuf, PAGE_SIZE)){
+            printf("ISFS: Read back data doesn't match\n");
+            return ISFSVOL_ERROR_READBACK;
+        }
+        if (memcmp(&blocksp[p][1], &ecc_buf[1], 0x20)){
+            printf("ISFS: Read back spare doesn't match\n");
+            return ISFSVOL_ERROR_READBACK;
+        }
+    }
+
+    wb_block.ctx = NULL;
+    if(ecc_corrected)
+        return ISFSVOL_ECC_CORRECTED;
+    return ISFSVOL_OK;
+}
+
+/* program the held block for a caller that didn't write it: a status > 0
+ * belongs to the writers that left the block held, so it's kept for their
+ * isfs_write_flush. errors leave the block held and are returned, the
+ * caller can't get at the block until it's programmed */
+static int _isfs_block_flush_other(void)
+{
+    int res = _isfs_block_flush();
+    if (res < 0)
+        return res;
+    wb_block.status |= res;
+    return ISFSVOL_OK;
+}
+
+/* program the held block, if any. returns the ECC status of every block
+ * that was held since the last call, or an error if the held block
+ * couldn't be programmed (it stays held, so this can be retried) */
+int isfs_write_flush(void)
+{
+    int res = _isfs_block_flush();
+    if (res < 0)
+        return res;
+
+    res |= wb_block.status;
+    wb_block.status = ISFSVOL_OK;
+    return res;
+}
+
+/* a held block has to reach the nand before it's read or written elsewhere */
+static int _isfs_block_sync(const isfs_ctx* ctx, u32 startblock, u32 endblock)
+{
+    if (!wb_block.ctx || wb_block.ctx->bank != ctx->bank)
+        return ISFSVOL_OK;
+    if (wb_block.block < startblock || wb_block.block >= endblock)
+        return ISFSVOL_OK;
+    return _isfs_block_flush_other();
 }
 
 int isfs_write_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count, u32 flags, void *hmac_seed, void *data)
@@ -301,16 +578,43 @@ int isfs_write_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count,
         return _isfs_write_sd(ctx, start_cluster, cluster_count, flags, data);
     }
 
-    static u8 blockpg[BLOCK_PAGES][PAGE_SIZE] ALIGNED(NAND_DATA_ALIGN), blocksp[BLOCK_PAGES][PAGE_SPARE_SIZE];
-    static u8 pgbuf[PAGE_SIZE] ALIGNED(NAND_DATA_ALIGN);
     u8 hmac[20] = {0};
     u32 b, p;
+    int res, rc = ISFSVOL_OK;
+
+    isfs_aes_queue q = {0};
+
+    u32 startpage = start_cluster * CLUSTER_PAGES;
+    u32 endpage = (start_cluster + cluster_count) * CLUSTER_PAGES;
+
+    u32 startblock = start_cluster / BLOCK_CLUSTERS;
+    u32 endblock = (start_cluster + cluster_count + BLOCK_CLUSTERS - 1) / BLOCK_CLUSTERS;
+
+    /* a different block is held, program it before its buffer is reused */
+    if (wb_block.ctx && (wb_block.ctx->bank != ctx->bank || wb_block.block != startblock))
+    {
+        res = _isfs_block_flush_other();
+        if (res < 0)
+            return res;
+    }
 
     /* enable slc or slccmpt bank */
     nand_initialize(ctx->bank);
 
-    /* compute clusters hmac */
-    if (flags & ISFSVOL_FLAG_HMAC)
+    /* start encrypting the first block, so the AES engine runs alongside the
+     * SHA engine computing the hmac below */
+    u32 queued_end = startpage;
+    if (flags & ISFSVOL_FLAG_ENCRYPTED)
+    {
+        queued_end = min(endpage, (startblock + 1) * BLOCK_PAGES);
+        for (u32 page = startpage; page < queued_end; page += CLUSTER_PAGES)
+            _isfs_aes_queue_cluster(ctx, &q, AES_JOB_ENCRYPT, (u8*)data + (page - startpage) * PAGE_SIZE,
+                                    blockpg[page - startblock * BLOCK_PAGES]);
+    }
+
+    /* compute clusters hmac, per cluster ones are done as the block is prepared */
+    bool cluster_hmac = flags & ISFSVOL_FLAG_HMAC_CLUSTERS;
+    if ((flags & ISFSVOL_FLAG_HMAC) && !cluster_hmac)
     {
         hmac_ctx calc_hmac;
         hmac_init(&calc_hmac, ctx->hmac, 20);
@@ -319,26 +623,11 @@ int isfs_write_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count,
         hmac_final(&calc_hmac, hmac);
     }
 
-    /* setup clusters encryption */
-    if (flags & ISFSVOL_FLAG_ENCRYPTED)
-    {
-        aes_reset();
-        aes_set_key((u8*)ctx->aes);
-        aes_empty_iv();
-    }
-
-    bool ecc_corrected = false;
-
-    u32 startpage = start_cluster * CLUSTER_PAGES;
-    u32 endpage = (start_cluster + cluster_count) * CLUSTER_PAGES;
-
-    u32 startblock = start_cluster / BLOCK_CLUSTERS;
-    u32 endblock = (start_cluster + cluster_count + BLOCK_CLUSTERS - 1) / BLOCK_CLUSTERS;
-
     /* process data in nand blocks */
     for (b = startblock; b < endblock; b++)
     {
         u32 firstblockpage = b * BLOCK_PAGES;
+        bool held = wb_block.ctx != NULL;
 
         /* prepare block */
         for (p = 0; p < 64; p++)
@@ -346,17 +635,32 @@ int isfs_write_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count,
             u32 curpage = firstblockpage + p;       /* current page */
             u32 clusidx = curpage % CLUSTER_PAGES;  /* index in cluster */
 
-            /* if this page is unmodified, read it from nand */
+            /* if this page is unmodified, read it from nand, unless the
+             * block is already held with earlier writes */
             if ((curpage < startpage) || (curpage >= endpage))
             {
+                if (held)
+                    continue;
                 ISFS_debug("Reading existing page\n");
                 nand_read_page(curpage, blockpg[p], ecc_buf);
-                if (nand_correct(curpage, blockpg[p], ecc_buf) < 0)
+                if (nand_correct(curpage, blockpg[p], ecc_buf) < 0) {
+                    _isfs_aes_queue_finish(&q);
                     return ISFSVOL_ERROR_READ;
+                }
                 memcpy(blocksp[p], ecc_buf, PAGE_SPARE_SIZE);
                 continue;
             }
 
+            if ((flags & ISFSVOL_FLAG_HMAC) && cluster_hmac && clusidx == 0)
+            {
+                u32 c = (curpage - startpage) / CLUSTER_PAGES;
+                hmac_ctx calc_hmac;
+                hmac_init(&calc_hmac, ctx->hmac, 20);
+                hmac_update(&calc_hmac, (const u8 *)hmac_seed + c * SHA_BLOCK_SIZE, SHA_BLOCK_SIZE);
+                hmac_update(&calc_hmac, (const u8 *)data + c * CLUSTER_SIZE, CLUSTER_SIZE);
+                hmac_final(&calc_hmac, hmac);
+            }
+
             /* place hmac in page 6 and 7 of a cluster */
             memset(blocksp[p], 0, PAGE_SPARE_SIZE);
             switch (clusidx)
@@ -370,63 +674,44 @@ int isfs_write_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count,
                 break;
             }
 
-            /* encrypt or copy the data */
+            /* encrypt (a whole cluster at once) or copy the data */
             u8 *srcdata = (u8*)data + (curpage - startpage) * PAGE_SIZE;
-            if (flags & ISFSVOL_FLAG_ENCRYPTED)
-                aes_encrypt(blockpg[p], srcdata, PAGE_SIZE / ISFSAES_BLOCK_SIZE, clusidx > 0);
+            if (flags & ISFSVOL_FLAG_ENCRYPTED) {
+                if (clusidx == 0 && curpage >= queued_end)
+                    _isfs_aes_queue_cluster(ctx, &q, AES_JOB_ENCRYPT, srcdata, blockpg[p]);
+            }
             else
                 memcpy(blockpg[p], srcdata, PAGE_SIZE);
         }
-        ISFS_debug("Erase block\n");
-        /* erase block */
-        if (nand_erase_block(b * BLOCK_PAGES) < 0)
-            return ISFSVOL_ERROR_ERASE;
-
-        int write_error = 0;
-        ISFS_debug("Writing\n");
-        /* write block */
-        for (p = 0; p < BLOCK_PAGES; p++)
-            if (nand_write_page(firstblockpage + p, blockpg[p], blocksp[p]) < 0){
-                printf("ISFS: Error writing page\n");
-                write_error = ISFSVOL_ERROR_WRITE;
-            }
-        if(write_error)
-            return write_error;
+        /* this write's pages are undefined now, but earlier writes merged
+         * into a held block still have to reach the nand */
+        if (_isfs_aes_queue_finish(&q)) {
+            if (!held)
+                wb_block.ctx = NULL;
+            return ISFSVOL_ERROR_WRITE;
+        }
 
-        /* check if pages should be verified after writing */
-        if (!(flags & ISFSVOL_FLAG_READBACK))
-            continue;
+        wb_block.ctx = ctx;
+        wb_block.block = b;
+        wb_block.readback = (held && wb_block.readback) || (flags & ISFSVOL_FLAG_READBACK);
 
-        ISFS_debug("Reading back\n");
-        /* read back pages */
-        for (p = 0; p < BLOCK_PAGES; p++)
-        {
-            memset(ecc_buf, 0xDEADBEEF, ECC_BUFFER_ALLOC);
-            if(nand_read_page(firstblockpage + p, pgbuf, ecc_buf) < 0){
-                printf("ISFS: Error reading back\n");
-                return ISFSVOL_ERROR_READ;
-            }
-            int res = nand_correct(firstblockpage + p, pgbuf, ecc_buf);
-            if(res<0)
-                return ISFSVOL_ERROR_READ;
-            if(res>0)
-                ecc_corrected = true;
-
-            /* page content doesn't match */
-            if (memcmp(blockpg[p], pgbuf, PAGE_SIZE)){
-                printf("ISFS: Read back data doesn't match\n");
-                return ISFSVOL_ERROR_READBACK;
-            }
-            if (memcmp(&blocksp[p][1], &ecc_buf[1], 0x20)){
-                printf("ISFS: Read back spare doesn't match\n");
-                return ISFSVOL_ERROR_READBACK;
-            }
+        /* hold the block if the write ended inside it, the next one might
+         * continue there */
+        if (endpage < firstblockpage + BLOCK_PAGES)
+            break;
+
+        /* only a block with earlier writes in it stays held on failure,
+         * otherwise this write just fails as a whole */
+        res = _isfs_block_flush();
+        if (res < 0) {
+            if (!held)
+                wb_block.ctx = NULL;
+            return res;
         }
+        rc |= res;
     }
 
-    if(ecc_corrected)
-        return ISFSVOL_ECC_CORRECTED;
-    return ISFSVOL_OK;
+    return rc;
 }
 #endif
 
@@ -704,24 +989,50 @@ bool isfs_is_isfshax_super(isfs_ctx* ctx, u8 index){
 
 int isfs_commit_super(isfs_ctx* ctx)
 {
+    /* data has to be on the nand before the super block pointing to it */
+    if(isfs_write_flush() < 0)
+        return -1;
+
     _isfs_get_hdr(ctx)->generation++;
 
-    for(int i = 1; i <= ctx->super_count; i++)
+    /* weak slots are only used once no healthy one could be written */
+    for(int pass = 0; pass < 2; pass++)
     {
-        u32 index = (ctx->index + i) % ctx->super_count;
+        for(int i = 1; i <= ctx->super_count; i++)
+        {
+            u32 index = (ctx->index + i) % ctx->super_count;
+            u32 cluster = CLUSTER_COUNT - (ctx->super_count - index) * ISFSSUPER_CLUSTERS;
 
-        // should also be protected by the badblock list.
-        if(isfs_is_isfshax_super(ctx, (u8)index))
-            continue;
+            // should also be protected by the badblock list.
+            if(isfs_is_isfshax_super(ctx, (u8)index))
+                continue;
 
-        if (_isfs_super_check_slot(ctx, index) < 0)
-            continue;
+            if (_isfs_super_check_slot(ctx, index) < 0)
+                continue;
 
-        if (isfs_write_super(ctx, ctx->super, index) >= 0)
-            return 0;
+            /* retire slots the health map knows are bad without trying them */
+            int health = nand_health_get_range(ctx->bank, cluster * CLUSTER_PAGES, ISFSSUPER_CLUSTERS * CLUSTER_PAGES);
+            if (health == NAND_HEALTH_BAD) {
+                isfs_super_mark_slot(ctx, index, FAT_CLUSTER_BAD);
+                continue;
+            }
+            /* weak or unreadable ones are still worth a rewrite */
+            if (health >= NAND_HEALTH_WEAK && !pass)
+                continue;
+
+            if (isfs_write_super(ctx, ctx->super, index) >= 0) {
+                /* clusters freed before this commit aren't referenced anymore */
+                ctx->dirty = false;
+                if (ctx->pending_free)
+                    memset(ctx->pending_free, 0, CLUSTER_COUNT / 8);
+                return 0;
+            }
 
-        isfs_super_mark_slot(ctx, index, FAT_CLUSTER_BAD);
-        _isfs_get_hdr(ctx)->generation++;
+            isfs_super_mark_slot(ctx, index, FAT_CLUSTER_BAD);
+            for (u32 b = 0; b < ISFSSUPER_CLUSTERS / BLOCK_CLUSTERS; b++)
+                nand_health_set(ctx->bank, cluster / BLOCK_CLUSTERS + b, NAND_HEALTH_BAD);
+            _isfs_get_hdr(ctx)->generation++;
+        }
     }
 
     return -1;
@@ -737,42 +1048,6 @@ isfs_fst* isfs_stat(const char* path)
     return _isfs_find_fst(ctx, path, NULL);
 }
 
-#ifdef NAND_WRITE_ENABLED
-int isfs_unlink(const char* path){
-    if(!path)
-        return -1;
-    isfs_ctx* ctx = NULL;
-    path = _isfs_do_volume(path, &ctx);
-    ISFS_debug("volume found: %p\n", ctx);
-    if(!ctx)return -ENOENT;
-
-    void *parent;
-    isfs_fst* fst = _isfs_find_fst(ctx, path, &parent);
-    ISFS_debug("fst found: %p\n", fst);
-    if(!fst) return -ENOENT;
-
-    if(!_isfs_fst_is_file(fst)) return -EISDIR;
-
-    //parent might be unaligned
-    memcpy(parent, &fst->sib, sizeof(fst->sib)); //remove from directory
-
-    u16* fat = _isfs_get_fat(ctx);
-    u16 cluster = fst->sub;
-    while(cluster < 0xFFFB) {  
-        u16 next_cluster = fat[cluster];
-        fat[cluster] = 0xFFFE;
-        cluster = next_cluster;
-    }
-
-    memset(fst, 0, sizeof(isfs_fst));
-
-    int res = isfs_commit_super(ctx);
-    if(res)
-        return -EIO;
-    return 0;
-}
-#endif //NAND_WRITE_ENABLED
-
 int isfs_open(isfs_file* file, const char* path)
 {
     if(!file || !path) return -1;
@@ -801,9 +1076,33 @@ int isfs_open(isfs_file* file, const char* path)
 int isfs_close(isfs_file* file)
 {
     if(!file) return -1;
+
+    int res = 0;
+#ifdef NAND_WRITE_ENABLED
+    if(file->writable) {
+        res = isfs_flush(file);
+        free(file->wbuf);
+        int commit = isfs_batch_end(file->volume);
+        if(!res) res = commit;
+    }
+#endif
     memset(file, 0, sizeof(isfs_file));
 
-    return 0;
+    return res;
+}
+
+/* cluster holding file->offset */
+static void _isfs_file_locate(isfs_ctx* ctx, isfs_file* file)
+{
+    u16 sub = file->fst->sub;
+    size_t size = file->offset;
+
+    while(size >= CLUSTER_SIZE && sub < FAT_CLUSTER_LAST) {
+        sub = _isfs_get_fat(ctx)[sub];
+        size -= CLUSTER_SIZE;
+    }
+
+    file->cluster = sub;
 }
 
 int isfs_seek(isfs_file* file, s32 offset, int whence)
@@ -814,6 +1113,11 @@ int isfs_seek(isfs_file* file, s32 offset, int whence)
     isfs_fst* fst = file->fst;
     if(!ctx || !fst) return -2;
 
+#ifdef NAND_WRITE_ENABLED
+    /* pending writes have to reach the FAT first */
+    if(file->wbuf_dirty && isfs_flush(file)) return -4;
+#endif
+
     switch(whence) {
         case SEEK_SET:
             if(offset < 0) return -1;
@@ -834,15 +1138,7 @@ int isfs_seek(isfs_file* file, s32 offset, int whence)
             break;
     }
 
-    u16 sub = fst->sub;
-    size_t size = file->offset;
-
-    while(size > 8 * PAGE_SIZE) {
-        sub = _isfs_get_fat(ctx)[sub];
-        size -= 8 * PAGE_SIZE;
-    }
-
-    file->cluster = sub;
+    _isfs_file_locate(ctx, file);
 
     return 0;
 }
@@ -855,6 +1151,11 @@ int isfs_read(isfs_file* file, void* buffer, size_t size, size_t* bytes_read)
     isfs_fst* fst = file->fst;
     if(!ctx || !fst) return -2;
 
+#ifdef NAND_WRITE_ENABLED
+    /* pending writes have to reach the FAT first */
+    if(file->wbuf_dirty && isfs_flush(file)) return -4;
+#endif
+
     if(size + file->offset > fst->size)
         size = fst->size - file->offset;
 
@@ -881,6 +1182,405 @@ int isfs_read(isfs_file* file, void* buffer, size_t size, size_t* bytes_read)
     return 0;
 }
 
+#ifdef NAND_WRITE_ENABLED
+static int _isfs_commit(isfs_ctx* ctx)
+{
+    if(!ctx->dirty)
+        return 0;
+    if(isfs_commit_super(ctx))
+        return -EIO;
+    return 0;
+}
+
+/* FAT or FST changed, commit right away unless a batch is open */
+static int _isfs_super_dirty(isfs_ctx* ctx)
+{
+    ctx->dirty = true;
+    if(ctx->batch)
+        return 0;
+    return _isfs_commit(ctx);
+}
+
+int isfs_batch_begin(int volume)
+{
+    isfs_ctx* ctx = isfs_get_volume(volume);
+    if(!ctx || !ctx->mounted) return -ENODEV;
+
+    ctx->batch++;
+    return 0;
+}
+
+int isfs_batch_end(int volume)
+{
+    isfs_ctx* ctx = isfs_get_volume(volume);
+    if(!ctx || !ctx->mounted || !ctx->batch) return -ENODEV;
+
+    if(--ctx->batch)
+        return 0;
+    return _isfs_commit(ctx);
+}
+
+static bool _isfs_cluster_is_free(isfs_ctx* ctx, u32 cluster)
+{
+    if(_isfs_get_fat(ctx)[cluster] != FAT_CLUSTER_EMPTY)
+        return false;
+    return !ctx->pending_free || !(ctx->pending_free[cluster / 8] & (1 << (cluster % 8)));
+}
+
+/* the committed superblock still references freed clusters, so they are only
+ * reused once the FAT has been committed */
+static void _isfs_free_cluster(isfs_ctx* ctx, u16 cluster)
+{
+    if(!ctx->pending_free)
+        ctx->pending_free = calloc(CLUSTER_COUNT / 8, 1);
+    if(ctx->pending_free)
+        ctx->pending_free[cluster / 8] |= 1 << (cluster % 8);
+    _isfs_get_fat(ctx)[cluster] = FAT_CLUSTER_EMPTY;
+}
+
+static void _isfs_free_chain(isfs_ctx* ctx, u16 cluster)
+{
+    u16* fat = _isfs_get_fat(ctx);
+    while(cluster < FAT_CLUSTER_LAST) {
+        u16 next_cluster = fat[cluster];
+        _isfs_free_cluster(ctx, cluster);
+        cluster = next_cluster;
+    }
+}
+
+static int _isfs_alloc_clusters(isfs_ctx* ctx, u16* clusters, u32 count)
+{
+    u16* fat = _isfs_get_fat(ctx);
+    const u32 blocks = CLUSTER_COUNT / BLOCK_CLUSTERS;
+    u32 found = 0;
+
+    /* take a whole empty nand block, so writing it doesn't have to read back
+     * and erase pages that are in use */
+    for(u32 n = 0; n < blocks && !found; n++) {
+        u32 b = (ctx->alloc_hint + n) % blocks;
+        u32 c;
+        if(nand_health_get(ctx->bank, b) >= NAND_HEALTH_WEAK)
+            continue;
+        for(c = 0; c < BLOCK_CLUSTERS; c++)
+            if(!_isfs_cluster_is_free(ctx, b * BLOCK_CLUSTERS + c))
+                break;
+        if(c < BLOCK_CLUSTERS)
+            continue;
+
+        for(c = 0; c < count; c++)
+            clusters[found++] = b * BLOCK_CLUSTERS + c;
+        ctx->alloc_hint = b + 1;
+    }
+
+    /* fragmented volume, use whatever is left outside weak or bad blocks */
+    for(u32 c = 0; c < CLUSTER_COUNT && found < count; c++) {
+        if(nand_health_get(ctx->bank, c / BLOCK_CLUSTERS) >= NAND_HEALTH_WEAK) {
+            c |= BLOCK_CLUSTERS - 1;
+            continue;
+        }
+        if(_isfs_cluster_is_free(ctx, c))
+            clusters[found++] = c;
+    }
+
+    if(found < count)
+        return -ENOSPC;
+
+    for(u32 c = 0; c < count; c++)
+        fat[clusters[c]] = FAT_CLUSTER_LAST;
+    return 0;
+}
+
+/* cluster number index of the file's chain */
+static u16 _isfs_file_cluster(isfs_ctx* ctx, isfs_fst* fst, u32 index, u16* prev)
+{
+    u16* fat = _isfs_get_fat(ctx);
+    u16 cluster = fst->sub;
+    *prev = FAT_CLUSTER_LAST;
+
+    while(index-- && cluster < FAT_CLUSTER_LAST) {
+        *prev = cluster;
+        cluster = fat[cluster];
+    }
+
+    return cluster;
+}
+
+int isfs_create(const char* path, bool dir)
+{
+    if(!path) return -EINVAL;
+
+    isfs_ctx* ctx = NULL;
+    path = _isfs_do_volume(path, &ctx);
+    if(!ctx || !path) return -ENOENT;
+
+    while(*path == '/') path++;
+    const char* name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    size_t len = strlen(name);
+    if(!len) return -EINVAL;
+    if(len > sizeof(((isfs_fst*)0)->name)) return -ENAMETOOLONG;
+
+    if(_isfs_find_fst(ctx, path, NULL)) return -EEXIST;
+
+    isfs_fst* root = _isfs_get_fst(ctx);
+    isfs_fst* parent = root;
+    if(name != path) {
+        char* parent_path = strndup(path, name - path - 1);
+        if(!parent_path) return -ENOMEM;
+        parent = _isfs_find_fst(ctx, parent_path, NULL);
+        free(parent_path);
+        if(!parent) return -ENOENT;
+    }
+    if(!_isfs_fst_is_dir(parent)) return -ENOTDIR;
+
+    u32 index;
+    for(index = 1; index < ISFS_FST_COUNT; index++)
+        if(!_isfs_fst_get_type(&root[index]))
+            break;
+    if(index >= ISFS_FST_COUNT) return -ENOSPC;
+
+    /* permissions and owner come from the parent */
+    isfs_fst* fst = &root[index];
+    memset(fst, 0, sizeof(isfs_fst));
+    memcpy(fst->name, name, len);
+    fst->mode = (parent->mode & ~3) | (dir ? 2 : 1);
+    fst->uid = parent->uid;
+    fst->gid = parent->gid;
+    fst->sub = 0xFFFF;
+    fst->sib = parent->sub;
+    parent->sub = index;
+
+    return _isfs_super_dirty(ctx);
+}
+
+int isfs_unlink(const char* path){
+    if(!path)
+        return -1;
+    isfs_ctx* ctx = NULL;
+    path = _isfs_do_volume(path, &ctx);
+    ISFS_debug("volume found: %p\n", ctx);
+    if(!ctx)return -ENOENT;
+
+    void *parent;
+    isfs_fst* fst = _isfs_find_fst(ctx, path, &parent);
+    ISFS_debug("fst found: %p\n", fst);
+    if(!fst) return -ENOENT;
+
+    if(!_isfs_fst_is_file(fst)) return -EISDIR;
+
+    //parent might be unaligned
+    memcpy(parent, &fst->sib, sizeof(fst->sib)); //remove from directory
+
+    _isfs_free_chain(ctx, fst->sub);
+
+    memset(fst, 0, sizeof(isfs_fst));
+
+    return _isfs_super_dirty(ctx);
+}
+
+int isfs_open_write(isfs_file* file, const char* path)
+{
+    int res = isfs_open(file, path);
+    if(res) return (res == -4) ? -EISDIR : -ENOENT;
+
+    file->wbuf = memalign(NAND_DATA_ALIGN, ISFS_FILE_BLOCK_SIZE);
+    if(!file->wbuf) {
+        isfs_close(file);
+        return -ENOMEM;
+    }
+    file->writable = true;
+    file->size = file->fst->size;
+    file->wbuf_block = -1;
+
+    /* everything written through this file is committed at once on close */
+    isfs_batch_begin(file->volume);
+    return 0;
+}
+
+/* bring a file block into wbuf, with what is already stored of it */
+static int _isfs_file_load(isfs_ctx* ctx, isfs_file* file, s32 block)
+{
+    int res = isfs_flush(file);
+    if(res) return res;
+
+    isfs_fst* fst = file->fst;
+    u32 first = block * BLOCK_CLUSTERS;
+    u16 prev;
+    u16 cluster = _isfs_file_cluster(ctx, fst, first, &prev);
+
+    memset(file->wbuf, 0, ISFS_FILE_BLOCK_SIZE);
+    for(u32 i = 0; i < BLOCK_CLUSTERS && (first + i) * CLUSTER_SIZE < fst->size; i++) {
+        if(cluster >= FAT_CLUSTER_LAST)
+            return -EIO;
+        if(isfs_read_volume(ctx, cluster, 1, ISFSVOL_FLAG_ENCRYPTED, NULL, file->wbuf + i * CLUSTER_SIZE) < 0)
+            return -EIO;
+        cluster = _isfs_get_fat(ctx)[cluster];
+    }
+
+    file->wbuf_block = block;
+    return 0;
+}
+
+int isfs_write(isfs_file* file, const void* buffer, size_t size, size_t* bytes_written)
+{
+    if(!file || !buffer) return -EINVAL;
+    if(!file->writable) return -EBADF;
+
+    isfs_ctx* ctx = isfs_get_volume(file->volume);
+    if(!ctx || !file->fst) return -EBADF;
+
+    size_t total = size;
+
+    while(size) {
+        s32 block = file->offset / ISFS_FILE_BLOCK_SIZE;
+        if(block != file->wbuf_block) {
+            int res = _isfs_file_load(ctx, file, block);
+            if(res) return res;
+        }
+
+        size_t pos = file->offset % ISFS_FILE_BLOCK_SIZE;
+        size_t copy = min(ISFS_FILE_BLOCK_SIZE - pos, size);
+        memcpy(file->wbuf + pos, buffer, copy);
+        file->wbuf_dirty = true;
+
+        file->offset += copy;
+        buffer += copy;
+        size -= copy;
+
+        if(file->offset > file->size)
+            file->size = file->offset;
+    }
+
+    *bytes_written = total;
+    return 0;
+}
+
+/* write wbuf to freshly allocated clusters and swap them into the chain, the
+ * old ones stay intact until the next commit */
+int isfs_flush(isfs_file* file)
+{
+    if(!file) return -EINVAL;
+    if(!file->wbuf_dirty) return 0;
+
+    isfs_ctx* ctx = isfs_get_volume(file->volume);
+    isfs_fst* fst = file->fst;
+    if(!ctx || !fst) return -EBADF;
+
+    u16* fat = _isfs_get_fat(ctx);
+    u32 first = file->wbuf_block * BLOCK_CLUSTERS;
+    u32 end = min(file->size, (first + BLOCK_CLUSTERS) * CLUSTER_SIZE);
+    u32 count = (end - first * CLUSTER_SIZE + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    u16 clusters[BLOCK_CLUSTERS];
+    u32 i, run;
+
+    int res = _isfs_alloc_clusters(ctx, clusters, count);
+    if(res) return res;
+
+    isfs_hmac_data seeds[BLOCK_CLUSTERS];
+    memset(seeds, 0, sizeof(seeds));
+    for(i = 0; i < count; i++) {
+        seeds[i].x1 = fst->x1;
+        seeds[i].uid = fst->uid;
+        memcpy(seeds[i].name, fst->name, sizeof(seeds[i].name));
+        seeds[i].iblk = first + i;
+        seeds[i].ifst = fst - _isfs_get_fst(ctx);
+        seeds[i].x3 = fst->x3;
+    }
+
+    /* one write per contiguous run, a single one unless the volume is fragmented */
+    for(i = 0; i < count; i += run) {
+        for(run = 1; i + run < count && clusters[i + run] == clusters[i] + run; run++);
+
+        if(isfs_write_volume(ctx, clusters[i], run, ISFSVOL_FLAG_HMAC | ISFSVOL_FLAG_HMAC_CLUSTERS | ISFSVOL_FLAG_ENCRYPTED,
+                             &seeds[i], file->wbuf + i * CLUSTER_SIZE) < 0) {
+            printf("ISFS: failed to write cluster 0x%04x\n", clusters[i]);
+            for(u32 c = 0; c < count; c++)
+                fat[clusters[c]] = (c >= i && c < i + run) ? FAT_CLUSTER_BAD : FAT_CLUSTER_EMPTY;
+            _isfs_super_dirty(ctx);
+            return -EIO;
+        }
+    }
+
+    /* link the new clusters in place of the old ones */
+    u16 prev;
+    u16 old = _isfs_file_cluster(ctx, fst, first, &prev);
+    for(i = 0; i < count && old < FAT_CLUSTER_LAST; i++) {
+        u16 next_cluster = fat[old];
+        _isfs_free_cluster(ctx, old);
+        old = next_cluster;
+    }
+    for(i = 0; i + 1 < count; i++)
+        fat[clusters[i]] = clusters[i + 1];
+    fat[clusters[count - 1]] = (old < FAT_CLUSTER_LAST) ? old : FAT_CLUSTER_LAST;
+
+    if(first)
+        fat[prev] = clusters[0];
+    else
+        fst->sub = clusters[0];
+    fst->size = file->size;
+
+    file->wbuf_dirty = false;
+    _isfs_file_locate(ctx, file);
+
+    return _isfs_super_dirty(ctx);
+}
+
+int isfs_truncate(isfs_file* file, size_t size)
+{
+    if(!file) return -EINVAL;
+    if(!file->writable) return -EBADF;
+
+    isfs_ctx* ctx = isfs_get_volume(file->volume);
+    isfs_fst* fst = file->fst;
+    if(!ctx || !fst) return -EBADF;
+
+    int res = isfs_flush(file);
+    if(res) return res;
+
+    /* zero fill up to the new size */
+    while(file->size < size) {
+        s32 block = file->size / ISFS_FILE_BLOCK_SIZE;
+        if(block != file->wbuf_block) {
+            res = _isfs_file_load(ctx, file, block);
+            if(res) return res;
+        }
+
+        size_t pos = file->size % ISFS_FILE_BLOCK_SIZE;
+        size_t fill = min(ISFS_FILE_BLOCK_SIZE - pos, size - file->size);
+        memset(file->wbuf + pos, 0, fill);
+        file->wbuf_dirty = true;
+        file->size += fill;
+    }
+    if(file->wbuf_dirty)
+        return isfs_flush(file);
+
+    if(file->size == size)
+        return 0;
+
+    u32 keep = (size + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    u16* fat = _isfs_get_fat(ctx);
+    if(!keep) {
+        _isfs_free_chain(ctx, fst->sub);
+        fst->sub = 0xFFFF;
+    } else {
+        u16 prev;
+        u16 last = _isfs_file_cluster(ctx, fst, keep - 1, &prev);
+        if(last >= FAT_CLUSTER_LAST)
+            return -EIO;
+        _isfs_free_chain(ctx, fat[last]);
+        fat[last] = FAT_CLUSTER_LAST;
+    }
+    fst->size = file->size = size;
+
+    file->wbuf_block = -1;
+    if(file->offset > size)
+        file->offset = size;
+    _isfs_file_locate(ctx, file);
+
+    return _isfs_super_dirty(ctx);
+}
+#endif //NAND_WRITE_ENABLED
+
 int isfs_diropen(isfs_dir* dir, const char* path)
 {
     if(!dir || !path) return -1;
@@ -986,6 +1686,14 @@ int isfs_unmount(int volume){
     if(!ctx->mounted)
         return 1;
 
+#ifdef NAND_WRITE_ENABLED
+    ctx->batch = 0;
+    if(isfs_write_flush() < 0 || _isfs_commit(ctx))
+        printf("ISFS: failed to commit %s!\n", ctx->name);
+    free(ctx->pending_free);
+    ctx->pending_free = NULL;
+#endif
+
     if(ctx->super) {
         free(ctx->super);
         ctx->super = NULL;
@@ -1064,10 +1772,35 @@ static int _isfsdev_open_r(struct _reent* r, void* fileStruct, const char* path,
 {
     isfs_file* fp = (isfs_file*) fileStruct;
 
+#ifdef NAND_WRITE_ENABLED
+    if ((flags & O_ACCMODE) != O_RDONLY || (flags & O_CREAT)) {
+        memset(fp, 0, sizeof(isfs_file));
+        int res = 0;
+        if (flags & O_CREAT) {
+            res = isfs_create(path, false);
+            if (res == -EEXIST && !(flags & O_EXCL))
+                res = 0;
+        }
+        if (!res)
+            res = isfs_open_write(fp, path);
+        if (!res && (flags & O_TRUNC))
+            res = isfs_truncate(fp, 0);
+        if (!res && (flags & O_APPEND))
+            fp->offset = fp->size;
+        if (res) {
+            if (fp->writable)
+                isfs_close(fp);
+            r->_errno = -res;
+            return -1;
+        }
+        return 0;
+    }
+#else
     if (flags & (O_WRONLY | O_RDWR | O_CREAT | O_EXCL | O_TRUNC)) {
         r->_errno = ENOSYS;
         return -1;
     }
+#endif
 
     int res = isfs_open(fp, path);
     if(res) {
@@ -1174,6 +1907,56 @@ static int _isfsdev_unlink_r(struct _reent* r, const char* path){
     }
     return 0;
 }
+
+static ssize_t _isfsdev_write_r(struct _reent* r, void* fd, const char* ptr, size_t len)
+{
+    isfs_file* fp = (isfs_file*) fd;
+
+    size_t written = 0;
+    int res = isfs_write(fp, ptr, len, &written);
+    if(res) {
+        r->_errno = -res;
+        return -1;
+    }
+
+    return written;
+}
+
+static int _isfsdev_ftruncate_r(struct _reent* r, void* fd, off_t len)
+{
+    isfs_file* fp = (isfs_file*) fd;
+
+    int res = len < 0 ? -EINVAL : isfs_truncate(fp, len);
+    if(res) {
+        r->_errno = -res;
+        return -1;
+    }
+    return 0;
+}
+
+static int _isfsdev_fsync_r(struct _reent* r, void* fd)
+{
+    isfs_file* fp = (isfs_file*) fd;
+
+    int res = isfs_flush(fp);
+    if(!res)
+        res = _isfs_commit(isfs_get_volume(fp->volume));
+    if(res) {
+        r->_errno = -res;
+        return -1;
+    }
+    return 0;
+}
+
+static int _isfsdev_mkdir_r(struct _reent* r, const char* path, int mode)
+{
+    int res = isfs_create(path, true);
+    if(res) {
+        r->_errno = -res;
+        return -1;
+    }
+    return 0;
+}
 #endif
 
 int _isfsdev_init(isfs_ctx* ctx)
@@ -1192,14 +1975,10 @@ int _isfsdev_init(isfs_ctx* ctx)
     dotab->chmod_r = _isfsdev_stub_r;
     dotab->fchmod_r = _isfsdev_stub_r;
     dotab->fstat_r = _isfsdev_stub_r;
-    dotab->fsync_r = _isfsdev_stub_r;
-    dotab->ftruncate_r = _isfsdev_stub_r;
     dotab->link_r = _isfsdev_stub_r;
-    dotab->mkdir_r = _isfsdev_stub_r;
     dotab->rename_r = _isfsdev_stub_r;
     dotab->rmdir_r = _isfsdev_stub_r;
     dotab->statvfs_r = _isfsdev_stub_r;
-    dotab->write_r = _isfsdev_stub_r;
 
     dotab->close_r = _isfsdev_close_r;
     dotab->open_r = _isfsdev_open_r;
@@ -1212,8 +1991,16 @@ int _isfsdev_init(isfs_ctx* ctx)
     dotab->dirreset_r = _isfsdev_dirreset_r;
 #ifdef NAND_WRITE_ENABLED
     dotab->unlink_r = _isfsdev_unlink_r;
+    dotab->write_r = _isfsdev_write_r;
+    dotab->ftruncate_r = _isfsdev_ftruncate_r;
+    dotab->fsync_r = _isfsdev_fsync_r;
+    dotab->mkdir_r = _isfsdev_mkdir_r;
 #else
     dotab->unlink_r = _isfsdev_stub_r;
+    dotab->write_r = _isfsdev_stub_r;
+    dotab->ftruncate_r = _isfsdev_stub_r;
+    dotab->fsync_r = _isfsdev_stub_r;
+    dotab->mkdir_r = _isfsdev_stub_r;
 #endif
 
     AddDevice(dotab);
@@ -26,6 +26,7 @@
 #define ISFSVOL_FLAG_HMAC       1
 #define ISFSVOL_FLAG_ENCRYPTED  2
 #define ISFSVOL_FLAG_READBACK   4
+#define ISFSVOL_FLAG_HMAC_CLUSTERS 8 // one hmac per cluster, hmac_seed is an array of seeds
 
 #define ISFSVOL_OK              0
 #define ISFSVOL_ECC_CORRECTED   0x10
@@ -44,6 +45,10 @@
 #define FAT_CLUSTER_BAD         0xFFFD // bad block (marked at factory)
 #define FAT_CLUSTER_EMPTY       0xFFFE // empty (unused / available) space
 
+#define ISFS_FST_COUNT      ((ISFSSUPER_SIZE - 0x1000C) / sizeof(isfs_fst))
+// files are written a whole nand block at a time
+#define ISFS_FILE_BLOCK_SIZE    (BLOCK_CLUSTERS * CLUSTER_SIZE)
+
 
 typedef struct {
     char name[12];
@@ -76,6 +81,10 @@ typedef struct {
     u8 hmac[0x14];
     devoptab_t devoptab;
     FIL* file;
+    int batch;
+    bool dirty;
+    u32 alloc_hint;
+    u8* pending_free; // clusters freed since the last commit, not reusable yet
 } isfs_ctx;
 
 typedef struct {
@@ -83,6 +92,11 @@ typedef struct {
     isfs_fst* fst;
     size_t offset;
     u16 cluster;
+    bool writable;
+    size_t size;     // including data still in wbuf
+    u8* wbuf;        // one file block being written
+    s32 wbuf_block;
+    bool wbuf_dirty;
 } isfs_file;
 
 typedef struct {
@@ -129,6 +143,18 @@ int isfs_close(isfs_file* file);
 
 int isfs_seek(isfs_file* file, s32 offset, int whence);
 int isfs_read(isfs_file* file, void* buffer, size_t size, size_t* bytes_read);
+#ifdef NAND_WRITE_ENABLED
+int isfs_create(const char* path, bool dir);
+int isfs_open_write(isfs_file* file, const char* path);
+int isfs_write(isfs_file* file, const void* buffer, size_t size, size_t* bytes_written);
+int isfs_truncate(isfs_file* file, size_t size);
+int isfs_flush(isfs_file* file);
+int isfs_unlink(const char* path);
+
+// FAT and FST changes are only committed once the outermost batch ends
+int isfs_batch_begin(int volume);
+int isfs_batch_end(int volume);
+#endif
 
 char* _isfs_do_volume(const char* path, isfs_ctx** ctx);
 isfs_ctx* isfs_get_volume(int volume);
@@ -138,6 +164,7 @@ bool isfs_is_isfshax_super(isfs_ctx* ctx, u8 index);
 int isfs_load_super(isfs_ctx* ctx);
 #ifdef NAND_WRITE_ENABLED
 int isfs_write_volume(const isfs_ctx* ctx, u32 start_cluster, u32 cluster_count, u32 flags, void *hmac_seed, void *data);
+int isfs_write_flush(void);
 int isfs_write_super(isfs_ctx *ctx, void *super, int index);
 int isfs_commit_super(isfs_ctx* ctx);
 int isfs_super_mark_slot(isfs_ctx *ctx, u32 index, u16 marker);
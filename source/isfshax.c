@@ -33,6 +33,7 @@
 #include "types.h"
 #include "isfs.h"
 #include "isfshax.h"
+#include "nand_health.h"
 #include "malloc.h"
 
 #include <stdio.h>
@@ -182,7 +183,12 @@ int isfshax_refresh(void)
             continue;
         if(write_gen > ISFSHAX_GENERATION_FIRST + ISFSHAX_GENERATION_RANGE)
             return ISFSHAX_ERROR_EXCEEDED_GENERATION;
-        res = isfshax_rewrite_super(slc, rewrite_index, write_gen, &superblock);
+        /* slots the health map knows are bad are retired without trying */
+        u32 slot_cluster = CLUSTER_COUNT - (SLC_SUPER_COUNT - superblock.isfshax.slots[rewrite_index].slot) * ISFSSUPER_CLUSTERS;
+        if(nand_health_get_range(slc->bank, slot_cluster * CLUSTER_PAGES, ISFSSUPER_CLUSTERS * CLUSTER_PAGES) == NAND_HEALTH_BAD)
+            res = ISFSVOL_ERROR_WRITE;
+        else
+            res = isfshax_rewrite_super(slc, rewrite_index, write_gen, &superblock);
         if(res>=0)
             return (i?ISFSHAX_REWRITE_SLOT_BECAME_BAD:ISFSHAX_REWRITE_HAPPENED) + bad_slot_count;
 
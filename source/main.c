@@ -30,6 +30,7 @@
 #include "exception.h"
 #include "crypto.h"
 #include "nand.h"
+#include "nand_health.h"
 #include "sdhc.h"
 #include "dump.h"
 #include "isfs.h"
@@ -43,6 +44,7 @@
 #include "ppc_elf.h"
 #include "ppc.h"
 #include "dram.h"
+#include "pll.h"
 #include "smc.h"
 #include "rtc.h"
 #include "prsh.h"
@@ -54,6 +56,8 @@
 #include "rednand.h"
 #include "isfshax_patch.h"
 #include "usb.h"
+#include "dma_pool.h"
+#include "crashlog.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -110,26 +114,13 @@ static u32 boot1_patch_isfshax(void){
 
 #ifdef MINUTE_BOOT1
 
-static bool read_ancast(const char *path){
-    FILE *f = fopen(path, "rb");
-    if (!f) {
-        return false;
-    }
-    size_t read = fread((void*)ALL_PURPOSE_TMP_BUF, 1, 0x800000, f);
-    if (!read) {
-        return false;
-    }
-    fclose(f);
-
-    return *(u32*)ALL_PURPOSE_TMP_BUF == ANCAST_MAGIC; 
-}
-
-static bool load_fw_from_sd_fat(void){
+// Returns the IOS vector, or 0 if nothing could be loaded from the FAT
+// partition so the caller can fall back to the raw sectors.
+static u32 load_fw_from_sd_fat(void){
         FRESULT res = FR_OK;
         static FATFS fatfs = {0};
-        static devoptab_t devoptab = {0};
         FIL f = {0};
-        unsigned int read;
+        const char* path = "sdmc:/minute.img";
 
         serial_send_u32(0x5D5E0004);
 
@@ -138,27 +129,27 @@ static bool load_fw_from_sd_fat(void){
             sdcard_init(); // TODO whyyyyy
             res = f_mount(&fatfs, "sdmc:", 1);
             if (res != FR_OK) {
-                return false;
+                return 0;
             }
         }
-        res = f_open(&f, "sdmc:/minute.img", FA_OPEN_EXISTING | FA_READ);
+        res = f_open(&f, path, FA_OPEN_EXISTING | FA_READ);
         if (res == FR_OK) {
             use_minute_img = true;
         } else {
-            res = f_open(&f, "sdmc:/fw.img", FA_OPEN_EXISTING | FA_READ);
+            path = "sdmc:/fw.img";
+            res = f_open(&f, path, FA_OPEN_EXISTING | FA_READ);
             if (res != FR_OK) {
-                return false;
+                return 0;
             }
         }
-        res = f_read(&f, (void*)ALL_PURPOSE_TMP_BUF, 0x800000, &read);
+
+        // Header first, then the body straight to its load address.
+        u32 vector = ancast_iop_load_from_fatfs(&f, path);
         f_close(&f);
-        if (res != FR_OK) {
-            return false;
-        }
 
         serial_send_u32(0x5D5E0008);
 
-        return *(u32*)ALL_PURPOSE_TMP_BUF == ANCAST_MAGIC;
+        return vector;
 }
 
 static u32 load_fw_from_sd(bool retry_forever){
@@ -172,11 +163,8 @@ static u32 load_fw_from_sd(bool retry_forever){
         sdcard_init();
         serial_send_u32(0x6D6D0001);
 
-        int loaded_from_fat = load_fw_from_sd_fat();
-        if (loaded_from_fat) {
-            vector = ancast_iop_load_from_memory((void*)ALL_PURPOSE_TMP_BUF);
-        }
-        else {
+        vector = load_fw_from_sd_fat();
+        if (!vector) {
             vector = ancast_iop_load_from_raw_sector(0x80);
         }
         
@@ -240,6 +228,7 @@ u32 _main(void *base)
     exception_initialize();
     printf("Configuring caches and MMU...\n");
     mem_initialize();
+    dma_pool_init();
 
     // Adjust IOP clock multiplier to 1x
     if (read32(LT_IOP2X) & 0x04)
@@ -401,6 +390,7 @@ u32 _main(void *base)
 #ifndef ISFSHAX_STAGE2
     // Init DRAM
     init_mem2(mem_mode);
+    pll_print_skipped();
     udelay(500000);
 
     // Test that DRAM is working/refreshing correctly
@@ -500,13 +490,11 @@ u32 _main(void *base)
 #ifdef ISFSHAX_STAGE2
     if(slc_mounted){
         if(!boot.vector) {
-            bool ok = read_ancast("slc:/sys/hax/minute.img");
-            if(ok)
+            boot.vector = ancast_iop_load("slc:/sys/hax/minute.img");
+            if(boot.vector)
                 use_minute_img = true;
             else
-                ok = read_ancast("slc:/sys/hax/fw.img");
-            if(ok)
-                boot.vector = ancast_iop_load_from_memory((void*)ALL_PURPOSE_TMP_BUF);
+                boot.vector = ancast_iop_load("slc:/sys/hax/fw.img");
             serial_send_u32(0x5D4D0005);
             if(boot.vector){
                 boot.mode = 0;
@@ -797,9 +785,12 @@ u32 _main(void *base)
     exception_initialize();
     printf("Configuring caches and MMU...\n");
     mem_initialize();
+    dma_pool_init();
 
     irq_initialize();
     printf("Interrupts initialized\n");
+    smc_events_start(25);
+    rtc_time_init();
 
     srand(read32(LT_TIMER));
     crypto_initialize();
@@ -826,6 +817,8 @@ u32 _main(void *base)
     minini_init();
     if(autoboot_timeout_s)
         enable_display();
+    nand_health_load(NAND_BANK_SLC);
+    nand_health_load(NAND_BANK_SLCCMPT);
 #endif
 #ifdef MEASURE_TIME
     u32 ini_end = read32(LT_TIMER);
@@ -1070,6 +1063,7 @@ skip_menu:
 #endif //!FASTBOOT
 
     printf("Shutting down interrupts...\n");
+    smc_events_stop();
     irq_shutdown();
 
     printf("Shutting down caches and MMU...\n");
@@ -1118,6 +1112,7 @@ skip_menu:
             init_end-minute_start_time, graphic_start-minute_start_time, graphic_end-graphic_start, 
             sd_start-graphic_end, sd_end-sd_start, ini_start-sd_end, ini_end-ini_start, init_end-ini_end,
             deinit_start-init_end, end-deinit_start);
+    pll_print_skipped();
 #endif // MEASURE_TIME
 
     printf("Jumping to IOS... GO GO GO\n");
@@ -1407,9 +1402,14 @@ void main_reset_crash(void)
 	const char buffer[64 + 1] = "Crash buffer empty.";
 	rtc_set_panic_reason(buffer);
 
+	printf("Clearing crash log...\n");
+	crashlog_clear();
+
     console_power_to_exit();
 }
 
+#define MAIN_CRASH_LIST (8)
+
 void main_get_crash(void)
 {
     gfx_clear(GFX_ALL, BLACK);
@@ -1445,6 +1445,20 @@ void main_get_crash(void)
         printf("%s\n", buffer);
     }
 
+    crashlog_entry* entries = malloc(sizeof(crashlog_entry) * MAIN_CRASH_LIST);
+    int count = entries ? crashlog_get(entries, MAIN_CRASH_LIST) : 0;
+    if(count) {
+        printf("\nLast %d crash log entries:\n", count);
+        for(int i = 0; i < count; i++)
+            crashlog_print(&entries[i]);
+
+        int exported = 0;
+        for(int i = 0; i < count; i++)
+            exported += !crashlog_export(&entries[i]);
+        printf("Exported %d entries to %s.\n", exported, CRASHLOG_DIR);
+    }
+    free(entries);
+
     console_power_to_exit();
 }
 
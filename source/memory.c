@@ -17,9 +17,13 @@
 #include "latte.h"
 #include "irq.h"
 
+#include <string.h>
+
 void _dc_inval_entries(void *start, int count);
 void _dc_flush_entries(const void *start, int count);
 void _dc_flush(void);
+void _dc_flush_inval_entries(void *start, int count);
+void _dc_flush_inval(void);
 void _ic_inval(void);
 void _drain_write_buffer(void);
 
@@ -36,6 +40,14 @@ void _tlb_inval(void);
 #define CR_DCACHE   (1 << 2)
 #define CR_ICACHE   (1 << 12)
 
+// Set by mem_map_uncached(); cache maintenance on this range is skipped.
+static u32 uncached_start = 0, uncached_end = 0;
+
+static inline bool is_uncached(const void *start, u32 size)
+{
+    return (u32)start >= uncached_start && (u32)start + size <= uncached_end;
+}
+
 // this is ripped from IOS, because no one can figure out just WTF this thing is doing
 void _ahb_flush_to(enum rb_client dev) {
     u32 mask;
@@ -220,7 +232,9 @@ done:
 void dc_flushrange(const void *start, u32 size)
 {
     u32 cookie = irq_kill();
-    if(size > 0x4000) {
+    if(is_uncached(start, size)) {
+        // nothing to write back, but the write buffer still has to drain
+    } else if(size > 0x4000) {
         _dc_flush();
     } else {
         void *end = ALIGN_FORWARD(((u8*)start) + size, LINESIZE);
@@ -237,7 +251,8 @@ void dc_invalidaterange(void *start, u32 size)
     u32 cookie = irq_kill();
     void *end = ALIGN_FORWARD(((u8*)start) + size, LINESIZE);
     start = ALIGN_BACKWARD(start, LINESIZE);
-    _dc_inval_entries(start, (end - start) / LINESIZE);
+    if(!is_uncached(start, end - start))
+        _dc_inval_entries(start, (end - start) / LINESIZE);
     ahb_flush_to(RB_IOD);
     irq_restore(cookie);
 }
@@ -251,6 +266,69 @@ void dc_flushall(void)
     irq_restore(cookie);
 }
 
+void dc_batch_init(dc_batch *b)
+{
+    memset(b, 0, sizeof(*b));
+}
+
+static void dc_batch_add(dc_batch *b, const void *start, u32 size, bool inval)
+{
+    if(!size || is_uncached(start, size))
+        return;
+
+    b->total += size;
+    b->any_inval |= inval;
+    if(b->count == DC_BATCH_RANGES || b->total > CACHESIZE) {
+        b->whole = true;
+        return;
+    }
+
+    b->start[b->count] = (u32)ALIGN_BACKWARD(start, LINESIZE);
+    b->end[b->count] = (u32)ALIGN_FORWARD(((u8*)start) + size, LINESIZE);
+    b->inval[b->count] = inval;
+    b->count++;
+}
+
+// write back before the device reads it
+void dc_batch_flush(dc_batch *b, const void *start, u32 size)
+{
+    dc_batch_add(b, start, size, false);
+}
+
+// write back and drop, for buffers the device both reads and writes
+void dc_batch_flush_inval(dc_batch *b, void *start, u32 size)
+{
+    dc_batch_add(b, start, size, true);
+}
+
+// Does the queued cache maintenance, then one bus flush for all of it
+// before dev starts reading.
+void dc_batch_commit(dc_batch *b, enum rb_client dev)
+{
+    u32 cookie = irq_kill();
+
+    if(b->whole) {
+        if(b->any_inval)
+            _dc_flush_inval();
+        else
+            _dc_flush();
+    } else {
+        for(int i = 0; i < b->count; i++) {
+            int lines = (b->end[i] - b->start[i]) / LINESIZE;
+            if(b->inval[i])
+                _dc_flush_inval_entries((void*)b->start[i], lines);
+            else
+                _dc_flush_entries((void*)b->start[i], lines);
+        }
+    }
+    _drain_write_buffer();
+    ahb_flush_from(WB_AIM);
+    ahb_flush_to(dev);
+
+    irq_restore(cookie);
+    dc_batch_init(b);
+}
+
 void ic_invalidateall(void)
 {
     u32 cookie = irq_kill();
@@ -342,6 +420,32 @@ void map_section(u32 from, u32 to, u32 size, u32 attributes)
     }
 }
 
+// Remap [start, start + size) without the data cache. Both ends have to be
+// section (1MB) aligned. With write_combine the section stays bufferable, so
+// stores are merged in the write buffer.
+int mem_map_uncached(void *start, u32 size, bool write_combine)
+{
+    u32 addr = (u32)start;
+    if((addr | size) & 0xFFFFF || !size)
+        return -1;
+
+    u32 cookie = irq_kill();
+
+    map_section(addr >> 20, addr >> 20, size >> 20,
+                (write_combine ? BUFFERABLE : NONBUFFERABLE) | DOMAIN(0) | AP_RWUSER);
+    // writes back the window's dirty lines and the new table entries,
+    // the table walk doesn't look at the cache
+    _dc_flush();
+    _drain_write_buffer();
+    _tlb_inval();
+
+    uncached_start = addr;
+    uncached_end = addr + size;
+
+    irq_restore(cookie);
+    return 0;
+}
+
 //#define NO_CACHES
 //#define NO_HEAP
 
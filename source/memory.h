@@ -61,10 +61,28 @@ enum wb_client {
     WB_ALL = 22
 };
 
+#define DC_BATCH_RANGES (4)
+
+// Cache maintenance for several buffers ahead of one DMA operation. Past
+// DC_BATCH_RANGES ranges or a cache's worth of data the whole cache is done.
+typedef struct {
+    u32 start[DC_BATCH_RANGES];
+    u32 end[DC_BATCH_RANGES];
+    bool inval[DC_BATCH_RANGES];
+    int count;
+    u32 total;
+    bool whole;
+    bool any_inval;
+} dc_batch;
+
 void dc_flushrange(const void *start, u32 size);
 void dc_invalidaterange(void *start, u32 size);
 void dc_flushall(void);
 void ic_invalidateall(void);
+void dc_batch_init(dc_batch *b);
+void dc_batch_flush(dc_batch *b, const void *start, u32 size);
+void dc_batch_flush_inval(dc_batch *b, void *start, u32 size);
+void dc_batch_commit(dc_batch *b, enum rb_client dev);
 void ahb_flush_from(enum wb_client dev);
 void ahb_flush_to(enum rb_client dev);
 void mem_protect(int enable, void *start, void *end);
@@ -75,6 +93,7 @@ void mem_shutdown(void);
 
 u32 dma_addr(void *);
 u32 can_sdcard_dma_addr(void *p);
+int mem_map_uncached(void *start, u32 size, bool write_combine);
 
 static inline u32 get_cr(void)
 {
@@ -14,6 +14,7 @@
 #include "gfx.h"
 #include "console.h"
 #include "serial.h"
+#include "task.h"
 #include <stdio.h>
 
 #include "smc.h"
@@ -56,6 +57,7 @@ void menu_init(menu* new_menu)
     while(menu_active)
     {
         menu_show();
+        task_draw_overlay();
 
         int console_input = console_select_poll();
         int do_select = 0;
@@ -138,23 +140,30 @@ void menu_draw()
 void menu_show()
 {
     int i = 0, x = 0, y = 0;
+    bool redrawn = false;
     console_get_xy(&x, &y);
     if(!__menu->showed)
     {
         console_show();
         __menu->showed = 1;
-    }
-
-    // Update cursor.
-    for(i = 0; i < __menu->entries; i++) {
-        gfx_draw_string(GFX_DRC, i == __menu->selected ? ">" : " ", x + CHAR_WIDTH, (i+3+__menu->subtitles) * CHAR_WIDTH + y + CHAR_WIDTH * 2, GREEN);
-        gfx_draw_string(GFX_TV, i == __menu->selected ? ">" : " ", x + CHAR_WIDTH, (i+3+__menu->subtitles) * CHAR_WIDTH + y + CHAR_WIDTH * 2, GREEN);
+        redrawn = true;
     }
     if (/*gfx_is_currently_headless() && */!__menu->selected_showed) 
     {
         menu_draw();
         console_show();
         __menu->selected_showed = 1;
+        redrawn = true;
+    }
+
+    // Only the lines that changed got redrawn, nothing to do otherwise.
+    if(!redrawn)
+        return;
+
+    // Update cursor.
+    for(i = 0; i < __menu->entries; i++) {
+        gfx_draw_string(GFX_DRC, i == __menu->selected ? ">" : " ", x + CHAR_WIDTH, (i+3+__menu->subtitles) * CHAR_WIDTH + y + CHAR_WIDTH * 2, GREEN);
+        gfx_draw_string(GFX_TV, i == __menu->selected ? ">" : " ", x + CHAR_WIDTH, (i+3+__menu->subtitles) * CHAR_WIDTH + y + CHAR_WIDTH * 2, GREEN);
     }
 }
 
@@ -20,6 +20,7 @@
 #include <stdio.h> // For sprintf
 
 #include "latte.h"
+#include "timer.h"
 
 #ifdef CAN_HAZ_IRQ
 #include "irq.h"
@@ -28,6 +29,11 @@
 // #define MLC_DEBUG
 #define MLC_SUPPORT_WRITE
 
+// Was an unbounded SEND_STATUS loop. We don't read the erase timeout from
+// EXT_CSD, so allow a slow rate per MiB on top of a floor.
+#define MLC_ERASE_TIMEOUT_MIN_US    (30 * 1000 * 1000)
+#define MLC_ERASE_TIMEOUT_MIB_US    (1000 * 1000)
+
 #ifdef MLC_DEBUG
 static int mlcdebug = 3;
 #define DPRINTF(n,s)    do { if ((n) <= mlcdebug) printf s; } while (0)
@@ -74,7 +80,7 @@ static void _discover_emmc(void){
     u32 ocr = card.handle->ocr | SD_OCR_SDHC_CAP;
 
     for (int tries = 0; tries < 100; tries++) {
-        udelay(100000);
+        timer_sleep(100000);
 
         memset(&cmd, 0, sizeof(cmd));
         cmd.c_opcode = MMC_SEND_OP_COND;
@@ -363,7 +369,7 @@ void mlc_needs_discover(void)
     card.is_sd = true;
 
     for (int tries = 0; tries < 100; tries++) {
-        udelay(100000);
+        timer_sleep(100000);
 
         memset(&cmd, 0, sizeof(cmd));
         cmd.c_opcode = MMC_APP_CMD;
@@ -693,18 +699,21 @@ int mlc_end_read(struct sdmmc_command* cmdbuf)
 //  printf("%s(%u, %u, %p)\n", __FUNCTION__, blk_start, blk_count, data);
     if (card.inserted == 0) {
         printf("mlc: READ: no card inserted.\n");
+        task_unlock(&card.handle->lock);
         return -1;
     }
 
     if (card.selected == 0) {
         if (mlc_select() < 0) {
             printf("mlc: READ: cannot select card.\n");
+            task_unlock(&card.handle->lock);
             return -1;
         }
     }
 
     if (card.new_card == 1) {
         printf("mlc: new card inserted but not acknowledged yet.\n");
+        task_unlock(&card.handle->lock);
         return -1;
     }
 
@@ -839,18 +848,21 @@ int mlc_end_write(struct sdmmc_command* cmdbuf)
 #else
     if (card.inserted == 0) {
         printf("mlc: WRITE: no card inserted.\n");
+        task_unlock(&card.handle->lock);
         return -1;
     }
 
     if (card.selected == 0) {
         if (mlc_select() < 0) {
             printf("mlc: WRITE: cannot select card.\n");
+            task_unlock(&card.handle->lock);
             return -1;
         }
     }
 
     if (card.new_card == 1) {
         printf("mlc: new card inserted but not acknowledged yet.\n");
+        task_unlock(&card.handle->lock);
         return -1;
     }
 
@@ -973,6 +985,19 @@ void mlc_irq(void)
 }
 
 
+#ifdef MLC_SUPPORT_WRITE
+static bool _mlc_erase_done(void* arg){
+    struct sdmmc_command* cmd = arg;
+
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->c_opcode = MMC_SEND_STATUS;
+    cmd->c_arg = ((u32)card.rca)<<16;
+    cmd->c_flags = SCF_RSP_R1;
+    sdhc_exec_command(card.handle, cmd);
+    return !(cmd->c_error == 116 || MMC_R1(cmd->c_resp) == 0x800); //WHY?
+}
+#endif
+
 static int mlc_do_erase(u32 start, u32 end){
 #ifndef MLC_SUPPORT_WRITE
     return -1;
@@ -1009,14 +1034,15 @@ static int mlc_do_erase(u32 start, u32 end){
     if(MMC_R1(cmd.c_resp)&~0x900)
         printf("ERASE: resp=%x\n", MMC_R1(cmd.c_resp));
 
-    do {
-        //udelay(1);
-        memset(&cmd, 0, sizeof(cmd));
-        cmd.c_opcode = MMC_SEND_STATUS;
-        cmd.c_arg = ((u32)card.rca)<<16;
-        cmd.c_flags = SCF_RSP_R1;
-        sdhc_exec_command(card.handle, &cmd);
-    } while (cmd.c_error == 116 || MMC_R1(cmd.c_resp) == 0x800); //WHY?
+    u32 mib = ((end - start) >> 11) + 1;
+    u32 timeout = TIMER_MAX_US;
+    if (mib < (TIMER_MAX_US - MLC_ERASE_TIMEOUT_MIN_US) / MLC_ERASE_TIMEOUT_MIB_US)
+        timeout = MLC_ERASE_TIMEOUT_MIN_US + mib * MLC_ERASE_TIMEOUT_MIB_US;
+
+    if (timer_wait_until(_mlc_erase_done, &cmd, timeout, 1000)) {
+        printf("mlc: erase of %lx-%lx timed out\n", start, end);
+        return -1;
+    }
 
     if(cmd.c_error){
         printf("mlc: MMC_SEND_STATUS failed with 0x%d\n", cmd.c_error);
@@ -1053,8 +1079,9 @@ int mlc_erase(void){
     for(u32 base = 0; base<size; base+=erase_block_size){
         //if(!(base%40000))
             printf("Erase 0x%08lx/%08lx\n", base, size);
-        mlc_do_erase(base, min(size, base+erase_block_size)-1);
-
+        int res = mlc_do_erase(base, min(size, base+erase_block_size)-1);
+        if(res)
+            return res;
     }
  
     return 0;
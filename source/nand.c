@@ -21,6 +21,7 @@
 #include "irq.h"
 #include "gfx.h"
 #include "types.h"
+#include "task.h"
 
 //#define NAND_DEBUG  1
 #define NAND_SUPPORT_WRITE 1
@@ -64,6 +65,8 @@
 static u32 initialized = 0;
 static volatile int irq_flag;
 static u32 last_page_read = 0;
+// One controller and one set of bank/irq_flag state, so one op at a time.
+static task_lock_t nand_lock;
 #if defined(NAND_SUPPORT_ERASE) || defined(NAND_SUPPORT_WRITE)
 static u32 nand_min_page = 0x200; // default to protecting boot1+boot2
 static u8 nand_status_buf[STATUS_BUF_SIZE] ALIGNED(NAND_DATA_ALIGN);
@@ -85,7 +88,8 @@ void nand_irq(void)
 
 static void __nand_wait(void) {
     NAND_debug("waiting...\n");
-    while(read32(NAND_CTRL) & NAND_BUSY_MASK);
+    while(read32(NAND_CTRL) & NAND_BUSY_MASK)
+        task_yield();
     NAND_debug("wait done\n");
     if(read32(NAND_CTRL) & NAND_ERROR)
         printf("NAND: Error on wait\n");
@@ -209,6 +213,8 @@ void nand_wait(void) {
 
 // power-saving IRQ wait
     while(!irq_flag) {
+        if(task_yield())
+            continue;
         u32 cookie = irq_kill();
         if(!irq_flag)
             irq_wait();
@@ -216,7 +222,7 @@ void nand_wait(void) {
     }
 }
 
-int nand_read_page(u32 pageno, void *data, void *ecc) {
+static int _nand_read_page(u32 pageno, void *data, void *ecc) {
     irq_flag = 0;
     last_page_read = pageno;  // needed for error reporting
     __nand_set_address(0, pageno);
@@ -238,8 +244,15 @@ int nand_read_page(u32 pageno, void *data, void *ecc) {
     return 0;
 }
 
+int nand_read_page(u32 pageno, void *data, void *ecc) {
+    task_lock(&nand_lock);
+    int ret = _nand_read_page(pageno, data, ecc);
+    task_unlock(&nand_lock);
+    return ret;
+}
+
 #ifdef NAND_SUPPORT_WRITE
-int nand_write_page_raw(u32 pageno, void *data, void *ecc) {
+static int _nand_write_page_raw(u32 pageno, void *data, void *ecc) {
     irq_flag = 0;
     NAND_debug("nand_write_page_raw(%u, %p, %p)\n", pageno, data, ecc);
 
@@ -250,9 +263,11 @@ int nand_write_page_raw(u32 pageno, void *data, void *ecc) {
         return;
     }
 #endif
-    if (((s32)data) != -1) dc_flushrange(data, PAGE_SIZE + PAGE_SPARE_SIZE);
-    if (((s32)ecc) != -1)  dc_flushrange(ecc, PAGE_SPARE_SIZE);
-    ahb_flush_to(RB_FLA);
+    dc_batch b;
+    dc_batch_init(&b);
+    if (((s32)data) != -1) dc_batch_flush(&b, data, PAGE_SIZE + PAGE_SPARE_SIZE);
+    if (((s32)ecc) != -1)  dc_batch_flush(&b, ecc, PAGE_SPARE_SIZE);
+    dc_batch_commit(&b, RB_FLA);
     __nand_set_address(0, pageno);
     __nand_setup_dma(data, ecc);
     nand_send_command(NAND_WRITE_PRE, 0x1f, NAND_FLAGS_WR, 0x840);
@@ -265,7 +280,14 @@ int nand_write_page_raw(u32 pageno, void *data, void *ecc) {
     return 0;
 }
 
-int nand_write_page(u32 pageno, void *data, void *spare) {
+int nand_write_page_raw(u32 pageno, void *data, void *ecc) {
+    task_lock(&nand_lock);
+    int ret = _nand_write_page_raw(pageno, data, ecc);
+    task_unlock(&nand_lock);
+    return ret;
+}
+
+static int _nand_write_page(u32 pageno, void *data, void *spare) {
     irq_flag = 0;
     NAND_debug("nand_write_page(%u, %p, %p)\n", pageno, data, spare);
 
@@ -324,10 +346,17 @@ int nand_write_page(u32 pageno, void *data, void *spare) {
     return 0;
 }
 
+int nand_write_page(u32 pageno, void *data, void *spare) {
+    task_lock(&nand_lock);
+    int ret = _nand_write_page(pageno, data, spare);
+    task_unlock(&nand_lock);
+    return ret;
+}
+
 #endif
 
 #ifdef NAND_SUPPORT_ERASE
-int nand_erase_block(u32 pageno) {
+static int _nand_erase_block(u32 pageno) {
     irq_flag = 0;
     NAND_debug("nand_erase_block(%d)\n", pageno);
 
@@ -349,23 +378,30 @@ int nand_erase_block(u32 pageno) {
     NAND_debug("nand_erase_block(%d) done\n", pageno);
     return 0;
 }
+
+int nand_erase_block(u32 pageno) {
+    task_lock(&nand_lock);
+    int ret = _nand_erase_block(pageno);
+    task_unlock(&nand_lock);
+    return ret;
+}
 #endif
 
 void nand_initialize(u32 bank)
 {
-    if(initialized == bank) return;
+    task_lock(&nand_lock);
+    if(initialized != bank) {
+        irq_disable(IRQ_NAND);
+        nand_reset(bank);
+        irq_enable(IRQ_NAND);
 
-    irq_disable(IRQ_NAND);
-    nand_reset(bank);
-    irq_enable(IRQ_NAND);
-
-    initialized = bank;
+        initialized = bank;
+    }
+    task_unlock(&nand_lock);
 }
 
-int nand_correct(u32 pageno, void *data, void *ecc)
+static int _nand_correct(void *data, void *ecc, int *uncorrectable_out, int *corrected_out)
 {
-    (void) pageno;
-
     u8 *dp = (u8*)data;
     u32 *ecc_read = (u32*)((u8*)ecc+0x30);
     u32 *ecc_calc = (u32*)((u8*)ecc+0x40);
@@ -398,8 +434,8 @@ int nand_correct(u32 pageno, void *data, void *ecc)
         ecc_read++;
         ecc_calc++;
     }
-    if(uncorrectable || corrected)
-        printf("ECC stats for NAND page 0x%lX: %d uncorrectable, %d corrected\n", pageno, uncorrectable, corrected);
+    *uncorrectable_out = uncorrectable;
+    *corrected_out = corrected;
     if(uncorrectable)
         return NAND_ECC_UNCORRECTABLE;
     if(corrected)
@@ -407,6 +443,25 @@ int nand_correct(u32 pageno, void *data, void *ecc)
     return NAND_ECC_OK;
 }
 
+/* quiet version of nand_correct, also reports how many bits were fixed */
+int nand_correct_count(void *data, void *ecc, int *corrected_bits)
+{
+    int uncorrectable, corrected;
+    int res = _nand_correct(data, ecc, &uncorrectable, &corrected);
+    if(corrected_bits)
+        *corrected_bits = corrected;
+    return res;
+}
+
+int nand_correct(u32 pageno, void *data, void *ecc)
+{
+    int uncorrectable, corrected;
+    int res = _nand_correct(data, ecc, &uncorrectable, &corrected);
+    if(uncorrectable || corrected)
+        printf("ECC stats for NAND page 0x%lX: %d uncorrectable, %d corrected\n", pageno, uncorrectable, corrected);
+    return res;
+}
+
 static u8 _nand_parity(u8 x)
 {
     u8 y = 0;
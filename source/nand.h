@@ -55,6 +55,7 @@ void nand_wait(void);
 #define NAND_ECC_UNCORRECTABLE -1
 
 int nand_correct(u32 pageno, void *data, void *ecc);
+int nand_correct_count(void *data, void *ecc, int *corrected_bits);
 void nand_initialize(u32 bank);
 void nand_create_ecc(void* in_data, void* spare_out);
 
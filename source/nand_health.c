@@ -0,0 +1,265 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#include "nand_health.h"
+
+#include "types.h"
+#include "utils.h"
+#include "nand.h"
+#include "crypto.h"
+#include "ff.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NAND_HEALTH_VERSION 2
+// map entries read or written at once
+#define HEALTH_ENTRIES      64
+
+#ifndef MINUTE_BOOT1
+
+// SLC and SLCCMPT
+static nand_health_entry health_map[2][NAND_BLOCK_COUNT];
+static bool health_loaded[2];
+
+static int _nand_health_index(u32 bank)
+{
+    switch(bank) {
+        case NAND_BANK_SLC: return 0;
+        case NAND_BANK_SLCCMPT: return 1;
+        default: return -1;
+    }
+}
+
+static nand_health_entry* _nand_health_entry(u32 bank, u32 block)
+{
+    int i = _nand_health_index(bank);
+    if(i < 0 || block >= NAND_BLOCK_COUNT)
+        return NULL;
+    return &health_map[i][block];
+}
+
+static const char* _nand_health_path(u32 bank)
+{
+    return (bank == NAND_BANK_SLC) ? "sdmc:/nand_health_slc.bin" : "sdmc:/nand_health_slccmpt.bin";
+}
+
+int nand_health_get(u32 bank, u32 block)
+{
+    nand_health_entry* entry = _nand_health_entry(bank, block);
+    return entry ? entry->state : NAND_HEALTH_UNKNOWN;
+}
+
+void nand_health_set(u32 bank, u32 block, int state)
+{
+    nand_health_entry* entry = _nand_health_entry(bank, block);
+    if(entry)
+        entry->state = state;
+}
+
+/* worst state of the blocks holding a page range */
+int nand_health_get_range(u32 bank, u32 page, u32 pages)
+{
+    int worst = NAND_HEALTH_UNKNOWN;
+    for(u32 b = page / BLOCK_PAGES; b < (page + pages + BLOCK_PAGES - 1) / BLOCK_PAGES; b++)
+        worst = max(worst, nand_health_get(bank, b));
+    return worst;
+}
+
+bool nand_health_loaded(u32 bank)
+{
+    int i = _nand_health_index(bank);
+    return i >= 0 && health_loaded[i];
+}
+
+int nand_health_load(u32 bank)
+{
+    int i = _nand_health_index(bank);
+    if(i < 0) return -1;
+
+    memset(health_map[i], 0, sizeof(health_map[i]));
+    health_loaded[i] = false;
+
+    FIL file = {0};
+    UINT btx = 0;
+    if(f_open(&file, _nand_health_path(bank), FA_READ) != FR_OK)
+        return -2;
+
+    nand_health_hdr hdr;
+    if(f_read(&file, &hdr, sizeof(hdr), &btx) != FR_OK || btx != sizeof(hdr) ||
+       memcmp(hdr.magic, "NHMP", 4) || hdr.version != NAND_HEALTH_VERSION ||
+       hdr.bank != bank || hdr.blocks != NAND_BLOCK_COUNT) {
+        f_close(&file);
+        printf("NAND health map for bank %lu is invalid\n", bank);
+        return -3;
+    }
+
+    // a map from another console describes another NAND
+    if(hdr.ng_id != otp.wii_ng_id) {
+        f_close(&file);
+        printf("NAND health map for bank %lu is from another console (%08lX), ignoring it\n", bank, hdr.ng_id);
+        return -5;
+    }
+
+    if(f_read(&file, health_map[i], sizeof(health_map[i]), &btx) != FR_OK || btx != sizeof(health_map[i])) {
+        f_close(&file);
+        memset(health_map[i], 0, sizeof(health_map[i]));
+        return -4;
+    }
+    f_close(&file);
+    health_loaded[i] = true;
+
+    u32 weak = 0, unreadable = 0, bad = 0;
+    for(u32 b = 0; b < NAND_BLOCK_COUNT; b++) {
+        weak += health_map[i][b].state == NAND_HEALTH_WEAK;
+        unreadable += health_map[i][b].state == NAND_HEALTH_UNREADABLE;
+        bad += health_map[i][b].state == NAND_HEALTH_BAD;
+    }
+
+    printf("NAND health map for bank %lu: %lu weak, %lu unreadable, %lu bad blocks\n", bank, weak, unreadable, bad);
+    return 0;
+}
+
+int nand_health_save(u32 bank)
+{
+    int i = _nand_health_index(bank);
+    if(i < 0) return -1;
+
+    FIL file = {0};
+    UINT btx = 0;
+    const char* path = _nand_health_path(bank);
+    if(f_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+        printf("Failed to create %s\n", path);
+        return -2;
+    }
+
+    nand_health_hdr hdr = {
+        .magic = "NHMP", .version = NAND_HEALTH_VERSION, .bank = bank,
+        .blocks = NAND_BLOCK_COUNT, .ng_id = otp.wii_ng_id,
+    };
+    if(f_write(&file, &hdr, sizeof(hdr), &btx) != FR_OK || btx != sizeof(hdr)) {
+        f_close(&file);
+        return -3;
+    }
+
+    int res = 0;
+    for(u32 b = 0; b < NAND_BLOCK_COUNT; b += HEALTH_ENTRIES) {
+        if(f_write(&file, &health_map[i][b], HEALTH_ENTRIES * sizeof(nand_health_entry), &btx) != FR_OK ||
+           btx != HEALTH_ENTRIES * sizeof(nand_health_entry)) {
+            printf("Failed to write %s\n", path);
+            res = -4;
+            break;
+        }
+    }
+
+    if(f_close(&file) != FR_OK && !res)
+        res = -5;
+    if(!res)
+        health_loaded[i] = true;
+    return res;
+}
+
+int nand_health_check_block(u32 bank, u32 block)
+{
+    static u8 page_buf[PAGE_SIZE] ALIGNED(NAND_DATA_ALIGN);
+    static u8 ecc_buf[ECC_BUFFER_ALLOC] ALIGNED(NAND_DATA_ALIGN);
+
+    nand_health_entry* entry = _nand_health_entry(bank, block);
+    if(!entry)
+        return NAND_HEALTH_UNKNOWN;
+
+    nand_health_entry e = { .state = NAND_HEALTH_GOOD };
+    for(u32 p = 0; p < BLOCK_PAGES; p++) {
+        u32 page = block * BLOCK_PAGES + p;
+        int bits = 0;
+
+        memset(ecc_buf, 0, ECC_BUFFER_ALLOC);
+        if(nand_read_page(page, page_buf, ecc_buf) < 0) {
+            e.state = NAND_HEALTH_UNREADABLE;
+            break;
+        }
+        // factory bad blocks are marked in the first spare byte of their first pages
+        if(p < 2 && ecc_buf[0] != 0xFF) {
+            e.state = NAND_HEALTH_BAD;
+            break;
+        }
+        if(nand_correct_count(page_buf, ecc_buf, &bits) == NAND_ECC_UNCORRECTABLE) {
+            e.state = NAND_HEALTH_UNREADABLE;
+            break;
+        }
+        if(bits) {
+            e.corrected_pages++;
+            e.max_bits = max(e.max_bits, bits);
+        }
+    }
+
+    if(e.state == NAND_HEALTH_GOOD &&
+       (e.max_bits >= NAND_HEALTH_WEAK_BITS || e.corrected_pages >= NAND_HEALTH_WEAK_PAGES))
+        e.state = NAND_HEALTH_WEAK;
+
+    // a failed erase or program doesn't show up when reading, keep it
+    if(entry->state != NAND_HEALTH_BAD)
+        *entry = e;
+    return entry->state;
+}
+
+/* read every page once, nothing is written to the nand */
+int nand_health_scan(u32 bank)
+{
+    int i = _nand_health_index(bank);
+    if(i < 0) return -1;
+
+    // only trust earlier erase and program failures if they were for this nand
+    if(!health_loaded[i])
+        memset(health_map[i], 0, sizeof(health_map[i]));
+
+    nand_initialize(bank);
+
+    u32 weak = 0, unreadable = 0, bad = 0;
+    for(u32 b = 0; b < NAND_BLOCK_COUNT; b++) {
+        nand_health_entry* entry = &health_map[i][b];
+
+        switch(nand_health_check_block(bank, b)) {
+            case NAND_HEALTH_WEAK:
+                printf("Block 0x%03lX is weak (%u pages corrected, up to %u bits)\n", b, entry->corrected_pages, entry->max_bits);
+                weak++;
+                break;
+            case NAND_HEALTH_UNREADABLE:
+                printf("Block 0x%03lX is unreadable\n", b);
+                unreadable++;
+                break;
+            case NAND_HEALTH_BAD:
+                printf("Block 0x%03lX is bad\n", b);
+                bad++;
+                break;
+        }
+
+        if((b % 0x100) == 0)
+            printf("Block 0x%03lX / 0x%03X scanned\n", b, NAND_BLOCK_COUNT);
+    }
+
+    printf("%lu weak, %lu unreadable, %lu bad blocks\n", weak, unreadable, bad);
+    return nand_health_save(bank);
+}
+
+#else
+
+int nand_health_get(u32 bank, u32 block)
+{
+    return NAND_HEALTH_UNKNOWN;
+}
+
+int nand_health_get_range(u32 bank, u32 page, u32 pages)
+{
+    return NAND_HEALTH_UNKNOWN;
+}
+
+void nand_health_set(u32 bank, u32 block, int state)
+{
+}
+
+#endif // MINUTE_BOOT1
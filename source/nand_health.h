@@ -0,0 +1,54 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#ifndef _NAND_HEALTH_H
+#define _NAND_HEALTH_H
+
+#include "types.h"
+#include "nand.h"
+
+#define NAND_BLOCK_COUNT        (PAGE_COUNT / BLOCK_PAGES)
+
+#define NAND_HEALTH_UNKNOWN     0 // not scanned, or no map loaded
+#define NAND_HEALTH_GOOD        1
+#define NAND_HEALTH_WEAK        2 // readable, but needed more ECC than it should
+#define NAND_HEALTH_UNREADABLE  3 // contents lost, rewriting the block may fix it
+#define NAND_HEALTH_BAD         4 // factory bad, or an erase or program failed
+
+// a page is weak once this many of its sectors needed a correction
+#define NAND_HEALTH_WEAK_BITS   2
+// or a block once this many of its pages needed one
+#define NAND_HEALTH_WEAK_PAGES  4
+
+typedef struct {
+    char magic[4];
+    u32 version;
+    u32 bank;
+    u32 blocks;
+    u32 ng_id;          // console the map belongs to, from the OTP
+} PACKED nand_health_hdr;
+
+typedef struct {
+    u8 state;
+    u8 max_bits;        // most bits corrected in a single page
+    u8 corrected_pages;
+    u8 pad;
+} PACKED nand_health_entry;
+
+int nand_health_scan(u32 bank);
+int nand_health_load(u32 bank);
+int nand_health_save(u32 bank);
+bool nand_health_loaded(u32 bank);
+
+// re-reads a block to update its entry, the bank has to be initialized
+int nand_health_check_block(u32 bank, u32 block);
+
+int nand_health_get(u32 bank, u32 block);
+int nand_health_get_range(u32 bank, u32 page, u32 pages);
+void nand_health_set(u32 bank, u32 block, int state);
+
+#endif
@@ -14,6 +14,7 @@
 #include "latte.h"
 #include "gpu.h"
 #include "crypto.h"
+#include <stdio.h>
 #include <string.h>
 
 // div_select = ?
@@ -78,6 +79,36 @@ bsp_pll_cfg spll_cfg_customclock = {0,1,    1,    1,   0,     0,     0,
 bsp_pll_cfg spll_cfg_underclock  = {0,1,    1,    1,   0,     0,     0,          0,   0xA,   0x2F68, 0x4,     0x4,     0,       0x1C2, 0,      0x7,    0x4,  0x0};
 bsp_pll_cfg spll_cfg_overclock   = {0,1,    1,    1,   0,     0,     0,          0,   0x32,   0x2F68, 0x4,     0x4,     0,       0x1C2, 0,      0x7,    0x4,  0x0};
 
+// PLL_SKIP_* for every bring-up that found the hardware already programmed.
+u32 pll_skipped = 0;
+
+// Ignores operational/options, which the tables don't carry, but requires
+// the read back PLL to be running.
+int pll_cfg_matches(const bsp_pll_cfg *pWant, const bsp_pll_cfg *pHave)
+{
+    bsp_pll_cfg cfg;
+
+    if (!pHave->operational)
+        return 0;
+
+    memcpy(&cfg, pWant, sizeof(cfg));
+    cfg.operational = pHave->operational;
+    cfg.options = pHave->options;
+    return !memcmp(&cfg, pHave, sizeof(cfg));
+}
+
+void pll_print_skipped(void)
+{
+    static const char* names[] = { "syspll", "spll", "upll", "dram", "ddr_seq", "usb" };
+
+    printf("pll: already programmed:");
+    for (u32 i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        if (pll_skipped & (1 << i))
+            printf(" %s", names[i]);
+    }
+    printf("%s\n", pll_skipped ? "" : " none");
+}
+
 u64 pll_calc_frequency(bsp_pll_cfg* pCfg)
 {
     u64 clkF = (pCfg->clkFMsb << 16 | ((pCfg->clkFLsb & 0x7FFF) << 1));
@@ -257,6 +288,7 @@ int pll_upll_write(bsp_pll_cfg *pCfg)
     abif_cpl_ct_write32(0x884u, pCfg->clkS | (pCfg->bwAdj << 12));
     udelay(5);
     abif_cpl_ct_write32(0x878u, pCfg->clkR | (pCfg->clkFMsb << 6) | 0x18000000 | (pCfg->clkO0Div << 18));
+    // No lock flag is known for the CT PLLs, so wait the full IOS settle time.
     udelay(200);
     v6 = pCfg->bypVco ? 0x8000000 : 0;
     v7 = pCfg->bypOut ? 0x10000000 : 0;
@@ -302,6 +334,7 @@ int pll_upll_read(bsp_pll_cfg *pOut)
     pOut->ssEn = !!(v11 & 0x4000000u);
     pOut->dithEn = !!(v11 & 0x8000000);
     v15 = abif_cpl_ct_read32(0x884u);
+    pOut->clkS = v15 & 0xFFF;
     pOut->bwAdj = (v15 & 0xFFF000u) >> 12;
     pOut->clkO2Div = abif_cpl_tr_read16(0) & 0x1FF;
     v17 = abif_cpl_ct_read32(0x878u);
@@ -353,6 +386,9 @@ void pll_upll_init()
     if (memcmp(&upll_cfg, &cfg, sizeof(bsp_pll_cfg))) {
         pll_upll_write(&upll_cfg);
     }
+    else {
+        pll_skipped |= PLL_SKIP_UPLL;
+    }
 }
 
 int pll_syspll_read(bsp_pll_cfg **ppCfg, u32 *pSysClkFreq)
@@ -394,6 +430,43 @@ int pll_syspll_read(bsp_pll_cfg **ppCfg, u32 *pSysClkFreq)
     return result;
 }
 
+int pll_syspll_read_hw(bsp_pll_cfg *pOut)
+{
+    u16 v;
+
+    memset(pOut, 0, sizeof(bsp_pll_cfg));
+    if (!latte_get_hw_version())
+        return -1;
+
+    v = abif_cpl_tl_read16(0x20u);
+    pOut->clkR = v & 0x3F;
+    pOut->clkO0Div = (v >> 6) & 0x3FF;
+    v = abif_cpl_tl_read16(0x22u);
+    pOut->clkFMsb = v & 0xFFF;
+    pOut->bypVco = !!(v & 0x1000);
+    pOut->bypOut = !!(v & 0x2000);
+    v = abif_cpl_tl_read16(0x24u);
+    pOut->clkO1Div = v & 0x7FF;
+    pOut->satEn = !!(v & 0x800);
+    pOut->fastEn = !!(v & 0x1000);
+    pOut->clkFLsb = abif_cpl_tl_read16(0x26u);
+    pOut->clkVLsb = abif_cpl_tl_read16(0x28u);
+    v = abif_cpl_tl_read16(0x2Au);
+    pOut->clkVMsb = v & 0x7FF;
+    pOut->ssEn = !!(v & 0x800);
+    pOut->dithEn = !!(v & 0x1000);
+    pOut->clkS = abif_cpl_tl_read16(0x2Cu);
+    pOut->bwAdj = abif_cpl_tl_read16(0x2Eu);
+    pOut->options = read32(LT_SYSPLL_CFG) & 1;
+
+    if ((read32(LT_RESETS_COMPAT) & (RSTB_SYSPLL | NLCKB_SYSPLL | RSTB_DSKPLL)) == (RSTB_SYSPLL | NLCKB_SYSPLL | RSTB_DSKPLL)
+        && !(read32(LT_CLOCKINFO) & 3))
+    {
+        pOut->operational = 1;
+    }
+    return 0;
+}
+
 int pll_syspll_write(bsp_pll_cfg *pParams)
 {
     int v1; // lr
@@ -414,6 +487,15 @@ int pll_syspll_write(bsp_pll_cfg *pParams)
     bspVer = latte_get_hw_version();
     if ( bspVer && (bspVer & 0xF000000) != 0 )
     {
+        // The options bit is only ever set, so it can't be what differs.
+        bsp_pll_cfg cur;
+        if (!pll_syspll_read_hw(&cur) && pll_cfg_matches(pParams, &cur)
+            && (cur.options & 1) >= (pParams->options & 1))
+        {
+            pll_skipped |= PLL_SKIP_SYSPLL;
+            return v13;
+        }
+
         set32(LT_CLOCKINFO, 1);
         udelay(10);
         clear32(LT_RESETS_COMPAT, RSTB_DSKPLL);
@@ -487,8 +569,43 @@ int pll_syspll_init(int bIdk)
     return result;
 }
 
+int pll_spll_read(bsp_pll_cfg *pOut)
+{
+    u32 v;
+
+    memset(pOut, 0, sizeof(bsp_pll_cfg));
+
+    v = abif_cpl_ct_read32(0x864u);
+    pOut->clkR = v & 0x3F;
+    pOut->bypVco = !!(v & 0x8000000u);
+    pOut->bypOut = !!(v & 0x10000000u);
+    pOut->clkFMsb = (v >> 6) & 0x3FFF;
+    pOut->clkO0Div = (v >> 18) & 0x1FF;
+    v = abif_cpl_ct_read32(0x868u);
+    pOut->clkFLsb = (v >> 9) & 0x3FFF;
+    pOut->clkO1Div = v & 0x1FF;
+    pOut->satEn = !!(v & 0x8000000);
+    pOut->fastEn = !!(v & 0x10000000);
+    v = abif_cpl_ct_read32(0x86Cu);
+    pOut->clkVMsb = (v >> 16) & 0x3FFF;
+    pOut->clkVLsb = v & 0xFFFF;
+    pOut->ssEn = !!(v & 0x4000000u);
+    pOut->dithEn = !!(v & 0x8000000);
+    v = abif_cpl_ct_read32(0x870u);
+    pOut->clkS = v & 0xFFF;
+    pOut->bwAdj = (v & 0xFFF000u) >> 12;
+
+    // There's no known lock or status flag, the bypass bits above are plain
+    // config. 0x874 is 2 only once pll_spll_write got all the way through.
+    if ((abif_cpl_ct_read32(0x874u) & 7) == 2)
+        pOut->operational = 1;
+    return 0;
+}
+
 int pll_spll_write(bsp_pll_cfg *pPllCfg)
 {
+    bsp_pll_cfg cur;
+
     int v3; // r1
     int v4; // r2
     int v5; // r1
@@ -497,6 +614,12 @@ int pll_spll_write(bsp_pll_cfg *pPllCfg)
     int v8; // r0
 
     gpu_idk_upll();
+    pll_spll_read(&cur);
+    if (pll_cfg_matches(pPllCfg, &cur)) {
+        pll_skipped |= PLL_SKIP_SPLL;
+        goto done;
+    }
+
     abif_cpl_ct_write32(0x874u, 1);
     abif_cpl_ct_write32(0x864u, (pPllCfg->clkO0Div << 18) | pPllCfg->clkR | (pPllCfg->clkFMsb << 6) | 0x18000000);
     udelay(5);
@@ -528,6 +651,7 @@ int pll_spll_write(bsp_pll_cfg *pPllCfg)
     abif_cpl_ct_write32(0x870u, (pPllCfg->clkS) | (pPllCfg->bwAdj << 12));
     udelay(5);
     abif_cpl_ct_write32(0x864u, (pPllCfg->clkO0Div << 18) | (pPllCfg->clkR) | (pPllCfg->clkFMsb << 6) | 0x18000000);
+    // No lock flag is known for the CT PLLs, so wait the full IOS settle time.
     udelay(200);
     if ( pPllCfg->bypVco )
         v7 = 0x8000000;
@@ -539,6 +663,7 @@ int pll_spll_write(bsp_pll_cfg *pPllCfg)
         v8 = 0;
     abif_cpl_ct_write32(0x864u, v7 | (pPllCfg->clkFMsb << 6) | (pPllCfg->clkR) | (pPllCfg->clkO0Div << 18) | v8);
     abif_cpl_ct_write32(0x874u, 2);
+done:
     abif_cpl_ct_write32(0x7D4u, ~0x360000u);
     abif_gpu_write32(0xF4B0u, 1);
     abif_gpu_write32(0xF4A8u, 0x3FFFF);
@@ -602,6 +727,13 @@ int pll_dram_write(bsp_pll_cfg *pCfg)
     u16 v13; // r2
     u16 v14; // r1
     u16 v15; // r2
+    bsp_pll_cfg cur;
+
+    pll_dram_read(&cur);
+    if (pll_cfg_matches(pCfg, &cur)) {
+        pll_skipped |= PLL_SKIP_DRAM;
+        return 0;
+    }
 
     v2 = pCfg->satEn ? 0x800 : 0;
     v3 = pCfg->fastEn ? 0x1000 : 0;
@@ -34,6 +34,18 @@ typedef struct bsp_pll_cfg
     u32 options;
 } bsp_pll_cfg;
 
+#define PLL_SKIP_SYSPLL     (1 << 0)
+#define PLL_SKIP_SPLL       (1 << 1)
+#define PLL_SKIP_UPLL       (1 << 2)
+#define PLL_SKIP_DRAM       (1 << 3)
+#define PLL_SKIP_DDR_SEQ    (1 << 4)
+#define PLL_SKIP_USB        (1 << 5)
+
+extern u32 pll_skipped;
+
+int pll_cfg_matches(const bsp_pll_cfg *pWant, const bsp_pll_cfg *pHave);
+void pll_print_skipped(void);
+
 u64 pll_calc_frequency(bsp_pll_cfg* pCfg);
 
 int pll_vi1_shutdown();
@@ -47,9 +59,11 @@ int pll_upll_read(bsp_pll_cfg *pOut);
 void pll_upll_init();
 
 int pll_syspll_read(bsp_pll_cfg **ppCfg, u32 *pSysClkFreq);
+int pll_syspll_read_hw(bsp_pll_cfg *pOut);
 int pll_syspll_write(bsp_pll_cfg *pParams);
 int pll_syspll_init(int bIdk);
 
+int pll_spll_read(bsp_pll_cfg *pOut);
 int pll_spll_write(bsp_pll_cfg *pPllCfg);
 
 int pll_dram_read(bsp_pll_cfg *pOut);
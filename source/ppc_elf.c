@@ -72,111 +72,166 @@ static int _check_physrange(u32 addr, u32 len) {
 static Elf32_Ehdr elfhdr;
 static Elf32_Phdr phdrs[PHDR_MAX];
 
-int ppc_load_file(const char *path, u32* entry)
+static int _check_ehdr(const Elf32_Ehdr *ehdr)
 {
-    int res = 0, read = 0;
-
-    FILE* file = fopen(path, "rb");
-    if(!file) return -errno;
-
-    read = fread(&elfhdr, sizeof(elfhdr), 1, file);
-    if(read != 1)
-        return -100;
-
-    if (memcmp("\x7F" "ELF\x01\x02\x01\x00\x00", elfhdr.e_ident, 9)) {
+    if (memcmp("\x7F" "ELF\x01\x02\x01\x00\x00", ehdr->e_ident, 9)) {
         printf("ELF: invalid ELF header! 0x%02x 0x%02x 0x%02x 0x%02x\n",
-                elfhdr.e_ident[0], elfhdr.e_ident[1],
-                        elfhdr.e_ident[2], elfhdr.e_ident[3]);
+                ehdr->e_ident[0], ehdr->e_ident[1],
+                        ehdr->e_ident[2], ehdr->e_ident[3]);
         return -101;
     }
 
-    if (_check_physaddr(elfhdr.e_entry) < 0) {
-        printf("ELF: invalid entry point! 0x%08lX\n", elfhdr.e_entry);
+    if (_check_physaddr(ehdr->e_entry) < 0) {
+        printf("ELF: invalid entry point! 0x%08lX\n", ehdr->e_entry);
         return -102;
     }
 
-    if (elfhdr.e_phoff == 0 || elfhdr.e_phnum == 0) {
+    if (ehdr->e_phoff == 0 || ehdr->e_phnum == 0) {
         printf("ELF: no program headers!\n");
         return -103;
     }
 
-    if (elfhdr.e_phnum > PHDR_MAX) {
-        printf("ELF: too many (%d) program headers!\n", elfhdr.e_phnum);
+    if (ehdr->e_phnum > PHDR_MAX) {
+        printf("ELF: too many (%d) program headers!\n", ehdr->e_phnum);
         return -104;
     }
 
+    return 0;
+}
+
+/*
+ * Validates all PT_LOAD segments up front and returns them sorted by file
+ * offset, so the loaders can walk the image front to back.
+ */
+static int _sort_loads(const Elf32_Phdr *phdr, u16 count, const Elf32_Phdr **loads)
+{
+    int num = 0;
+
+    for (u16 i = 0; i < count; i++, phdr++) {
+        if (phdr->p_type != PT_LOAD) {
+            printf("ELF: skipping PHDR of type %ld\n", phdr->p_type);
+            continue;
+        }
+
+        if (_check_physrange(phdr->p_paddr, phdr->p_memsz) < 0) {
+            printf("ELF: PHDR out of bounds [0x%08lX...0x%08lX]\n",
+                            phdr->p_paddr, phdr->p_paddr + phdr->p_memsz);
+            return -106;
+        }
+
+        if (phdr->p_filesz > phdr->p_memsz) {
+            printf("ELF: PHDR filesz 0x%lX > memsz 0x%lX\n", phdr->p_filesz, phdr->p_memsz);
+            return -107;
+        }
+
+        int j = num++;
+        while (j > 0 && loads[j - 1]->p_offset > phdr->p_offset) {
+            loads[j] = loads[j - 1];
+            j--;
+        }
+        loads[j] = phdr;
+    }
+
+    return num;
+}
+
+// Clears BSS and pushes everything the CPU wrote out to memory for the PPC.
+static void _finish_segment(const Elf32_Phdr *phdr, u8 *dst)
+{
+    if (phdr->p_memsz > phdr->p_filesz)
+        memset(dst + phdr->p_filesz, 0, phdr->p_memsz - phdr->p_filesz);
+
+    if (phdr->p_memsz)
+        dc_flushrange(dst, phdr->p_memsz);
+}
+
+int ppc_load_file(const char *path, u32* entry)
+{
+    int res = 0, read = 0;
+    const Elf32_Phdr *loads[PHDR_MAX];
+
+    FILE* file = fopen(path, "rb");
+    if(!file) return -errno;
+
+    // Segments are read straight into place (and DMA'd there when the
+    // destination allows it), going through the stdio buffer only costs
+    // an extra copy.
+    setvbuf(file, NULL, _IONBF, 0);
+
+    read = fread(&elfhdr, sizeof(elfhdr), 1, file);
+    if(read != 1) {
+        res = -100;
+        goto done;
+    }
+
+    res = _check_ehdr(&elfhdr);
+    if (res) goto done;
+
     res = fseek(file, elfhdr.e_phoff, SEEK_SET);
-    if (res) return -res;
+    if (res) {
+        res = -res;
+        goto done;
+    }
 
     read = fread(phdrs, sizeof(phdrs[0]), elfhdr.e_phnum, file);
-    if(read != elfhdr.e_phnum)
-        return -errno;
+    if(read != elfhdr.e_phnum) {
+        res = -errno;
+        goto done;
+    }
 
-    Elf32_Phdr *phdr = phdrs;
-    u16 count = read;
+    int num = _sort_loads(phdrs, read, loads);
+    if (num < 0) {
+        res = num;
+        goto done;
+    }
 
     ppc_prepare();
 
-    while (count--) {
-        if (phdr->p_type != PT_LOAD) {
-            printf("ELF: skipping PHDR of type %ld\n", phdr->p_type);
-        } else {
-            if (_check_physrange(phdr->p_paddr, phdr->p_memsz) < 0) {
-                printf("ELF: PHDR out of bounds [0x%08lX...0x%08lX]\n",
-                                phdr->p_paddr, phdr->p_paddr + phdr->p_memsz);
-                return -106;
-            }
+    u32 pos = elfhdr.e_phoff + read * sizeof(phdrs[0]);
+    for (int i = 0; i < num; i++) {
+        const Elf32_Phdr *phdr = loads[i];
+        u8 *dst = (u8 *) _translate_physaddr(phdr->p_paddr);
 
-            void *dst = (void *) _translate_physaddr(phdr->p_paddr);
-
-            printf("ELF: LOAD 0x%lX @0x%08lX [0x%lX]\n", phdr->p_offset, phdr->p_paddr, phdr->p_filesz);
-            if(phdr->p_filesz != 0) {
+        printf("ELF: LOAD 0x%lX @0x%08lX [0x%lX/0x%lX]\n", phdr->p_offset, phdr->p_paddr, phdr->p_filesz, phdr->p_memsz);
+        if(phdr->p_filesz != 0) {
+            if (pos != phdr->p_offset) {
                 res = fseek(file, phdr->p_offset, SEEK_SET);
-                if (res) return -res;
-                count = fread(dst, phdr->p_filesz, 1, file);
-                if(count != 1) return -errno;
+                if (res) {
+                    res = -res;
+                    goto done;
+                }
+            }
+            if(fread(dst, phdr->p_filesz, 1, file) != 1) {
+                res = -errno;
+                goto done;
             }
+            pos = phdr->p_offset + phdr->p_filesz;
         }
-        phdr++;
-    }
 
-    dc_flushall();
+        _finish_segment(phdr, dst);
+    }
 
     printf("ELF: load done.\n");
     *entry = elfhdr.e_entry;
+    res = 0;
 
-    return 0;
+done:
+    fclose(file);
+    return res;
 }
 
 int ppc_load_mem(const u8 *addr, u32 len, u32* entry)
 {
+    int res = 0;
+    const Elf32_Phdr *loads[PHDR_MAX];
+
     if (len < sizeof(Elf32_Ehdr))
         return -100;
 
     Elf32_Ehdr *ehdr = (Elf32_Ehdr *) addr;
 
-    if (memcmp("\x7F" "ELF\x01\x02\x01\x00\x00", ehdr->e_ident, 9)) {
-        printf("ELF: invalid ELF header! 0x%02x 0x%02x 0x%02x 0x%02x\n",
-                        ehdr->e_ident[0], ehdr->e_ident[1],
-                        ehdr->e_ident[2], ehdr->e_ident[3]);
-        return -101;
-    }
-
-    if (_check_physaddr(ehdr->e_entry) < 0) {
-        printf("ELF: invalid entry point! 0x%08lX\n", ehdr->e_entry);
-        return -102;
-    }
-
-    if (ehdr->e_phoff == 0 || ehdr->e_phnum == 0) {
-        printf("ELF: no program headers!\n");
-        return -103;
-    }
-
-    if (ehdr->e_phnum > PHDR_MAX) {
-        printf("ELF: too many (%d) program headers!\n",
-                        ehdr->e_phnum);
-        return -104;
-    }
+    res = _check_ehdr(ehdr);
+    if (res) return res;
 
     u16 count = ehdr->e_phnum;
     if (len < ehdr->e_phoff + count * sizeof(Elf32_Phdr))
@@ -187,28 +242,26 @@ int ppc_load_mem(const u8 *addr, u32 len, u32* entry)
     // TODO: add more checks here
     // - loaded ELF overwrites itself?
 
+    int num = _sort_loads(phdr, count, loads);
+    if (num < 0) return num;
+
+    for (int i = 0; i < num; i++) {
+        if (loads[i]->p_offset + loads[i]->p_filesz > len)
+            return -105;
+    }
+
     ppc_prepare();
 
-    while (count--) {
-        if (phdr->p_type != PT_LOAD) {
-            printf("ELF: skipping PHDR of type %ld\n", phdr->p_type);
-        } else {
-            if (_check_physrange(phdr->p_paddr, phdr->p_memsz) < 0) {
-                printf("ELF: PHDR out of bounds [0x%08lX...0x%08lX]\n",
-                                phdr->p_paddr, phdr->p_paddr + phdr->p_memsz);
-                return -106;
-            }
+    for (int i = 0; i < num; i++) {
+        phdr = (Elf32_Phdr *) loads[i];
+        u8 *dst = (u8 *) _translate_physaddr(phdr->p_paddr);
 
-            printf("ELF: LOAD 0x%lX @0x%08lX [0x%lX]\n", phdr->p_offset, phdr->p_paddr, phdr->p_filesz);
+        printf("ELF: LOAD 0x%lX @0x%08lX [0x%lX/0x%lX]\n", phdr->p_offset, phdr->p_paddr, phdr->p_filesz, phdr->p_memsz);
+        memcpy(dst, &addr[phdr->p_offset], phdr->p_filesz);
 
-            void *dst = (void *) _translate_physaddr(phdr->p_paddr);
-            memcpy(dst, &addr[phdr->p_offset], phdr->p_filesz);
-        }
-        phdr++;
+        _finish_segment(phdr, dst);
     }
 
-    dc_flushall();
-
     printf("ELF: load done.\n");
     *entry = ehdr->e_entry;
 
@@ -5,6 +5,7 @@
 #include "sdcard.h"
 #include "crypto.h"
 #include "isfs.h"
+#include "dma_pool.h"
 
 #include "ff.h"
 #include "ini.h"
@@ -37,6 +38,8 @@ static struct {
     bool disable_scfm;
     bool allow_sys_scfm;
     bool scfm_on_slccmpt;
+    bool slc_nocrypto;
+    bool slccmpt_nocrypto;
     bool mlc_nocrypto;
     bool sys_mount_mlc;
 } rednand_ini = { 0 };
@@ -89,16 +92,14 @@ static int rednand_ini_handler(void* user, const char* section, const char* name
     }
 
     if(!strcmp("disable_encryption", section)){
-        // if(!strcmp("slc", name)){
-        //     rednand_ini.slc = bool_val;
-        //     rednand_ini.slc_set = true;
-        //     return 1;
-        // }
-        // if(!strcmp("slccmpt", name)){
-        //     rednand_ini.slccmpt = bool_val;
-        //     rednand_ini.slccmpt_set = true;
-        //     return 1;
-        // }
+        if(!strcmp("slc", name)){
+            rednand_ini.slc_nocrypto = bool_val;
+            return 1;
+        }
+        if(!strcmp("slccmpt", name)){
+            rednand_ini.slccmpt_nocrypto = bool_val;
+            return 1;
+        }
         if(!strcmp("mlc", name)){
             rednand_ini.mlc_nocrypto = bool_val;
             return 1;
@@ -273,6 +274,8 @@ static int apply_ini_config(void){
         ret |= 4;
     }
 
+    rednand.slc_nocrypto = rednand_ini.slc_nocrypto;
+    rednand.slccmpt_nocrypto = rednand_ini.slccmpt_nocrypto;
     rednand.mlc_nocrypto = rednand_ini.mlc_nocrypto;
 
     if(rednand_ini.sys_mount_mlc && rednand.slc.lba_length) {
@@ -299,6 +302,8 @@ static int apply_ini_config(void){
     printf(" slc: %i\n", rednand.slc.lba_length);
     printf(" mlc: %i\n", rednand.mlc.lba_length);
     printf(" disable scfm: %i\n", rednand.disable_scfm);
+    printf(" slc_nocrypto: %i\n", rednand.slc_nocrypto);
+    printf(" slccmpt_nocrypto: %i\n", rednand.slccmpt_nocrypto);
     printf(" mlc_nocrypto: %i\n", rednand.mlc_nocrypto);
     printf(" mlc sysmount: %i\n", rednand.sys_mount_mlc);
 
@@ -306,8 +311,10 @@ static int apply_ini_config(void){
 }
 
 static int rednand_load_seeprom(void) {
-    if(redseeprom)
-        free(redseeprom);
+    if(redseeprom) {
+        dma_pool_free(redseeprom);
+        redseeprom = NULL;
+    }
     printf("INFO: Trying to load %s... ", redseeprom_path);
     FILE* file = fopen(redseeprom_path, "rb");
     if (!file){
@@ -315,7 +322,7 @@ static int rednand_load_seeprom(void) {
         return 0;
     }
     printf("FOUND!\n");
-    redseeprom = memalign(32, SEEPROM_SIZE);
+    redseeprom = dma_pool_alloc(SEEPROM_SIZE);
     if(!redseeprom){
         printf("Error allocating memory for red_seeprom\n");
         return -1;
@@ -325,15 +332,17 @@ static int rednand_load_seeprom(void) {
     fclose(file);
     if(read != 1){
         printf("Error loading %s\n", redseeprom_path);
-        free(redseeprom);
+        dma_pool_free(redseeprom);
         redseeprom = NULL;
         return -2;
     }
 }
 
 static int rednand_load_opt(void){
-    if(redotp)
-        free(redotp);
+    if(redotp) {
+        dma_pool_free(redotp);
+        redotp = NULL;
+    }
     printf("INFO: Trying to load %s... ", redotp_path);
     FILE* otp_file = fopen(redotp_path, "rb");
     if (!otp_file){
@@ -341,7 +350,7 @@ static int rednand_load_opt(void){
         return 0;
     }
     printf("FOUND!\n");
-    redotp = memalign(32, sizeof(*redotp));
+    redotp = dma_pool_alloc(sizeof(*redotp));
     if(!redotp){
         printf("Error allocating memory for red_otp\n");
         return -1;
@@ -350,7 +359,7 @@ static int rednand_load_opt(void){
     fclose(otp_file);
     if(read != 1){
         printf("Error loading %s\n", redotp_path);
-        free(redotp);
+        dma_pool_free(redotp);
         redotp = NULL;
         return -2;
     }
@@ -363,8 +372,10 @@ void clear_rednand(void){
     isfs_unmount(ISFSVOL_REDSLC);
     isfs_unmount(ISFSVOL_REDSLCCMPT);
     memset(&rednand, 0, sizeof(rednand));
-    if(redotp)
-        free(redotp);
+    if(redotp) {
+        dma_pool_free(redotp);
+        redotp = NULL;
+    }
 }
 
 int init_rednand(void){
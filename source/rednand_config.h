@@ -15,8 +15,8 @@ typedef struct {
     bool scfm_on_slccmpt;
     bool initilized;
     //v2
-    bool slc_nocrypto; //not implemented yet
-    bool slccmpt_nocrypto; //not implemented yet
+    bool slc_nocrypto;
+    bool slccmpt_nocrypto;
     bool mlc_nocrypto;
     //v3
     bool sys_mount_slc; //not implemented yet
@@ -12,6 +12,10 @@
 #include "latte.h"
 #include "exi.h"
 #include "utils.h"
+#include "irq.h"
+#include "minini.h"
+
+#include <string.h>
 
 void rtc_set_ctrl1(u32 val)
 {
@@ -35,39 +39,63 @@ u32 rtc_get_ctrl0()
 
 void rtc_get_panic_reason(char* buffer)
 {
-    u32* buf32 = (u32*)buffer;
+    u32 buf32[64 / sizeof(u32)];
 
-    write32(EXI0_CSR, 0x108);
-    write32(EXI0_DATA, 0x20000100);
-    write32(EXI0_CR, 0x35);
-    while(!(read32(EXI0_CSR) & 8));
+    exi0_burst_read(0x20000100, buf32, 64 / sizeof(u32));
+    memcpy(buffer, buf32, 64);
+}
 
-    for(int i = 0; i < 64 / sizeof(u32); i++)
-    {
-        write32(EXI0_CSR, 0x108);
-        write32(EXI0_CR, 0x31);
-        while(!(read32(EXI0_CSR) & 8));
+void rtc_set_panic_reason(const char* buffer)
+{
+    u32 buf32[64 / sizeof(u32)];
 
-        buf32[i] = read32(EXI0_DATA);
-    }
+    memcpy(buf32, buffer, 64);
+    exi0_burst_write(0xA0000100, buf32, 64 / sizeof(u32));
+}
+
+#ifndef MINUTE_BOOT1
+#define RTC_COUNTER         (0x20000000)
+#define RTC_TICKS_PER_SEC   IRQ_ALARM_MS2REG(1000)
 
-    write32(EXI0_CSR, 0);
+// The counter as of rtc_ticks, advanced by LT_TIMER instead of EXI reads.
+static u32 rtc_seconds = 0;
+static u32 rtc_ticks = 0;
+// [rtc] offset in minute.ini, seconds added to the counter.
+static s32 rtc_offset = 0;
+
+void rtc_time_init(void)
+{
+    u32 cookie = irq_kill();
+    rtc_seconds = exi0_read32(RTC_COUNTER);
+    rtc_ticks = read32(LT_TIMER);
+    irq_restore(cookie);
 }
 
-void rtc_set_panic_reason(const char* buffer)
+// Folds whole seconds of LT_TIMER into rtc_seconds. Has to run before
+// LT_TIMER wraps (~37 minutes), which the timer IRQ takes care of.
+void rtc_tick(void)
 {
-    write32(EXI0_CSR, 0x108);
-    write32(EXI0_DATA, 0xA0000100);
-    write32(EXI0_CR, 0x35);
-    while(!(read32(EXI0_CSR) & 8));
-
-    for(int i = 0; i < 64 / sizeof(u32); i++)
-    {
-        write32(EXI0_CSR, 0x108);
-        write32(EXI0_DATA, read32_unaligned(&buffer[i * sizeof(u32)]));
-        write32(EXI0_CR, 0x35);
-        while(!(read32(EXI0_CSR) & 8));
+    u32 cookie = irq_kill();
+    if(rtc_seconds) {
+        u32 secs = (read32(LT_TIMER) - rtc_ticks) / RTC_TICKS_PER_SEC;
+        rtc_seconds += secs;
+        rtc_ticks += secs * RTC_TICKS_PER_SEC;
     }
+    irq_restore(cookie);
+}
+
+// Seconds since 2000-01-01, 0 if the counter wasn't read.
+u32 rtc_get_time(void)
+{
+    rtc_tick();
+    return rtc_seconds ? rtc_seconds + rtc_offset : 0;
+}
+
+int rtc_ini(const char* key, const char* value)
+{
+    if(!strcmp(key, "offset"))
+        rtc_offset = (s32)minini_get_int(value, 0);
 
-    write32(EXI0_CSR, 0);
-}
\ No newline at end of file
+    return 0;
+}
+#endif
@@ -65,4 +65,14 @@ void rtc_set_ctrl0(u32 val);
 void rtc_get_panic_reason(char* buffer);
 void rtc_set_panic_reason(const char* buffer);
 
+// The counter runs in seconds since 2000-01-01.
+#define RTC_EPOCH_UNIX (946684800)
+
+#ifndef MINUTE_BOOT1
+void rtc_time_init(void);
+void rtc_tick(void);
+u32 rtc_get_time(void);
+int rtc_ini(const char* key, const char* value);
+#endif
+
 #endif // __RTC_H__
\ No newline at end of file
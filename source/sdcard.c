@@ -21,6 +21,7 @@
 #include "elm.h"
 
 #include "latte.h"
+#include "timer.h"
 
 #ifdef CAN_HAZ_IRQ
 #include "irq.h"
@@ -151,7 +152,7 @@ void sdcard_needs_discover(void)
 
     int tries;
     for (tries = 100; tries > 0; tries--) {
-        udelay(100000);
+        timer_sleep(100000);
 
         memset(&cmd, 0, sizeof(cmd));
         cmd.c_opcode = MMC_APP_CMD;
@@ -524,18 +525,21 @@ int sdcard_end_read(struct sdmmc_command* cmdbuf)
 //  printf("%s(%u, %u, %p)\n", __FUNCTION__, blk_start, blk_count, data);
     if (card.inserted == 0) {
         printf("sdcard: READ: no card inserted.\n");
+        task_unlock(&card.handle->lock);
         return -1;
     }
 
     if (card.selected == 0) {
         if (sdcard_select() < 0) {
             printf("sdcard: READ: cannot select card.\n");
+            task_unlock(&card.handle->lock);
             return -1;
         }
     }
 
     if (card.new_card == 1) {
         printf("sdcard: new card inserted but not acknowledged yet.\n");
+        task_unlock(&card.handle->lock);
         return -1;
     }
 
@@ -703,18 +707,21 @@ int sdcard_end_write(struct sdmmc_command* cmdbuf)
 {
     if (card.inserted == 0) {
         printf("sdcard: WRITE: no card inserted.\n");
+        task_unlock(&card.handle->lock);
         return -1;
     }
 
     if (card.selected == 0) {
         if (sdcard_select() < 0) {
             printf("sdcard: WRITE: cannot select card.\n");
+            task_unlock(&card.handle->lock);
             return -1;
         }
     }
 
     if (card.new_card == 1) {
         printf("sdcard: new card inserted but not acknowledged yet.\n");
+        task_unlock(&card.handle->lock);
         return -1;
     }
 
@@ -511,8 +511,8 @@ sdhc_wait_state(struct sdhc_host *hp, u_int32_t mask, u_int32_t value)
     return ETIMEDOUT;
 }
 
-void
-sdhc_async_command(struct sdhc_host *hp, struct sdmmc_command *cmd)
+static void
+_sdhc_async_command(struct sdhc_host *hp, struct sdmmc_command *cmd)
 {
     int error;
 
@@ -540,8 +540,8 @@ sdhc_async_command(struct sdhc_host *hp, struct sdmmc_command *cmd)
     }
 }
 
-void
-sdhc_async_response(struct sdhc_host *hp, struct sdmmc_command *cmd)
+static void
+_sdhc_async_response(struct sdhc_host *hp, struct sdmmc_command *cmd)
 {
     /*
      * Wait until the command phase is done, or until the command
@@ -601,20 +601,43 @@ sdhc_async_response(struct sdhc_host *hp, struct sdmmc_command *cmd)
     hp->data_command = 0;
 }
 
+/*
+ * The host stays locked from a successful sdhc_async_command until the
+ * matching sdhc_async_response, so no other task's command lands in
+ * between.
+ */
+void
+sdhc_async_command(struct sdhc_host *hp, struct sdmmc_command *cmd)
+{
+    task_lock(&hp->lock);
+    _sdhc_async_command(hp, cmd);
+    if (cmd->c_error)
+        task_unlock(&hp->lock);
+}
+
+void
+sdhc_async_response(struct sdhc_host *hp, struct sdmmc_command *cmd)
+{
+    _sdhc_async_response(hp, cmd);
+    task_unlock(&hp->lock);
+}
+
 void
 sdhc_exec_command(struct sdhc_host *hp, struct sdmmc_command *cmd)
 {
+    task_lock(&hp->lock);
 #ifdef CAN_HAZ_IRQ
     u32 cookie = irq_kill();
 #endif
     //serial_send_u32(0x1234AAAA);
-    sdhc_async_command(hp, cmd);
+    _sdhc_async_command(hp, cmd);
     //serial_send_u32(0x1234AAAB);
-    sdhc_async_response(hp, cmd);
+    _sdhc_async_response(hp, cmd);
     //serial_send_u32(0x1234AAAD);
 #ifdef CAN_HAZ_IRQ
     irq_restore(cookie);
 #endif
+    task_unlock(&hp->lock);
 }
 
 int
@@ -850,6 +873,9 @@ sdhc_wait_intr_debug(const char *funcname, int line, struct sdhc_host *hp, int m
                 goto breakout;
             }
 
+            // Never switches under irq_kill, and hp->lock keeps other
+            // tasks off this host meanwhile.
+            task_yield();
             udelay(1);
         }
     }
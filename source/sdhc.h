@@ -24,6 +24,7 @@
 #include "bsdtypes.h"
 #include "sdmmc.h"
 #include "memory.h"
+#include "task.h"
 
 struct sdhc_host_params {
     void (*attach)();
@@ -44,6 +45,7 @@ struct sdhc_host {
     volatile u_int16_t intr_error_status;    /* soft error status */
     int data_command;
     int no_dma;
+    task_lock_t lock;       /* one command at a time per host */
 
     struct sdhc_host_params pa;
 };
@@ -232,6 +234,8 @@ void sdhc_card_intr_ack(struct sdhc_host *hp);
 
 void sdhc_exec_command(struct sdhc_host *hp, struct sdmmc_command *);
 
+// A started command keeps hp->lock until its response. Callers that give
+// up on the response have to task_unlock it themselves.
 void sdhc_async_command(struct sdhc_host *hp, struct sdmmc_command *);
 void sdhc_async_response(struct sdhc_host *hp, struct sdmmc_command *);
 
@@ -15,6 +15,9 @@
 #include "latte.h"
 #include "gpio.h"
 #include "gfx.h"
+#include "seeprom.h"
+
+#include <string.h>
 
 #define eeprom_delay() udelay(5)
 
@@ -70,15 +73,8 @@ static void wait_write()
     flush();
 }
 
-int seeprom_read(void *dst, int offset, int size)
+static void seeprom_gpio_init(void)
 {
-    int i;
-    u16 *ptr = (u16 *)dst;
-    u16 recv;
-
-    if(size & 1)
-        return -1;
-
     gpio_set_dir(GP_EEP_CLK, GPIO_DIR_OUT);
     gpio_set_dir(GP_EEP_CS, GPIO_DIR_OUT);
     gpio_set_dir(GP_EEP_MOSI, GPIO_DIR_OUT);
@@ -92,67 +88,150 @@ int seeprom_read(void *dst, int offset, int size)
     clear32(LT_GPIO_OUT, BIT(GP_EEP_CLK));
     clear32(LT_GPIO_OUT, BIT(GP_EEP_CS));
     eeprom_delay();
+}
 
+static void send_cmd(u32 cmd)
+{
+    set32(LT_GPIO_OUT, BIT(GP_EEP_CS));
+    send_bits(cmd, 11);
+    clear32(LT_GPIO_OUT, BIT(GP_EEP_CS));
+    flush();
+    eeprom_delay();
+}
+
+// The SEEPROM keeps shifting out consecutive words for as long as CS stays
+// high after a READ, so the whole range only needs one command.
+static void read_sequential(u16 *dst, int offset, int size)
+{
+    int i;
+
+    set32(LT_GPIO_OUT, BIT(GP_EEP_CS));
+    send_bits((0x600 | offset), 11);
     for(i = 0; i < size; ++i)
-    {
-        //printf("%x\n", i);
-        set32(LT_GPIO_OUT, BIT(GP_EEP_CS));
-        send_bits((0x600 | (offset + i)), 11);
-        recv = recv_bits(16);
-        *ptr++ = recv;
-        clear32(LT_GPIO_OUT, BIT(GP_EEP_CS));
-        flush();
-        eeprom_delay();
-    }
+        *dst++ = recv_bits(16);
+    clear32(LT_GPIO_OUT, BIT(GP_EEP_CS));
+    flush();
+    eeprom_delay();
+}
+
+int seeprom_read(void *dst, int offset, int size)
+{
+    if(size & 1)
+        return -1;
+    if(offset < 0 || size < 0 || offset + size > SEEPROM_WORDS)
+        return -1;
+    if(!size)
+        return 0;
+
+    seeprom_gpio_init();
+    read_sequential((u16 *)dst, offset, size);
 
     return size;
 }
 
-int seeprom_write(void *src, int offset, int size)
+/*
+ * Writes are staged in a shadow copy of the SEEPROM. Flushing reads the
+ * current contents once, programs only the words that actually differ and
+ * verifies everything with a single sequential read at the end.
+ */
+static u16 write_shadow[SEEPROM_WORDS];
+static u32 write_dirty[SEEPROM_WORDS / 32];
+
+int seeprom_write_queue(const void *src, int offset, int size)
 {
     int i;
-    u16 *ptr = (u16 *)src;
+    const u16 *ptr = (const u16 *)src;
 
     if(size & 1)
         return -1;
+    if(offset < 0 || size < 0 || offset + size > SEEPROM_WORDS)
+        return -1;
 
-    gpio_set_dir(GP_EEP_CLK, GPIO_DIR_OUT);
-    gpio_set_dir(GP_EEP_CS, GPIO_DIR_OUT);
-    gpio_set_dir(GP_EEP_MOSI, GPIO_DIR_OUT);
-    gpio_set_dir(GP_EEP_MISO, GPIO_DIR_IN);
+    for(i = 0; i < size; ++i)
+    {
+        write_shadow[offset + i] = *ptr++;
+        write_dirty[(offset + i) / 32] |= BIT((offset + i) % 32);
+    }
 
-    gpio_enable(GP_EEP_CLK, GPIO_DIR_OUT);
-    gpio_enable(GP_EEP_CS, GPIO_DIR_OUT);
-    gpio_enable(GP_EEP_MOSI, GPIO_DIR_OUT);
-    gpio_enable(GP_EEP_MISO, GPIO_DIR_IN);
+    return size;
+}
 
-    clear32(LT_GPIO_OUT, BIT(GP_EEP_CLK));
-    clear32(LT_GPIO_OUT, BIT(GP_EEP_CS));
-    eeprom_delay();
+void seeprom_write_discard(void)
+{
+    memset(write_dirty, 0, sizeof(write_dirty));
+}
 
-    // Write enable
-    set32(LT_GPIO_OUT, BIT(GP_EEP_CS));
-    send_bits(0x4C0, 11);
-    clear32(LT_GPIO_OUT, BIT(GP_EEP_CS));
-    flush();
-    eeprom_delay();
+int seeprom_write_flush(void)
+{
+    static u16 current[SEEPROM_WORDS];
+    int i, first = -1, last = -1, programmed = 0;
 
-    for(i = 0; i < size; ++i)
+    for(i = 0; i < SEEPROM_WORDS; ++i)
+    {
+        if(!(write_dirty[i / 32] & BIT(i % 32)))
+            continue;
+        if(first < 0)
+            first = i;
+        last = i;
+    }
+    if(first < 0)
+        return 0;
+
+    seeprom_gpio_init();
+    read_sequential(&current[first], first, last - first + 1);
+
+    for(i = first; i <= last; ++i)
     {
-        //printf("%x\n", i);
+        if(!(write_dirty[i / 32] & BIT(i % 32)))
+            continue;
+        if(current[i] == write_shadow[i])
+            continue;
+
+        // Write enable
+        if(!programmed)
+            send_cmd(0x4C0);
+
         set32(LT_GPIO_OUT, BIT(GP_EEP_CS));
-        send_bits(((0x500 | (offset + i)) << 16) | (*ptr++), 27);
+        send_bits(((0x500 | i) << 16) | write_shadow[i], 27);
         clear32(LT_GPIO_OUT, BIT(GP_EEP_CS));
         flush();
         wait_write();
+        programmed++;
     }
 
     // Write disable
-    set32(LT_GPIO_OUT, BIT(GP_EEP_CS));
-    send_bits(0x400, 11);
-    clear32(LT_GPIO_OUT, BIT(GP_EEP_CS));
-    flush();
-    eeprom_delay();
+    if(programmed)
+    {
+        send_cmd(0x400);
+        read_sequential(&current[first], first, last - first + 1);
+    }
+
+    for(i = first; i <= last; ++i)
+    {
+        if(!(write_dirty[i / 32] & BIT(i % 32)))
+            continue;
+        if(current[i] != write_shadow[i])
+            return -2;
+    }
+
+    seeprom_write_discard();
+    return programmed;
+}
+
+int seeprom_write(void *src, int offset, int size)
+{
+    int res;
+
+    res = seeprom_write_queue(src, offset, size);
+    if(res < 0)
+        return res;
+
+    res = seeprom_write_flush();
+    if(res < 0)
+    {
+        seeprom_write_discard();
+        return res;
+    }
 
     return size;
 }
@@ -10,8 +10,15 @@
 #ifndef __SEEPROM_H__
 #define __SEEPROM_H__
 
+// Sizes and offsets are in 16-bit words
+#define SEEPROM_WORDS (0x100)
+
 int seeprom_read(void *dst, int offset, int size);
 int seeprom_write(void *src, int offset, int size);
+
+int seeprom_write_queue(const void *src, int offset, int size);
+int seeprom_write_flush(void);
+void seeprom_write_discard(void);
 void seeprom_erase(void);
 
 #endif
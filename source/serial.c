@@ -18,6 +18,7 @@ u8 serial_buffer[256];
 u16 serial_len = 0;
 static u8 _serial_allow_zeros = 0;
 u32 serial_line = 0;
+static u32 serial_output_count = 0;
 
 void serial_fatal()
 {
@@ -137,8 +138,17 @@ void serial_disallow_zeros()
     _serial_allow_zeros = 0;
 }
 
+// Lets callers tell whether anything was printed since they last looked.
+u32 serial_get_output_count()
+{
+    return serial_output_count;
+}
+
 void serial_send(u8 val)
 {
+    if (val)
+        serial_output_count++;
+
     u8 read_val = 0;
     u8 read_val_valid = 0;
     for (int j = 7; j >= 0; j--)
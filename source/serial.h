@@ -23,5 +23,6 @@ void serial_send(u8 val);
 void serial_line_inc();
 void serial_clear();
 void serial_line_noscroll();
+u32 serial_get_output_count();
 
 #endif // __SERIAL_H__
\ No newline at end of file
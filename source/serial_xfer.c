@@ -0,0 +1,609 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#include "serial_xfer.h"
+
+#ifndef MINUTE_BOOT1
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "serial.h"
+#include "utils.h"
+#include "latte.h"
+#include "crc32.h"
+#include "tinf.h"
+
+// LT_TIMER ticks, see udelay.
+#define XFER_MS(x)              ((x) * 1900)
+#define XFER_OPEN_TIMEOUT       XFER_MS(10000)
+#define XFER_OPEN_RETRY         XFER_MS(1000)
+#define XFER_IDLE_TIMEOUT       XFER_MS(5000)
+#define XFER_ACK_RETRY          XFER_MS(250)
+#define XFER_RESEND_TIMEOUT     XFER_MS(500)
+// Several of the host's END resends, it waits XFER_RESEND_TIMEOUT for each ACK.
+#define XFER_LINGER             XFER_MS(2000)
+
+#define XFER_STAGE_SIZE         (0x1000)
+#define XFER_DICT_SIZE          (0x8000)
+
+typedef struct {
+    u8 type;
+    u8 len;
+    u32 seq;
+    u8 data[XFER_MAX_PAYLOAD];
+} xfer_frame;
+
+typedef struct {
+    // last serial_in_read, parsed up to in_pos
+    u8 in[256];
+    int in_len;
+    int in_pos;
+    // frame being assembled
+    u8 rx[XFER_HDR_SIZE + XFER_MAX_PAYLOAD];
+    int rx_len;
+    u32 last_tx;
+
+    FILE* f;
+    u32 crc;
+    u32 count;
+
+    // receiving
+    xfer_frame frame;
+    int pos;
+    u32 expected;
+    bool nak_sent;
+    int err;
+    u8 stage[XFER_STAGE_SIZE];
+    int stage_len;
+    TINF_DATA d;
+} xfer_ctx;
+
+static xfer_ctx xfer;
+
+static inline u32 _xfer_now(void)
+{
+    return read32(LT_TIMER);
+}
+
+static void _xfer_send(u8 type, u32 seq, const void* data, u8 len)
+{
+    u8 hdr[XFER_HDR_SIZE];
+    const u8* p = data;
+
+    hdr[0] = XFER_MAGIC0;
+    hdr[1] = XFER_MAGIC1;
+    hdr[2] = type;
+    hdr[3] = len;
+    write32_unaligned(hdr + 4, seq);
+    write32_unaligned(hdr + 8, crc32_update(crc32(hdr + 2, 6), data, len));
+
+    // Each byte sent clocks one in, at most XFER_HDR_SIZE + XFER_MAX_PAYLOAD.
+    for(int i = 0; i < XFER_HDR_SIZE; i++)
+        serial_send(hdr[i]);
+    for(int i = 0; i < len; i++)
+        serial_send(p[i]);
+
+    xfer.last_tx = _xfer_now();
+}
+
+static void _xfer_abort(int error)
+{
+    u8 data[4];
+    write32_unaligned(data, -error);
+    _xfer_send(XFER_TYPE_ABORT, 0, data, sizeof(data));
+}
+
+// Parses what the link clocked in so far, true once a valid frame is complete.
+static bool _xfer_poll_frame(xfer_frame* out)
+{
+    while(true) {
+        if(xfer.in_pos >= xfer.in_len) {
+            xfer.in_len = serial_in_read(xfer.in);
+            xfer.in_pos = 0;
+            if(!xfer.in_len)
+                return false;
+        }
+
+        u8 c = xfer.in[xfer.in_pos++];
+        if(xfer.rx_len == 0 && c != XFER_MAGIC0)
+            continue;
+        if(xfer.rx_len == 1 && c != XFER_MAGIC1) {
+            xfer.rx_len = (c == XFER_MAGIC0);
+            continue;
+        }
+        xfer.rx[xfer.rx_len++] = c;
+
+        if(xfer.rx_len == 4 && c > XFER_MAX_PAYLOAD) {
+            xfer.rx_len = 0;
+            continue;
+        }
+        if(xfer.rx_len < XFER_HDR_SIZE || xfer.rx_len < XFER_HDR_SIZE + xfer.rx[3])
+            continue;
+
+        u8 len = xfer.rx[3];
+        xfer.rx_len = 0;
+        u32 crc = crc32_update(crc32(xfer.rx + 2, 6), xfer.rx + XFER_HDR_SIZE, len);
+        if(crc != read32_unaligned(xfer.rx + 8))
+            continue;
+
+        out->type = xfer.rx[2];
+        out->len = len;
+        out->seq = read32_unaligned(xfer.rx + 4);
+        memcpy(out->data, xfer.rx + XFER_HDR_SIZE, len);
+        return true;
+    }
+}
+
+// Sends the request until the host answers with INFO.
+static int _xfer_open(u8 type, const u8* req, int req_len, xfer_frame* info)
+{
+    u32 start = _xfer_now();
+    u32 last = start - XFER_OPEN_RETRY;
+
+    while(_xfer_now() - start < XFER_OPEN_TIMEOUT) {
+        if(_xfer_now() - last >= XFER_OPEN_RETRY) {
+            _xfer_send(type, 0, req, req_len);
+            last = _xfer_now();
+        }
+
+        if(!_xfer_poll_frame(info)) {
+            serial_poll();
+            continue;
+        }
+        if(info->type == XFER_TYPE_INFO && info->len >= 9)
+            return 0;
+        if(info->type == XFER_TYPE_ABORT)
+            return -ECANCELED;
+    }
+
+    return -ETIMEDOUT;
+}
+
+static int _xfer_request(u8* req, int hdr_len, const char* path)
+{
+    int len = min((int)strlen(path), XFER_MAX_PAYLOAD - hdr_len);
+    memcpy(req + hdr_len, path, len);
+    return hdr_len + len;
+}
+
+// Returns 1 with the next in-order DATA frame in xfer.frame, 0 on END.
+static int _xfer_next_data(void)
+{
+    xfer_frame* fr = &xfer.frame;
+    u32 idle = _xfer_now();
+
+    while(true) {
+        if(!_xfer_poll_frame(fr)) {
+            u32 now = _xfer_now();
+            if(now - idle >= XFER_IDLE_TIMEOUT)
+                return -ETIMEDOUT;
+
+            // A lost ACK stalls the sender until it times out, repeat ours.
+            if(now - xfer.last_tx >= XFER_ACK_RETRY)
+                _xfer_send(XFER_TYPE_ACK, xfer.expected, NULL, 0);
+            else
+                serial_poll();
+            continue;
+        }
+        idle = _xfer_now();
+
+        switch(fr->type) {
+            case XFER_TYPE_DATA:
+            case XFER_TYPE_END:
+                if(fr->seq > xfer.expected) {
+                    // Once per gap, the frames after it are already in flight.
+                    if(!xfer.nak_sent)
+                        _xfer_send(XFER_TYPE_NAK, xfer.expected, NULL, 0);
+                    xfer.nak_sent = true;
+                    continue;
+                }
+                if(fr->seq < xfer.expected) {
+                    _xfer_send(XFER_TYPE_ACK, xfer.expected, NULL, 0);
+                    continue;
+                }
+                xfer.nak_sent = false;
+                if(fr->type == XFER_TYPE_END)
+                    return 0;
+
+                xfer.expected++;
+                _xfer_send(XFER_TYPE_ACK, xfer.expected, NULL, 0);
+                xfer.pos = 0;
+                return 1;
+
+            case XFER_TYPE_INFO:
+                // The host missed the ACK that starts the data.
+                if(xfer.expected == 0)
+                    _xfer_send(XFER_TYPE_ACK, 0, NULL, 0);
+                continue;
+
+            case XFER_TYPE_ABORT:
+                return -ECANCELED;
+        }
+    }
+}
+
+static int _xfer_stage(const u8* data, u32 len)
+{
+    xfer.crc = crc32_update(xfer.crc, data, len);
+    xfer.count += len;
+
+    while(len) {
+        u32 n = min(len, (u32)(XFER_STAGE_SIZE - xfer.stage_len));
+        memcpy(xfer.stage + xfer.stage_len, data, n);
+        xfer.stage_len += n;
+        data += n;
+        len -= n;
+
+        if(xfer.stage_len == XFER_STAGE_SIZE) {
+            if(fwrite(xfer.stage, XFER_STAGE_SIZE, 1, xfer.f) != 1)
+                return -EIO;
+            xfer.stage_len = 0;
+        }
+    }
+
+    return 0;
+}
+
+static int _xfer_receive_raw(void)
+{
+    int res;
+
+    while((res = _xfer_next_data()) == 1) {
+        int stage_res = _xfer_stage(xfer.frame.data, xfer.frame.len);
+        if(stage_res < 0)
+            return stage_res;
+    }
+
+    return res;
+}
+
+static unsigned char _xfer_read_source(TINF_DATA* d)
+{
+    (void)d;
+
+    // Feeds zeros after an error, uzlib bails out on them soon enough.
+    if(xfer.err)
+        return 0;
+
+    if(xfer.pos >= xfer.frame.len) {
+        int res;
+        do {
+            res = _xfer_next_data();
+        } while(res == 1 && !xfer.frame.len);
+
+        if(res != 1) {
+            // END inside the stream, the host truncated it.
+            xfer.err = res ? res : -EBADMSG;
+            return 0;
+        }
+    }
+
+    return xfer.frame.data[xfer.pos++];
+}
+
+static int _xfer_receive_deflate(void)
+{
+    u8* dict = malloc(XFER_DICT_SIZE);
+    u8* out = malloc(XFER_STAGE_SIZE);
+    int res;
+
+    if(!dict || !out) {
+        res = -ENOMEM;
+        goto out;
+    }
+
+    uzlib_init();
+    uzlib_uncompress_init(&xfer.d, dict, XFER_DICT_SIZE);
+    xfer.d.source = NULL;
+    xfer.d.readSource = _xfer_read_source;
+    xfer.frame.len = 0;
+    xfer.pos = 0;
+
+    res = uzlib_zlib_parse_header(&xfer.d);
+    if(xfer.err) {
+        res = xfer.err;
+        goto out;
+    }
+    if(res < 0) {
+        res = -EBADMSG;
+        goto out;
+    }
+
+    do {
+        xfer.d.dest = out;
+        xfer.d.destSize = XFER_STAGE_SIZE;
+        res = uzlib_uncompress_chksum(&xfer.d);
+        if(xfer.err) {
+            res = xfer.err;
+            goto out;
+        }
+        if(res < 0) {
+            res = -EBADMSG;
+            goto out;
+        }
+
+        int stage_res = _xfer_stage(out, xfer.d.dest - out);
+        if(stage_res < 0) {
+            res = stage_res;
+            goto out;
+        }
+    } while(res != TINF_DONE);
+
+    // Nothing may follow the zlib stream but END.
+    if(xfer.pos != xfer.frame.len) {
+        res = -EBADMSG;
+        goto out;
+    }
+    do {
+        res = _xfer_next_data();
+    } while(res == 1 && !xfer.frame.len);
+    if(res == 1)
+        res = -EBADMSG;
+
+out:
+    free(dict);
+    free(out);
+    return res;
+}
+
+// Answers repeated ENDs for a while, in case our final ACK got lost.
+static void _xfer_linger(u32 seq)
+{
+    xfer_frame* fr = &xfer.frame;
+    u32 start = _xfer_now();
+
+    while(_xfer_now() - start < XFER_LINGER) {
+        if(!_xfer_poll_frame(fr)) {
+            serial_poll();
+            continue;
+        }
+        if(fr->type == XFER_TYPE_END && fr->seq + 1 == seq)
+            _xfer_send(XFER_TYPE_ACK, seq, NULL, 0);
+    }
+}
+
+// crc32 of what the file already holds, so the host can tell whether to resume.
+static u32 _xfer_file_crc(FILE* f, u32* size)
+{
+    u32 crc = 0;
+    size_t read;
+
+    *size = 0;
+    while((read = fread(xfer.stage, 1, XFER_STAGE_SIZE, f)) > 0) {
+        crc = crc32_update(crc, xfer.stage, read);
+        *size += read;
+    }
+
+    return crc;
+}
+
+int serial_xfer_receive(const char* path)
+{
+    u8 req[XFER_MAX_PAYLOAD];
+    xfer_frame info;
+    u32 cur_size = 0, cur_crc = 0;
+    u32 offset = 0, size;
+    int res;
+
+    memset(&xfer, 0, sizeof(xfer));
+
+    FILE* f = fopen(path, "rb");
+    if(f) {
+        cur_crc = _xfer_file_crc(f, &cur_size);
+        fclose(f);
+    }
+
+    write32_unaligned(req, cur_size);
+    write32_unaligned(req + 4, cur_crc);
+    req[8] = XFER_FLAG_DEFLATE;
+
+    serial_allow_zeros();
+    res = _xfer_open(XFER_TYPE_PUT, req, _xfer_request(req, 9, path), &info);
+    if(res < 0)
+        goto done;
+
+    offset = read32_unaligned(info.data);
+    size = read32_unaligned(info.data + 4);
+    if(offset > cur_size) {
+        res = -EINVAL;
+        goto abort;
+    }
+
+    xfer.f = fopen(path, offset ? "r+b" : "wb");
+    if(!xfer.f) {
+        res = -ENOENT;
+        goto abort;
+    }
+    if(offset && (fseek(xfer.f, offset, SEEK_SET) || ftruncate(fileno(xfer.f), offset))) {
+        res = -EIO;
+        goto abort;
+    }
+
+    // Starts the data.
+    _xfer_send(XFER_TYPE_ACK, 0, NULL, 0);
+
+    if(info.data[8] & XFER_FLAG_DEFLATE)
+        res = _xfer_receive_deflate();
+    else
+        res = _xfer_receive_raw();
+    if(res < 0)
+        goto abort;
+
+    if(xfer.stage_len && fwrite(xfer.stage, xfer.stage_len, 1, xfer.f) != 1) {
+        res = -EIO;
+        goto abort;
+    }
+    if(xfer.frame.len < 4 || read32_unaligned(xfer.frame.data) != xfer.crc || xfer.count != size) {
+        res = -EBADMSG;
+        goto abort;
+    }
+    res = fclose(xfer.f) ? -EIO : 0;
+    xfer.f = NULL;
+    if(res < 0)
+        goto abort;
+
+    _xfer_send(XFER_TYPE_ACK, xfer.expected + 1, NULL, 0);
+    _xfer_linger(xfer.expected + 1);
+    goto done;
+
+abort:
+    _xfer_abort(res);
+done:
+    if(xfer.f)
+        fclose(xfer.f);
+    serial_disallow_zeros();
+
+    if(res < 0) {
+        printf("serial_xfer: receiving `%s` failed (%d).\n", path, res);
+        return res;
+    }
+    printf("serial_xfer: received 0x%lx bytes at 0x%lx into `%s`, crc32 %08lX.\n",
+           xfer.count, offset, path, xfer.crc);
+    return 0;
+}
+
+int serial_xfer_send(const char* path)
+{
+    u8 req[XFER_MAX_PAYLOAD];
+    xfer_frame info, fr;
+    u8* ring = NULL;
+    u32 size, offset = 0, left, frames;
+    u32 base = 0, next = 0, filled = 0;
+    u32 last_rx, last_ack;
+    int res;
+
+    memset(&xfer, 0, sizeof(xfer));
+
+    xfer.f = fopen(path, "rb");
+    if(!xfer.f) {
+        printf("serial_xfer: failed to open `%s`.\n", path);
+        return -ENOENT;
+    }
+    fseek(xfer.f, 0, SEEK_END);
+    size = ftell(xfer.f);
+
+    write32_unaligned(req, size);
+    req[4] = 0;
+
+    serial_allow_zeros();
+    res = _xfer_open(XFER_TYPE_GET, req, _xfer_request(req, 5, path), &info);
+    if(res < 0)
+        goto done;
+
+    offset = read32_unaligned(info.data);
+    ring = malloc(XFER_WINDOW * XFER_MAX_PAYLOAD);
+    if(offset > size || fseek(xfer.f, offset, SEEK_SET)) {
+        res = -EINVAL;
+        goto abort;
+    }
+    if(!ring) {
+        res = -ENOMEM;
+        goto abort;
+    }
+
+    left = size - offset;
+    frames = (left + XFER_MAX_PAYLOAD - 1) / XFER_MAX_PAYLOAD;
+    last_rx = last_ack = _xfer_now();
+
+    // Go-back-N, the ring keeps the unacked frames [base, filled).
+    while(base < frames) {
+        if(next < frames && next < base + XFER_WINDOW) {
+            u8* slot = ring + (next % XFER_WINDOW) * XFER_MAX_PAYLOAD;
+            u32 len = min(left - next * XFER_MAX_PAYLOAD, (u32)XFER_MAX_PAYLOAD);
+
+            if(next == filled) {
+                if(fread(slot, len, 1, xfer.f) != 1) {
+                    res = -EIO;
+                    goto abort;
+                }
+                xfer.crc = crc32_update(xfer.crc, slot, len);
+                filled++;
+            }
+            _xfer_send(XFER_TYPE_DATA, next, slot, len);
+            next++;
+        }
+        else {
+            serial_poll();
+        }
+
+        while(_xfer_poll_frame(&fr)) {
+            last_rx = _xfer_now();
+            if(fr.type == XFER_TYPE_ABORT) {
+                res = -ECANCELED;
+                goto done;
+            }
+            if(fr.type != XFER_TYPE_ACK && fr.type != XFER_TYPE_NAK)
+                continue;
+            if(fr.seq < base || fr.seq > filled)
+                continue;
+
+            if(fr.seq > base)
+                last_ack = last_rx;
+            base = fr.seq;
+            if(fr.type == XFER_TYPE_NAK)
+                next = base;
+        }
+
+        if(_xfer_now() - last_rx >= XFER_IDLE_TIMEOUT) {
+            res = -ETIMEDOUT;
+            goto abort;
+        }
+        if(_xfer_now() - last_ack >= XFER_RESEND_TIMEOUT) {
+            next = base;
+            last_ack = _xfer_now();
+        }
+    }
+
+    u8 end[4];
+    write32_unaligned(end, xfer.crc);
+    last_ack = _xfer_now() - XFER_RESEND_TIMEOUT;
+    while(true) {
+        if(_xfer_now() - last_ack >= XFER_RESEND_TIMEOUT) {
+            _xfer_send(XFER_TYPE_END, frames, end, sizeof(end));
+            last_ack = _xfer_now();
+        }
+
+        if(!_xfer_poll_frame(&fr)) {
+            if(_xfer_now() - last_rx >= XFER_IDLE_TIMEOUT) {
+                res = -ETIMEDOUT;
+                goto abort;
+            }
+            serial_poll();
+            continue;
+        }
+        last_rx = _xfer_now();
+        if(fr.type == XFER_TYPE_ABORT) {
+            res = -ECANCELED;
+            goto done;
+        }
+        if(fr.type == XFER_TYPE_ACK && fr.seq == frames + 1)
+            break;
+    }
+    xfer.count = left;
+    goto done;
+
+abort:
+    _xfer_abort(res);
+done:
+    free(ring);
+    fclose(xfer.f);
+    serial_disallow_zeros();
+
+    if(res < 0) {
+        printf("serial_xfer: sending `%s` failed (%d).\n", path, res);
+        return res;
+    }
+    printf("serial_xfer: sent 0x%lx bytes at 0x%lx from `%s`, crc32 %08lX.\n",
+           xfer.count, offset, path, xfer.crc);
+    return 0;
+}
+
+#endif // MINUTE_BOOT1
@@ -0,0 +1,50 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#ifndef _SERIAL_XFER_H
+#define _SERIAL_XFER_H
+
+#include "types.h"
+
+/*
+ * Framed file transfer over the debug serial link, spoken by serial_xfer.py.
+ *
+ * Every frame is
+ *   'M' 'X' | type u8 | len u8 | seq u32 | crc u32 | payload[len]
+ * all big endian, with the crc32 covering type, len, seq and the payload.
+ *
+ * The device always opens the transfer (PUT to receive a file, GET to send
+ * one) and the host answers with INFO. DATA frames are numbered from 0 and
+ * acked cumulatively; the receiver NAKs the first gap so the sender can go
+ * back without waiting for its timeout. END carries the crc32 of everything
+ * sent and is acked with seq + 1.
+ */
+
+#define XFER_MAGIC0         ('M')
+#define XFER_MAGIC1         ('X')
+#define XFER_HDR_SIZE       (12)
+// Header + payload must fit serial_buffer between two reads.
+#define XFER_MAX_PAYLOAD    (240)
+
+#define XFER_TYPE_PUT       (1)     // u32 cur_size, u32 cur_crc, u8 flags, path
+#define XFER_TYPE_GET       (2)     // u32 size, u8 flags, path
+#define XFER_TYPE_INFO      (3)     // u32 offset, u32 size, u8 flags
+#define XFER_TYPE_DATA      (4)
+#define XFER_TYPE_ACK       (5)     // seq = next expected frame
+#define XFER_TYPE_NAK       (6)     // seq = first missing frame
+#define XFER_TYPE_END       (7)     // u32 crc
+#define XFER_TYPE_ABORT     (8)     // u32 error
+
+#define XFER_FLAG_DEFLATE   (1)     // PUT: device can inflate, INFO: DATA is a zlib stream
+
+// Frames in flight when sending.
+#define XFER_WINDOW         (8)
+
+int serial_xfer_receive(const char* path);
+int serial_xfer_send(const char* path);
+
+#endif
@@ -22,6 +22,8 @@ A million repetitions of "a"
 #include "irq.h"
 #include "memory.h"
 #include "latte.h"
+#include "dma_pool.h"
+#include "task.h"
 
 //should be divisible by four
 #define BLOCKSIZE 32
@@ -31,10 +33,21 @@ A million repetitions of "a"
 #define SHA_CMD_FLAG_ERR  (1<<29)
 #define SHA_CMD_AREA_BLOCK ((1<<10) - 1)
 
+// the H0-H4 registers hold one context at a time
+static task_lock_t sha_lock;
+
+// the engine can hash straight from buffers it can reach
+static inline bool sha_can_dma(const void* buffer)
+{
+    return !((u32)buffer & (SHA_BLOCK_SIZE - 1)) && can_sdcard_dma_addr((void*)buffer);
+}
+
 static void sha_transform(u32 state[SHA_HASH_WORDS], u8 buffer[SHA_BLOCK_SIZE], u32 blocks)
 {
     if(blocks == 0) return;
 
+    task_lock(&sha_lock);
+
     /* Copy ctx->state[] to working vars */
     write32(SHA_H0, state[0]);
     write32(SHA_H1, state[1]);
@@ -42,9 +55,13 @@ static void sha_transform(u32 state[SHA_HASH_WORDS], u8 buffer[SHA_BLOCK_SIZE],
     write32(SHA_H3, state[3]);
     write32(SHA_H4, state[4]);
 
-    // assign block to local copy which is 64-byte aligned
-    u8 *block = memalign(128, SHA_BLOCK_SIZE * blocks);
-    memcpy(block, buffer, SHA_BLOCK_SIZE * blocks);
+    // otherwise assign block to local copy which is 64-byte aligned
+    u8 *block = buffer;
+    bool copy = !sha_can_dma(buffer);
+    if(copy) {
+        block = dma_pool_alloc(SHA_BLOCK_SIZE * blocks);
+        memcpy(block, buffer, SHA_BLOCK_SIZE * blocks);
+    }
 
     // royal flush :)
     dc_flushrange(block, SHA_BLOCK_SIZE * blocks);
@@ -58,10 +75,12 @@ static void sha_transform(u32 state[SHA_HASH_WORDS], u8 buffer[SHA_BLOCK_SIZE],
 
     // fire up hashing and wait till its finished
     write32(SHA_CTRL, read32(SHA_CTRL) | SHA_CMD_FLAG_EXEC);
-    while (read32(SHA_CTRL) & SHA_CMD_FLAG_EXEC);
+    while (read32(SHA_CTRL) & SHA_CMD_FLAG_EXEC)
+        task_yield();
 
     // free the aligned data
-    free(block);
+    if(copy)
+        dma_pool_free(block);
 
     /* Add the working vars back into ctx.state[] */
     state[0] = read32(SHA_H0);
@@ -69,6 +88,8 @@ static void sha_transform(u32 state[SHA_HASH_WORDS], u8 buffer[SHA_BLOCK_SIZE],
     state[2] = read32(SHA_H2);
     state[3] = read32(SHA_H3);
     state[4] = read32(SHA_H4);
+
+    task_unlock(&sha_lock);
 }
 
 void sha_init(sha_ctx* ctx)
@@ -94,6 +115,12 @@ void sha_update(sha_ctx* ctx, const void* inbuf, size_t size)
     if ((j + size) > 63) {
         memcpy(&ctx->buffer[j], data, (i = 64-j));
         sha_transform(ctx->state, ctx->buffer, 1);
+        // hash aligned data in place, as much as one command can take
+        while (i + 63 < size && sha_can_dma(&data[i])) {
+            u32 blocks = min((size - i) / 64, SHA_CMD_AREA_BLOCK + 1);
+            sha_transform(ctx->state, &data[i], blocks);
+            i += blocks * 64;
+        }
         // try bigger blocks at once
         for ( ; i + 63 + ((BLOCKSIZE-1)*64) < size; i += (64 + (BLOCKSIZE-1)*64)) {
             sha_transform(ctx->state, &data[i], BLOCKSIZE);
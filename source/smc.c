@@ -23,6 +23,9 @@
 #include "gpio.h"
 #include "serial.h"
 #include "rtc.h"
+#include "irq.h"
+#include "task.h"
+#include "timer.h"
 
 // 0x00 - odd on (raw)
 // 0x01 - odd off (raw)
@@ -101,20 +104,25 @@
 // 0x3xx, 0x7xx, 0xBxx, 0xFxx have weird stalls/reset?? if 0x72 is set 0x80
 // 0x33xx, 0x37xx, 0x3Bxx, 0x3Fxx also have weird stalls/reset?? if 0x72 is set 0x80
 
+// main.c runs the event poll every 25ms
+#define SMC_WAIT_POLL_US (25 * 1000)
+
 static int smc_perma_disable = 0;
 
+// Background event polling, driven by the timer IRQ
+static volatile int smc_events_running = 0;
+static volatile int smc_events_busy = 0;
+static volatile u8 smc_events_pending = 0;
+static u8 smc_events_reg = 0x41;
+static u8 smc_events_data = 0;
+static i2c_xfer_t smc_events_xfer[2];
+
 int smc_read_register(u8 offset, u8* data)
 {
-    int res = 0;
-
     // Clock is 10000 in C2W, but 5000 in IOS...
     i2c_init(5000, 1);
 
-    res = i2c_write(I2C_SLAVE_SMC, &offset, 1);
-    if(res) return res;
-
-    res = i2c_read(I2C_SLAVE_SMC, data, 1);
-    return res;
+    return i2c_write_read(I2C_SLAVE_SMC, &offset, 1, data, 1);
 }
 
 int smc_write_register(u8 offset, u8 data)
@@ -141,16 +149,10 @@ int smc_write_register_multiple(u8 offset, u8* data, u32 count)
 
 int smc_read_register_multiple(u8 offset, u8* data, u32 count)
 {
-    int res = 0;
-
     // Clock is 10000 in C2W, but 5000 in IOS...
     i2c_init(5000, 1);
 
-    res = i2c_write(I2C_SLAVE_SMC, &offset, 1);
-    if(res) return res;
-
-    res = i2c_read(I2C_SLAVE_SMC, data, count);
-    return res;
+    return i2c_write_read(I2C_SLAVE_SMC, &offset, 1, data, count);
 }
 
 int smc_mask_register(u8 offset, u8 mask, u8 val)
@@ -289,12 +291,109 @@ int smc_set_wifi_idk(int state)
     smc_mask_register(0x46, 1, state ? 1 : 0);
 }
 
+static void _smc_events_done(i2c_xfer_t* xfer)
+{
+    // SMC failed to init...?
+    if(!xfer->result && smc_events_data != 0xFF)
+        smc_events_pending |= smc_events_data;
+
+    smc_events_busy = 0;
+}
+
+void smc_irq(void)
+{
+    if(!smc_events_running || smc_events_busy)
+        return;
+
+    smc_events_busy = 1;
+
+    smc_events_xfer[0] = (i2c_xfer_t) {
+        .next = &smc_events_xfer[1],
+        .bus = I2C_BUS_SMC,
+        .slave_7bit = I2C_SLAVE_SMC,
+        .flags = I2C_XFER_LINKED,
+        .data = &smc_events_reg,
+        .size = 1,
+    };
+    smc_events_xfer[1] = (i2c_xfer_t) {
+        .bus = I2C_BUS_SMC,
+        .slave_7bit = I2C_SLAVE_SMC,
+        .flags = I2C_XFER_READ,
+        .data = &smc_events_data,
+        .size = 1,
+        .callback = _smc_events_done,
+    };
+
+    // A failed write aborts the read too, so only the read reports back.
+
+    i2c_submit(&smc_events_xfer[0]);
+}
+
+void smc_events_start(u32 interval_ms)
+{
+    if (smc_perma_disable || smc_events_running) return;
+
+    u8 data = 0;
+
+    // Extra safety???
+    smc_read_register(0x40, &data);
+    if (data == 0 || data == 0xFF) {
+        smc_perma_disable = 1;
+        return;
+    }
+
+    // Don't lose whatever was latched before polling starts.
+    data = 0;
+    smc_read_register(0x41, &data);
+    smc_events_pending = (data == 0xFF) ? 0 : data;
+
+    smc_events_running = 1;
+    irq_set_alarm(interval_ms, 1);
+    irq_enable(IRQ_TIMER);
+}
+
+void smc_events_stop(void)
+{
+    if (!smc_events_running) return;
+
+#ifdef MINUTE_BOOT1
+    irq_disable(IRQ_TIMER);
+#endif
+    // Other timers may still be running, so only the poll stops.
+    irq_set_alarm(0, 0);
+    smc_events_running = 0;
+
+    while(smc_events_busy)
+        i2c_irq();
+}
+
+// Sleeps until the next IRQ (at the latest the next event poll).
+void smc_events_idle(void)
+{
+    if (!smc_events_running) return;
+    // Background tasks get the time instead, they yield back soon enough.
+    if (task_yield()) return;
+
+    u32 cookie = irq_kill();
+    if (!smc_events_pending)
+        irq_wait();
+    irq_restore(cookie);
+}
+
 u8 smc_get_events(void)
 {
     if (smc_perma_disable) return 0;
 
     u8 data = 0;
 
+    if (smc_events_running) {
+        u32 cookie = irq_kill();
+        data = smc_events_pending;
+        smc_events_pending = 0;
+        irq_restore(cookie);
+        return data;
+    }
+
     // Extra safety???
     smc_read_register(0x40, &data);
     if (data == 0 || data == 0xFF) {
@@ -320,6 +419,11 @@ u8 smc_wait_events(u8 mask)
     while(true) {
         u8 data = smc_get_events();
         if(data & mask) return data & mask;
+        // Without the event poll, read the SMC at about the rate it would.
+        if(smc_events_running)
+            smc_events_idle();
+        else
+            timer_sleep(SMC_WAIT_POLL_US);
     }
 }
 
@@ -61,6 +61,11 @@ int smc_write_raw_multiple(u8* data, u32 count);
 u8 smc_get_events(void);
 u8 smc_wait_events(u8 mask);
 
+void smc_irq(void);
+void smc_events_start(u32 interval_ms);
+void smc_events_stop(void);
+void smc_events_idle(void);
+
 int smc_set_notification_led(u8 val);
 int smc_set_odd_power(bool enable);
 int smc_eject_request();
@@ -0,0 +1,252 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#include "task.h"
+
+#ifndef MINUTE_BOOT1
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "utils.h"
+#include "irq.h"
+#include "gfx.h"
+#include "console.h"
+
+#define TASK_FREE       (0)
+#define TASK_READY      (1)
+#define TASK_DONE       (2)
+
+#define TASK_CANARY     (0x5441534B)
+#define TASK_OVERLAY_LEN (48)
+
+// Saved by task_switch, order matters.
+typedef struct task_ctx {
+    u32 cpsr;
+    u32 r4_r11[8];
+    u32 sp;
+    u32 lr;
+} task_ctx;
+
+typedef struct task_t {
+    task_ctx ctx;
+    int state;
+    task_entry_t entry;
+    void* arg;
+    u32* stack;
+    task_progress progress;
+} task_t;
+
+extern void task_switch(task_ctx* from, task_ctx* to);
+
+static u32 task_stacks[TASK_MAX - 1][TASK_STACK_SIZE / sizeof(u32)] ALIGNED(8);
+static task_t tasks[TASK_MAX] = {
+    [0] = { .state = TASK_READY, .progress = { .name = "main" } },
+};
+static int task_cur = 0;
+static int task_ready = 1;
+
+static char overlay_shown[TASK_MAX][TASK_OVERLAY_LEN];
+static u32 overlay_epoch = 0;
+
+static void _task_check_stack(task_t* t)
+{
+    if(t->stack && t->stack[0] != TASK_CANARY) {
+        printf("task: %s overflowed its stack\n", t->progress.name);
+        panic(0);
+    }
+}
+
+static int _task_next(void)
+{
+    int to = task_cur;
+    do {
+        to = (to + 1) % TASK_MAX;
+    } while(tasks[to].state != TASK_READY && to != task_cur);
+    return to;
+}
+
+static void _task_start(void)
+{
+    task_t* t = &tasks[task_cur];
+    int res = t->entry(t->arg);
+
+    _task_check_stack(t);
+    t->progress.result = res;
+    t->progress.finished = true;
+    t->state = TASK_DONE;
+    task_ready--;
+
+    // Task 0 never finishes, so there's always someone to go to.
+    int from = task_cur;
+    task_cur = _task_next();
+    task_switch(&tasks[from].ctx, &tasks[task_cur].ctx);
+}
+
+int task_spawn(const char* name, task_entry_t entry, void* arg)
+{
+    // Prefer slots nobody could still want to join.
+    int id = 0;
+    for(int i = 1; i < TASK_MAX && !id; i++) {
+        if(tasks[i].state == TASK_FREE)
+            id = i;
+    }
+    for(int i = 1; i < TASK_MAX && !id; i++) {
+        if(tasks[i].state == TASK_DONE)
+            id = i;
+    }
+    if(!id)
+        return -ENOMEM;
+
+    task_t* t = &tasks[id];
+    memset(&t->ctx, 0, sizeof(t->ctx));
+    memset(&t->progress, 0, sizeof(t->progress));
+    strncpy(t->progress.name, name, TASK_NAME_LEN - 1);
+    t->entry = entry;
+    t->arg = arg;
+    t->stack = task_stacks[id - 1];
+    t->stack[0] = TASK_CANARY;
+
+    t->ctx.cpsr = get_cpsr() & ~0xC0;
+    t->ctx.sp = (u32)&t->stack[TASK_STACK_SIZE / sizeof(u32)];
+    t->ctx.lr = (u32)_task_start;
+
+    t->state = TASK_READY;
+    task_ready++;
+    return id;
+}
+
+int task_join(int id)
+{
+    if(id <= 0 || id >= TASK_MAX || id == task_cur || tasks[id].state == TASK_FREE)
+        return -EINVAL;
+
+    while(tasks[id].state == TASK_READY)
+        task_yield();
+
+    tasks[id].state = TASK_FREE;
+    return tasks[id].progress.result;
+}
+
+int task_current(void)
+{
+    return task_cur;
+}
+
+int task_count(void)
+{
+    return task_ready;
+}
+
+bool task_yield(void)
+{
+    if(task_ready <= 1)
+        return false;
+    // Never with IRQs off: that's an IRQ handler (which would run a task on
+    // the IRQ stack) or an irq_kill() section the caller expects to be atomic.
+    if(get_cpsr() & 0x80)
+        return false;
+
+    int from = task_cur;
+    int to = _task_next();
+    if(to == from)
+        return false;
+
+    _task_check_stack(&tasks[from]);
+    task_cur = to;
+    task_switch(&tasks[from].ctx, &tasks[to].ctx);
+    return true;
+}
+
+void task_set_progress(u32 done, u32 total)
+{
+    tasks[task_cur].progress.done = done;
+    tasks[task_cur].progress.total = total;
+}
+
+int task_get_progress(int id, task_progress* out)
+{
+    if(id < 0 || id >= TASK_MAX || tasks[id].state == TASK_FREE)
+        return -EINVAL;
+
+    memcpy(out, &tasks[id].progress, sizeof(*out));
+    return 0;
+}
+
+// One line per pool task, bottom left inside the console border. Task 0
+// only shows up while it has progress set, it never finishes.
+void task_draw_overlay(void)
+{
+    u32 epoch = gfx_get_epoch();
+    bool full = epoch != overlay_epoch;
+
+    for(int i = 0; i < TASK_MAX; i++) {
+        char line[TASK_OVERLAY_LEN] = {0};
+        task_progress* p = &tasks[i].progress;
+
+        if(tasks[i].state != TASK_FREE && (i || p->total)) {
+            if(p->finished)
+                snprintf(line, sizeof(line), "[%s] done (%d)", p->name, p->result);
+            else if(p->total)
+                snprintf(line, sizeof(line), "[%s] %lu/%lu (%lu%%)", p->name, p->done, p->total,
+                         (u32)(((u64)p->done * 100) / p->total));
+            else
+                snprintf(line, sizeof(line), "[%s] running", p->name);
+        }
+
+        // Leave the console alone if there's nothing to show or clear.
+        if(!strcmp(line, overlay_shown[i]) && (!full || !line[0]))
+            continue;
+
+        int row = TASK_MAX - i;
+        int y_drc = CONSOLE_Y + CONSOLE_HEIGHT - CHAR_WIDTH * (row + 1);
+        int y_tv = CONSOLE_TV_Y + CONSOLE_TV_HEIGHT - CHAR_WIDTH * (row + 1);
+        int w = (TASK_OVERLAY_LEN - 1) * CHAR_WIDTH;
+
+        gfx_fill_rect(GFX_DRC, CONSOLE_X + CHAR_WIDTH, y_drc, w, 8, BLACK);
+        gfx_fill_rect(GFX_TV, CONSOLE_TV_X + CHAR_WIDTH, y_tv, w, 8, BLACK);
+        if(line[0]) {
+            gfx_draw_string(GFX_DRC, line, CONSOLE_X + CHAR_WIDTH, y_drc, GREEN);
+            gfx_draw_string(GFX_TV, line, CONSOLE_TV_X + CHAR_WIDTH, y_tv, GREEN);
+        }
+        strcpy(overlay_shown[i], line);
+    }
+
+    overlay_epoch = epoch;
+}
+
+void task_lock(task_lock_t* lock)
+{
+    while(lock->depth && lock->owner != task_cur) {
+        // Nobody is left to unlock it.
+        if(tasks[lock->owner].state != TASK_READY) {
+            printf("task: %s waits for a lock %s exited with\n",
+                   tasks[task_cur].progress.name, tasks[lock->owner].progress.name);
+            panic(0);
+        }
+        if(task_yield())
+            continue;
+
+        // The owner can't run again until IRQs are back on.
+        if(get_cpsr() & 0x80) {
+            printf("task: %s waits for a lock with IRQs off\n", tasks[task_cur].progress.name);
+            panic(0);
+        }
+        irq_wait();
+    }
+    lock->owner = task_cur;
+    lock->depth++;
+}
+
+void task_unlock(task_lock_t* lock)
+{
+    if(lock->depth && lock->owner == task_cur)
+        lock->depth--;
+}
+
+#endif // MINUTE_BOOT1
@@ -0,0 +1,77 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#ifndef _TASK_H
+#define _TASK_H
+
+#include "types.h"
+
+/*
+ * Cooperative tasks on a fixed stack pool.
+ *
+ * Whoever called main() is task 0 and keeps the boot stack. task_spawn runs
+ * a function on one of TASK_MAX - 1 pool stacks; tasks only switch in
+ * task_yield, which the driver wait loops (NAND, SDHC, AES, SHA, SMC idle)
+ * call instead of spinning. There's no preemption and no priorities, the
+ * next runnable task in the table gets the CPU. IRQ state is saved per task;
+ * with IRQs off (handlers, irq_kill() sections) task_yield never switches.
+ * boot1 has a single task; everything below collapses to no-ops there.
+ */
+
+#define TASK_MAX            (4)
+#define TASK_STACK_SIZE     (0x20000)
+#define TASK_NAME_LEN       (24)
+
+typedef struct task_progress {
+    char name[TASK_NAME_LEN];
+    u32 done;
+    u32 total;
+    int result;
+    bool finished;
+} task_progress;
+
+typedef struct task_lock_t {
+    int owner;
+    u32 depth;
+} task_lock_t;
+
+typedef int (*task_entry_t)(void* arg);
+
+#ifndef MINUTE_BOOT1
+
+// Returns a task id, or -ENOMEM if all pool stacks are taken.
+int task_spawn(const char* name, task_entry_t entry, void* arg);
+// Runs other tasks until id finished, then returns its result.
+int task_join(int id);
+int task_current(void);
+int task_count(void);
+
+// Returns true if another task ran.
+bool task_yield(void);
+
+// total == 0 clears it, which hides task 0 from the overlay.
+void task_set_progress(u32 done, u32 total);
+int task_get_progress(int id, task_progress* out);
+void task_draw_overlay(void);
+
+// Recursive; waiting yields, or sleeps in irq_wait if nothing else can run.
+// Must not wait with IRQs off, and panics if the owner exited holding it.
+// Zero-initialized means unlocked.
+void task_lock(task_lock_t* lock);
+void task_unlock(task_lock_t* lock);
+
+#else
+
+static inline bool task_yield(void) { return false; }
+static inline void task_set_progress(u32 done, u32 total) { }
+static inline void task_draw_overlay(void) { }
+static inline void task_lock(task_lock_t* lock) { }
+static inline void task_unlock(task_lock_t* lock) { }
+
+#endif // MINUTE_BOOT1
+
+#endif
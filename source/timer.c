@@ -0,0 +1,165 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#include "timer.h"
+#include "latte.h"
+#include "utils.h"
+#include "irq.h"
+
+#include <errno.h>
+
+// Closest the alarm is ever set, so the write lands before LT_TIMER passes it.
+#define TIMER_MIN_TICKS (16)
+
+static u32 timer_us2ticks(u32 us)
+{
+    if (us > TIMER_MAX_US)
+        us = TIMER_MAX_US;
+    return (u32)(((u64)us * 19) / 10);
+}
+
+static bool timer_expired(u32 deadline, u32 now)
+{
+    return (s32)(deadline - now) <= 0;
+}
+
+#ifndef MINUTE_BOOT1
+
+static timer_event_t* timer_head = NULL;
+
+static void _timer_insert(timer_event_t* timer)
+{
+    timer_event_t** it = &timer_head;
+    while (*it && (s32)((*it)->deadline - timer->deadline) <= 0)
+        it = &(*it)->next;
+
+    timer->next = *it;
+    *it = timer;
+    timer->pending = true;
+}
+
+static void _timer_remove(timer_event_t* timer)
+{
+    for (timer_event_t** it = &timer_head; *it; it = &(*it)->next) {
+        if (*it == timer) {
+            *it = timer->next;
+            break;
+        }
+    }
+    timer->next = NULL;
+    timer->pending = false;
+}
+
+static void _timer_program(void)
+{
+    if (!timer_head)
+        return;
+
+    u32 now = read32(LT_TIMER);
+    u32 at = timer_head->deadline;
+    if ((s32)(at - now) < TIMER_MIN_TICKS)
+        at = now + TIMER_MIN_TICKS;
+    write32(LT_ALARM, at);
+}
+
+void timer_start(timer_event_t* timer, u32 us, u32 period_us)
+{
+    u32 cookie = irq_kill();
+
+    if (timer->pending)
+        _timer_remove(timer);
+
+    timer->deadline = read32(LT_TIMER) + timer_us2ticks(us);
+    timer->period = period_us ? timer_us2ticks(period_us) : 0;
+    _timer_insert(timer);
+    if (timer_head == timer)
+        _timer_program();
+
+    irq_enable(IRQ_TIMER);
+    irq_restore(cookie);
+}
+
+void timer_cancel(timer_event_t* timer)
+{
+    u32 cookie = irq_kill();
+    if (timer->pending)
+        _timer_remove(timer);
+    irq_restore(cookie);
+}
+
+void timer_irq(void)
+{
+    u32 now = read32(LT_TIMER);
+
+    while (timer_head && timer_expired(timer_head->deadline, now)) {
+        timer_event_t* timer = timer_head;
+        _timer_remove(timer);
+
+        // Requeue first so the callback can still cancel it. Missed
+        // periods are dropped rather than fired back to back.
+        if (timer->period) {
+            timer->deadline += timer->period;
+            if (timer_expired(timer->deadline, now))
+                timer->deadline = now + timer->period;
+            _timer_insert(timer);
+        }
+
+        if (timer->callback)
+            timer->callback(timer);
+        now = read32(LT_TIMER);
+    }
+
+    _timer_program();
+}
+
+#endif // MINUTE_BOOT1
+
+int timer_wait_until(timer_cond_t cond, void* arg, u32 timeout_us, u32 poll_us)
+{
+    u32 start = read32(LT_TIMER);
+    u32 timeout = timer_us2ticks(timeout_us);
+    int ret = -ETIMEDOUT;
+
+#ifndef MINUTE_BOOT1
+    timer_event_t wake = { 0 };
+    if (!poll_us || poll_us > timeout_us)
+        poll_us = timeout_us;
+    timer_start(&wake, poll_us, poll_us);
+#endif
+
+    while (true) {
+        if (cond(arg)) {
+            ret = 0;
+            break;
+        }
+        if (read32(LT_TIMER) - start >= timeout)
+            break;
+
+#ifndef MINUTE_BOOT1
+        // Only sleep if something is going to wake us up again.
+        u32 cookie = irq_kill();
+        if (wake.pending && (read32(LT_INTMR_AHBALL_ARM) & IRQF_TIMER))
+            irq_wait();
+        irq_restore(cookie);
+#endif
+    }
+
+#ifndef MINUTE_BOOT1
+    timer_cancel(&wake);
+#endif
+    return ret;
+}
+
+static bool _timer_never(void* arg)
+{
+    return false;
+}
+
+void timer_sleep(u32 us)
+{
+    timer_wait_until(_timer_never, NULL, us, us);
+}
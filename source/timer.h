@@ -0,0 +1,52 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+
+/*
+ * Software timers multiplexed onto the single LT_ALARM comparator.
+ *
+ * Timers are owned by the caller and kept in a list sorted by deadline;
+ * the alarm is always set to the head. Deadlines are LT_TIMER ticks and
+ * compared wrap-safe, so a timer can be at most TIMER_MAX_US away.
+ * boot1 has no timer service, only the waits below (which then poll).
+ */
+
+#define TIMER_MAX_US    (1000u * 1000u * 60u * 15u)
+
+typedef struct timer_event_t {
+    struct timer_event_t* next;
+    u32 deadline;
+    u32 period;
+    volatile bool pending;
+
+    // Called from IRQ context. May restart or cancel its own timer.
+    // NULL just wakes up anyone sleeping in irq_wait.
+    void (*callback)(struct timer_event_t* timer);
+    void* priv;
+} timer_event_t;
+
+typedef bool (*timer_cond_t)(void* arg);
+
+// Fires after us, then every period_us if that's non-zero.
+void timer_start(timer_event_t* timer, u32 us, u32 period_us);
+void timer_cancel(timer_event_t* timer);
+void timer_irq(void);
+
+/*
+ * Sleeps until cond(arg) is true (returns 0) or timeout_us passed (returns
+ * -ETIMEDOUT). cond runs with IRQs enabled, at least every poll_us; in
+ * between the CPU waits for interrupts so timers and the event poll keep
+ * running.
+ */
+int timer_wait_until(timer_cond_t cond, void* arg, u32 timeout_us, u32 poll_us);
+void timer_sleep(u32 us);
+
+#endif
@@ -39,5 +39,6 @@ int usb_init()
         return usb_init_2();
     }
 
+    pll_skipped |= PLL_SKIP_USB;
     return 0;
 }
\ No newline at end of file
@@ -40,6 +40,14 @@ static inline u32 read32_unaligned(const u8* pData)
     return (val_0 << 24) | (val_1 << 16) | (val_2 << 8) | (val_3);
 }
 
+static inline void write32_unaligned(u8* pData, u32 val)
+{
+    pData[0] = val >> 24;
+    pData[1] = val >> 16;
+    pData[2] = val >> 8;
+    pData[3] = val;
+}
+
 static inline u32 read32le_unaligned(u8* pData)
 {
     u8 val_3 = pData[0];
@@ -0,0 +1,155 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+// Checks dram_prog_build against ddr_init.trace: for every case in the
+// trace, builds the program for that mode/speed/size/hw, runs it through
+// dram_prog_run from a host build of source/dram.c with the MMIO accessors
+// below logging instead of poking registers, and compares the log line by
+// line.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dram_prog.h"
+#include "dram.h"
+#include "latte.h"
+#include "crypto.h"
+#include "utils.h"
+
+#define TRACE_LINE_MAX  (64)
+#define LOG_MAX         (1024)
+
+static char log_buf[LOG_MAX][TRACE_LINE_MAX];
+static int log_count;
+
+static void _log(const char *fmt, u32 a, u32 b)
+{
+    if (log_count < LOG_MAX)
+        snprintf(log_buf[log_count], TRACE_LINE_MAX, fmt, a, b);
+    log_count++;
+}
+
+u32 read32(u32 addr) { _log("R32 %x", addr, 0); return 0; }
+void write32(u32 addr, u32 data) { _log("W32 %x %x", addr, data); }
+u32 set32(u32 addr, u32 set) { _log("S32 %x %x", addr, set); return 0; }
+u32 clear32(u32 addr, u32 clear) { _log("C32 %x %x", addr, clear); return 0; }
+
+u16 read16(u32 addr) { _log("R16 %x", addr, 0); return 0; }
+void write16(u32 addr, u16 data) { _log("W16 %x %x", addr, data); }
+u16 set16(u32 addr, u16 set) { _log("S16 %x %x", addr, set); return 0; }
+
+void udelay(u32 d) { _log("DELAY %u", d, 0); }
+
+// The rest of what dram.c links against. Only dram_prog_run and
+// ddr_seq_write16 are exercised, and the builder only wants the PLL
+// configs' addresses.
+bsp_pll_cfg dram_1_pllcfg, dram_2_pllcfg, dram_3_pllcfg, spll_cfg;
+seeprom_t seeprom;
+u32 pll_skipped;
+
+u32 latte_get_hw_version() { return 0; }
+int pll_cfg_matches(const bsp_pll_cfg *pWant, const bsp_pll_cfg *pHave) { return 0; }
+int pll_syspll_read(bsp_pll_cfg **ppCfg, u32 *pSysClkFreq) { return -1; }
+int pll_syspll_init(int bIdk) { return -1; }
+int pll_spll_write(bsp_pll_cfg *pPllCfg) { return -1; }
+int pll_dram_read(bsp_pll_cfg *pOut) { return -1; }
+int pll_dram_write(bsp_pll_cfg *pCfg) { return -1; }
+
+// Returns the number of mismatches in one case.
+static int check_case(const char *name, u32 hw, u8 speed, u16 size, u16 mode,
+                      char (*expect)[TRACE_LINE_MAX], int expect_count)
+{
+    static dram_op prog[DRAM_PROG_MAX];
+    const dram_profile *p = dram_prog_profile(mode, speed, hw);
+    int count = dram_prog_build(p, mode, size, prog, DRAM_PROG_MAX);
+
+    if (count < 0) {
+        printf("FAIL %s: program doesn't fit in DRAM_PROG_MAX\n", name);
+        return 1;
+    }
+
+    log_count = 0;
+    dram_prog_run(prog, count);
+    if (log_count > LOG_MAX) {
+        printf("FAIL %s: %d accesses, log holds %d\n", name, log_count, LOG_MAX);
+        return 1;
+    }
+
+    for (int i = 0; i < log_count || i < expect_count; i++) {
+        const char *got = (i < log_count) ? log_buf[i] : "<end>";
+        const char *want = (i < expect_count) ? expect[i] : "<end>";
+        if (strcmp(got, want)) {
+            printf("FAIL %s: access %d is '%s', trace has '%s'\n", name, i, got, want);
+            return 1;
+        }
+    }
+
+    printf("ok   %s (%d ops, %d accesses)\n", name, count, log_count);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static char expect[LOG_MAX][TRACE_LINE_MAX];
+    char line[TRACE_LINE_MAX + 2];
+    char name[TRACE_LINE_MAX] = "";
+    unsigned int hw = 0, speed = 0, size = 0, mode = 0;
+    int expect_count = 0, cases = 0, failed = 0;
+    FILE *f;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s ddr_init.trace\n", argv[0]);
+        return 2;
+    }
+
+    f = fopen(argv[1], "r");
+    if (!f) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    for (;;) {
+        char *ok = fgets(line, sizeof(line), f);
+        if (ok)
+            line[strcspn(line, "\r\n")] = 0;
+
+        if (!ok || !strncmp(line, "== ", 3)) {
+            if (name[0]) {
+                failed += check_case(name, hw, speed, size, mode, expect, expect_count);
+                cases++;
+            }
+            if (!ok)
+                break;
+
+            if (sscanf(line, "== hw %x speed %u size %x mode %x", &hw, &speed, &size, &mode) != 4) {
+                fprintf(stderr, "bad case header '%s'\n", line);
+                return 2;
+            }
+            snprintf(name, sizeof(name), "%s", line + 3);
+            expect_count = 0;
+            continue;
+        }
+
+        if (!line[0] || line[0] == '#')
+            continue;
+        if (expect_count >= LOG_MAX) {
+            fprintf(stderr, "%s: more than %d accesses\n", name, LOG_MAX);
+            return 2;
+        }
+        snprintf(expect[expect_count++], TRACE_LINE_MAX, "%.*s", TRACE_LINE_MAX - 1, line);
+    }
+    fclose(f);
+
+    if (!cases) {
+        fprintf(stderr, "%s: no cases\n", argv[1]);
+        return 2;
+    }
+
+    printf("%d/%d cases match\n", cases - failed, cases);
+    return failed ? 1 : 0;
+}
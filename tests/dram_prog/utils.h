@@ -0,0 +1,27 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#ifndef __UTILS_H__
+#define __UTILS_H__
+
+// Host stand-in for source/utils.h, which is ARM inline assembly. The MMIO
+// accessors dram.c uses are logged by host_dram_prog.c.
+
+#include "types.h"
+
+u32 read32(u32 addr);
+void write32(u32 addr, u32 data);
+u32 set32(u32 addr, u32 set);
+u32 clear32(u32 addr, u32 clear);
+
+u16 read16(u32 addr);
+void write16(u32 addr, u16 data);
+u16 set16(u32 addr, u16 set);
+
+void udelay(u32 d);
+
+#endif
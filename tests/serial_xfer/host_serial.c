@@ -0,0 +1,84 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+// Runs the device side of serial_xfer on a tty, for test_serial_xfer.py.
+//   serial_xfer_host TTY receive|send PATH
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "serial.h"
+#include "serial_xfer.h"
+
+static int serial_fd = -1;
+
+u32 host_timer(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    // LT_TIMER runs at 1.9 MHz.
+    u64 us = (u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    return (u32)(us * 19 / 10);
+}
+
+void serial_send(u8 val)
+{
+    while(write(serial_fd, &val, 1) != 1);
+}
+
+int serial_in_read(u8* out)
+{
+    ssize_t len = read(serial_fd, out, 256);
+    return len > 0 ? len : 0;
+}
+
+void serial_poll()
+{
+    struct pollfd pfd = { .fd = serial_fd, .events = POLLIN };
+    poll(&pfd, 1, 1);
+}
+
+void serial_allow_zeros()
+{
+}
+
+void serial_disallow_zeros()
+{
+}
+
+int main(int argc, char** argv)
+{
+    struct termios tio;
+
+    if(argc != 4) {
+        fprintf(stderr, "usage: %s TTY receive|send PATH\n", argv[0]);
+        return 2;
+    }
+
+    serial_fd = open(argv[1], O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(serial_fd < 0 || tcgetattr(serial_fd, &tio)) {
+        perror(argv[1]);
+        return 2;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(serial_fd, TCSANOW, &tio);
+
+    int res;
+    if(!strcmp(argv[2], "receive"))
+        res = serial_xfer_receive(argv[3]);
+    else
+        res = serial_xfer_send(argv[3]);
+
+    close(serial_fd);
+    return res < 0;
+}
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+# Loopback test for the serial transfer protocol: the device side (a host
+# build of source/serial_xfer.c) and serial_xfer.py talk over two pty pairs,
+# joined by a proxy that can drop and corrupt bytes.
+#
+#   test_serial_xfer.py BUILD/serial_xfer_host
+
+import os, sys, pty, tty, random, select, shutil, subprocess, tempfile, threading, unittest
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+TOOL = os.path.join(ROOT, "serial_xfer.py")
+HOST = None
+TIMEOUT = 60
+
+MAGIC = b"MX"
+HDR_SIZE = 12
+TYPE_ACK = 5
+
+class Proxy:
+    """Forwards bytes between two pty masters, losing some on the way.
+
+    drop_frame = (direction, type, seq) drops the first such frame, direction
+    0 being device to tool. That direction must not carry DATA, or payload
+    bytes could be mistaken for a header.
+    """
+
+    def __init__(self, a, b, drop, flip, seed, drop_frame=None):
+        self.stop = False
+        self.drop_frame = drop_frame
+        self.threads = [
+            threading.Thread(target=self._pump, args=(0, a, b, random.Random(seed), drop, flip), daemon=True),
+            threading.Thread(target=self._pump, args=(1, b, a, random.Random(seed + 1), drop, flip), daemon=True),
+        ]
+        for t in self.threads:
+            t.start()
+
+    # Drops the frame the test asked for, holds back a frame that's incomplete.
+    def _filter(self, pending):
+        out = bytearray()
+        while True:
+            idx = pending.find(MAGIC)
+            if idx < 0:
+                keep = 1 if pending.endswith(MAGIC[:1]) else 0
+                out += pending[:len(pending) - keep]
+                return out, pending[len(pending) - keep:]
+            out += pending[:idx]
+            pending = pending[idx:]
+            if len(pending) < HDR_SIZE or len(pending) < HDR_SIZE + pending[3]:
+                return out, pending
+            size = HDR_SIZE + pending[3]
+            frame = (pending[2], int.from_bytes(pending[4:8], "big"))
+            if self.drop_frame and frame == self.drop_frame[1:]:
+                self.drop_frame = None
+            else:
+                out += pending[:size]
+            pending = pending[size:]
+
+    def _pump(self, direction, src, dst, rng, drop, flip):
+        pending = bytearray()
+        while not self.stop:
+            if not select.select([src], [], [], 0.05)[0]:
+                continue
+            try:
+                data = os.read(src, 4096)
+            except OSError:
+                return
+            out = bytearray()
+            for c in data:
+                r = rng.random()
+                if r < drop:
+                    continue
+                if r < drop + flip:
+                    c ^= 1 << rng.randrange(8)
+                out.append(c)
+            if self.drop_frame and self.drop_frame[0] == direction:
+                out, pending = self._filter(pending + out)
+            elif pending:
+                out, pending = pending + out, bytearray()
+            while out:
+                try:
+                    out = out[os.write(dst, out):]
+                except OSError:
+                    return
+
+    def close(self):
+        self.stop = True
+        for t in self.threads:
+            t.join()
+
+def open_pty():
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    return master, slave, os.ttyname(slave)
+
+class SerialXferTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.fds = []
+
+    def tearDown(self):
+        for fd in self.fds:
+            os.close(fd)
+        shutil.rmtree(self.dir)
+
+    def path(self, name):
+        return os.path.join(self.dir, name)
+
+    def payload(self, size, seed=0):
+        rng = random.Random(seed)
+        # Half noise, half text, so deflate has something to do.
+        noise = bytes(rng.randrange(256) for _ in range(size // 2))
+        text = b"".join(b"line %d of the log\n" % i for i in range(size))[:size - len(noise)]
+        return noise + text
+
+    # Runs one transfer and returns the tool's output.
+    def run_xfer(self, direction, device_file, local_file, tool_args=(), drop=0.0, flip=0.0, seed=1, drop_frame=None):
+        dev_master, dev_slave, dev_tty = open_pty()
+        tool_master, tool_slave, tool_tty = open_pty()
+        self.fds += [dev_master, dev_slave, tool_master, tool_slave]
+        proxy = Proxy(dev_master, tool_master, drop, flip, seed, drop_frame)
+
+        mode = "receive" if direction == "put" else "send"
+        device = subprocess.Popen([HOST, dev_tty, mode, device_file],
+                                  stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        try:
+            tool = subprocess.run([sys.executable, TOOL, tool_tty, direction, local_file] + list(tool_args),
+                                  stdout=subprocess.PIPE, stderr=subprocess.STDOUT, timeout=TIMEOUT)
+            dev_out = device.communicate(timeout=TIMEOUT)[0]
+        finally:
+            if device.poll() is None:
+                device.kill()
+            proxy.close()
+
+        out = tool.stdout.decode(errors="replace")
+        dev_out = dev_out.decode(errors="replace")
+        self.assertEqual(tool.returncode, 0, "tool failed:\n" + out + "\ndevice:\n" + dev_out)
+        self.assertEqual(device.returncode, 0, "device failed:\n" + dev_out + "\ntool:\n" + out)
+        return out
+
+    def write(self, name, data):
+        with open(self.path(name), "wb") as f:
+            f.write(data)
+
+    def read(self, name):
+        with open(self.path(name), "rb") as f:
+            return f.read()
+
+    def test_put(self):
+        data = self.payload(50000)
+        self.write("local", data)
+        self.run_xfer("put", self.path("device"), self.path("local"))
+        self.assertEqual(self.read("device"), data)
+
+    def test_put_deflate(self):
+        data = self.payload(50000)
+        self.write("local", data)
+        self.run_xfer("put", self.path("device"), self.path("local"), ["--compress"])
+        self.assertEqual(self.read("device"), data)
+
+    def test_put_empty(self):
+        self.write("local", b"")
+        self.run_xfer("put", self.path("device"), self.path("local"))
+        self.assertEqual(self.read("device"), b"")
+
+    def test_put_resume(self):
+        data = self.payload(50000)
+        self.write("local", data)
+        self.write("device", data[:20000])
+        out = self.run_xfer("put", self.path("device"), self.path("local"), ["--resume"])
+        self.assertIn("at 0x%x" % 20000, out)
+        self.assertEqual(self.read("device"), data)
+
+    def test_put_resume_mismatch(self):
+        data = self.payload(50000)
+        self.write("local", data)
+        self.write("device", b"\xAA" * 20000)
+        out = self.run_xfer("put", self.path("device"), self.path("local"), ["--resume"])
+        self.assertIn("at 0x0 ", out)
+        self.assertEqual(self.read("device"), data)
+
+    def test_put_lossy(self):
+        data = self.payload(50000)
+        self.write("local", data)
+        self.run_xfer("put", self.path("device"), self.path("local"), drop=1/3000, flip=1/3000)
+        self.assertEqual(self.read("device"), data)
+
+    def test_put_deflate_lossy(self):
+        data = self.payload(50000)
+        self.write("local", data)
+        self.run_xfer("put", self.path("device"), self.path("local"), ["--compress"], drop=1/3000, flip=1/3000, seed=7)
+        self.assertEqual(self.read("device"), data)
+
+    # The device's ACK of END is lost, the tool has to get another one.
+    def test_put_lost_final_ack(self):
+        data = self.payload(50000)
+        self.write("local", data)
+        frames = (len(data) + 239) // 240
+        self.run_xfer("put", self.path("device"), self.path("local"), drop_frame=(0, TYPE_ACK, frames + 1))
+        self.assertEqual(self.read("device"), data)
+
+    def test_get(self):
+        data = self.payload(50000)
+        self.write("device", data)
+        self.run_xfer("get", self.path("device"), self.path("local"))
+        self.assertEqual(self.read("local"), data)
+
+    def test_get_resume(self):
+        data = self.payload(50000)
+        self.write("device", data)
+        self.write("local", data[:30000])
+        out = self.run_xfer("get", self.path("device"), self.path("local"), ["--resume"])
+        self.assertIn("at 0x%x" % 30000, out)
+        self.assertEqual(self.read("local"), data)
+
+    def test_get_lossy(self):
+        data = self.payload(50000)
+        self.write("device", data)
+        self.run_xfer("get", self.path("device"), self.path("local"), drop=1/3000, flip=1/3000, seed=3)
+        self.assertEqual(self.read("local"), data)
+
+    # The tool's ACK of END is lost, the device must not give up on it.
+    def test_get_lost_final_ack(self):
+        data = self.payload(50000)
+        self.write("device", data)
+        frames = (len(data) + 239) // 240
+        self.run_xfer("get", self.path("device"), self.path("local"), drop_frame=(1, TYPE_ACK, frames + 1))
+        self.assertEqual(self.read("local"), data)
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.exit("usage: %s BUILD/serial_xfer_host [unittest args]" % sys.argv[0])
+    HOST = os.path.abspath(sys.argv.pop(1))
+    unittest.main()
@@ -0,0 +1,47 @@
+/*
+ *  minute - a port of the "mini" IOS replacement for the Wii U.
+ *
+ *  This code is licensed to you under the terms of the GNU GPL, version 2;
+ *  see file COPYING or http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ */
+
+#ifndef __UTILS_H__
+#define __UTILS_H__
+
+// Host stand-in for source/utils.h, which is ARM inline assembly. Only the
+// parts serial_xfer.c uses; the only register it reads is LT_TIMER.
+
+#include "types.h"
+
+u32 host_timer(void);
+
+static inline u32 read32(u32 addr)
+{
+    (void)addr;
+    return host_timer();
+}
+
+static inline u32 read32_unaligned(const u8* pData)
+{
+    return (pData[0] << 24) | (pData[1] << 16) | (pData[2] << 8) | pData[3];
+}
+
+static inline void write32_unaligned(u8* pData, u32 val)
+{
+    pData[0] = val >> 24;
+    pData[1] = val >> 16;
+    pData[2] = val >> 8;
+    pData[3] = val;
+}
+
+#define max(a, b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a > _b ? _a : _b; })
+
+#define min(a, b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a < _b ? _a : _b; })
+
+#endif